@@ -0,0 +1,487 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 windowed binary file transfer
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QtEndian>
+#include <QSerialPort>
+#include "blockxfer.h"
+
+#define	DEBUG_BLOCKXFER	0
+
+#if defined(DEBUG_BLOCKXFER) && (DEBUG_BLOCKXFER != 0)
+#define	DBG_BLOCKXFER(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_BLOCKXFER(X,...) /* X */
+#endif
+
+BlockXfer::BlockXfer(QObject* parent)
+    : QObject(parent)
+    , m_dev(nullptr)
+    , m_baud_rate(default_baud)
+    , m_file()
+    , m_data(nullptr)
+    , m_size(0)
+    , m_address(0)
+    , m_state(st_idle)
+    , m_blocks(0)
+    , m_base(0)
+    , m_next(0)
+    , m_retries(0)
+    , m_resends(0)
+    , m_rx()
+    , m_timer()
+    , m_clock()
+    , m_update()
+    , m_error()
+{
+    m_timer.setSingleShot(true);
+    bool ok = connect(&m_timer, SIGNAL(timeout()), SLOT(timed_out()));
+    Q_ASSERT(ok);
+}
+
+BlockXfer::~BlockXfer()
+{
+    cancel();
+}
+
+/**
+ * @brief Build a frame
+ * @param type frame type character
+ * @param seq sequence number
+ * @param payload const reference to the payload
+ * @return QByteArray with the frame
+ */
+QByteArray BlockXfer::frame(char type, quint8 seq, const QByteArray& payload)
+{
+    QByteArray result;
+    result.reserve(payload.size() + 7);
+    result += SOH;
+    result += type;
+    result += static_cast<char>(seq);
+    result += static_cast<char>(payload.size() & 0xff);
+    result += static_cast<char>((payload.size() >> 8) & 0xff);
+    result += payload;
+    const quint16 crc = qChecksum(result.constData() + 1, static_cast<uint>(result.size() - 1));
+    result += static_cast<char>(crc & 0xff);
+    result += static_cast<char>(crc >> 8);
+    return result;
+}
+
+/**
+ * @brief Start sending a file
+ * @param dev pointer to the device to write to
+ * @param filename name of the file to send
+ * @param address hub address to store the data at, or 0 for the receiver's default
+ * @return true if the transfer was started
+ */
+bool BlockXfer::start(QIODevice* dev, const QString& filename, quint32 address)
+{
+    cancel();
+    m_error.clear();
+    if (!dev || !dev->isOpen()) {
+	m_error = tr("The device is not open.");
+	return false;
+    }
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+	m_error = tr("Could not open %1: %2")
+		  .arg(filename)
+		  .arg(m_file.errorString());
+	return false;
+    }
+    m_size = m_file.size();
+    if (m_size <= 0 || m_size > 0x7fffffff) {
+	m_error = tr("Can't send %1 bytes.").arg(m_size);
+	m_file.close();
+	return false;
+    }
+    m_data = reinterpret_cast<const char*>(m_file.map(0, m_size));
+    if (!m_data) {
+	m_error = tr("Could not map %1: %2")
+		  .arg(filename)
+		  .arg(m_file.errorString());
+	m_file.close();
+	return false;
+    }
+    m_dev = dev;
+    const QSerialPort* stty = qobject_cast<const QSerialPort*>(dev);
+    m_baud_rate = stty && stty->baudRate() > 0 ? stty->baudRate() : default_baud;
+    m_address = address;
+    m_blocks = (m_size + block_size - 1) / block_size;
+    m_base = 0;
+    m_next = 0;
+    m_retries = 0;
+    m_resends = 0;
+    m_rx.clear();
+    bool ok = connect(m_dev, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()),
+		      Qt::UniqueConnection);
+    Q_ASSERT(ok);
+    ok = connect(m_dev, SIGNAL(aboutToClose()), this, SLOT(device_closing()),
+		 Qt::UniqueConnection);
+    Q_ASSERT(ok);
+    m_clock.start();
+    m_update.start();
+    emit progress(0, m_size);
+    send_start();
+    return true;
+}
+
+/**
+ * @brief Abort the transfer
+ */
+void BlockXfer::cancel()
+{
+    if (!m_dev)
+	return;
+    m_error = tr("Cancelled after %1 of %2 bytes.").arg(acknowledged()).arg(m_size);
+    finish(false);
+}
+
+/**
+ * @brief Return true while a transfer is running
+ * @return true if running
+ */
+bool BlockXfer::running() const
+{
+    return !m_dev.isNull();
+}
+
+/**
+ * @brief Return the name of the file being sent
+ * @return file name
+ */
+QString BlockXfer::filename() const
+{
+    return m_file.fileName();
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString BlockXfer::error_string() const
+{
+    return m_error;
+}
+
+/**
+ * @brief Return the number of bytes acknowledged by the receiver
+ * @return number of bytes
+ */
+qint64 BlockXfer::acknowledged() const
+{
+    return qMin(m_base * block_size, m_size);
+}
+
+/**
+ * @brief Return the size of the file
+ * @return number of bytes
+ */
+qint64 BlockXfer::size() const
+{
+    return m_size;
+}
+
+/**
+ * @brief Return the average throughput since the start
+ * @return bytes per second
+ */
+qint64 BlockXfer::bytes_per_second() const
+{
+    const qint64 ms = m_clock.isValid() ? m_clock.elapsed() : 0;
+    return ms > 0 ? acknowledged() * 1000 / ms : 0;
+}
+
+/**
+ * @brief Return the estimated time until the file is sent
+ * @return time in ms, or -1 if unknown
+ */
+qint64 BlockXfer::eta_ms() const
+{
+    const qint64 bps = bytes_per_second();
+    return bps > 0 ? (m_size - acknowledged()) * 1000 / bps : -1;
+}
+
+/**
+ * @brief Return the number of times blocks were sent again
+ * @return number of go-back-N restarts
+ */
+int BlockXfer::resends() const
+{
+    return m_resends;
+}
+
+/**
+ * @brief Collect the received data and handle the complete frames
+ * Bytes outside of valid frames are dropped.
+ * @param data const reference to the received data
+ */
+void BlockXfer::received(const QByteArray& data)
+{
+    if (!m_dev)
+	return;
+    m_rx += data;
+    for (;;) {
+	const int soh = m_rx.indexOf(SOH);
+	if (soh < 0) {
+	    m_rx.clear();
+	    return;
+	}
+	m_rx.remove(0, soh);
+	if (m_rx.size() < 5)
+	    return;
+	const uchar* p = reinterpret_cast<const uchar*>(m_rx.constData());
+	const int len = qFromLittleEndian<quint16>(p + 3);
+	if (len > 64) {
+	    // replies are short; this SOH did not start a frame
+	    m_rx.remove(0, 1);
+	    continue;
+	}
+	if (m_rx.size() < 7 + len)
+	    return;
+	const quint16 crc = qChecksum(m_rx.constData() + 1, static_cast<uint>(4 + len));
+	if (crc != qFromLittleEndian<quint16>(p + 5 + len)) {
+	    m_rx.remove(0, 1);
+	    continue;
+	}
+	const char type = m_rx[1];
+	const quint8 seq = static_cast<quint8>(m_rx[2]);
+	const QByteArray payload = m_rx.mid(5, len);
+	m_rx.remove(0, 7 + len);
+	handle(type, seq, payload);
+	if (!m_dev)
+	    return;
+    }
+}
+
+/**
+ * @brief Send data frames while the window and the device have room
+ */
+void BlockXfer::pump()
+{
+    if (!m_dev || st_data != m_state)
+	return;
+    while (m_next < m_blocks && m_next < m_base + window &&
+	   m_dev->bytesToWrite() < 2 * block_size) {
+	const qint64 offset = m_next * block_size;
+	const int len = static_cast<int>(qMin<qint64>(block_size, m_size - offset));
+	const QByteArray data = frame('D', static_cast<quint8>(m_next),
+				      QByteArray::fromRawData(m_data + offset, len));
+	if (m_dev->write(data) < 0) {
+	    fail(tr("Write error at block %1: %2")
+		 .arg(m_next)
+		 .arg(m_dev->errorString()));
+	    return;
+	}
+	m_next++;
+    }
+}
+
+/**
+ * @brief Resend the last control frame, or go back to the oldest unacknowledged block
+ */
+void BlockXfer::timed_out()
+{
+    if (++m_retries > max_retries) {
+	fail(tr("No response from the receiver."));
+	return;
+    }
+    DBG_BLOCKXFER("%s: state %d, retry %d", __func__, m_state, m_retries);
+    switch (m_state) {
+    case st_idle:
+	break;
+    case st_start:
+	send_start();
+	break;
+    case st_data:
+	go_back(m_base);
+	break;
+    case st_end:
+	send_end();
+	break;
+    }
+}
+
+/**
+ * @brief Abort the transfer because the device is about to be closed
+ */
+void BlockXfer::device_closing()
+{
+    fail(tr("The device was closed after %1 of %2 bytes.").arg(acknowledged()).arg(m_size));
+}
+
+void BlockXfer::send_start()
+{
+    QByteArray payload(10, 0);
+    uchar* p = reinterpret_cast<uchar*>(payload.data());
+    qToLittleEndian<quint32>(static_cast<quint32>(m_size), p);
+    qToLittleEndian<quint32>(m_address, p + 4);
+    qToLittleEndian<quint16>(block_size, p + 8);
+    m_state = st_start;
+    m_dev->write(frame('S', 0, payload));
+    m_timer.start(ack_timeout());
+}
+
+void BlockXfer::send_end()
+{
+    QByteArray payload(6, 0);
+    uchar* p = reinterpret_cast<uchar*>(payload.data());
+    qToLittleEndian<quint32>(static_cast<quint32>(m_size), p);
+    qToLittleEndian<quint16>(qChecksum(m_data, static_cast<uint>(m_size)), p + 4);
+    m_state = st_end;
+    m_dev->write(frame('E', static_cast<quint8>(m_blocks), payload));
+    m_timer.start(ack_timeout());
+}
+
+/**
+ * @brief Handle a frame from the receiver
+ * @param type frame type
+ * @param seq sequence number
+ * @param payload const reference to the payload
+ */
+void BlockXfer::handle(char type, quint8 seq, const QByteArray& payload)
+{
+    DBG_BLOCKXFER("%s: '%c' seq %u len %d", __func__, type, seq, payload.size());
+    switch (type) {
+    case 'K':
+	if (st_start == m_state) {
+	    m_state = st_data;
+	    m_retries = 0;
+	    m_timer.start(ack_timeout());
+	    pump();
+	}
+	break;
+
+    case 'A':
+	if (st_data == m_state) {
+	    const qint64 block = block_index(seq);
+	    if (block < m_base || block >= m_next)
+		break;
+	    m_base = block + 1;
+	    m_retries = 0;
+	    if (m_update.elapsed() >= progress_interval) {
+		m_update.restart();
+		emit progress(acknowledged(), m_size);
+	    }
+	    if (m_base >= m_blocks) {
+		send_end();
+	    } else {
+		m_timer.start(ack_timeout());
+		pump();
+	    }
+	}
+	break;
+
+    case 'N':
+	if (st_data == m_state) {
+	    const qint64 block = block_index(seq);
+	    if (block < m_base || block > m_next)
+		break;
+	    if (++m_retries > max_retries) {
+		fail(tr("Too many errors at block %1.").arg(block));
+		break;
+	    }
+	    go_back(block);
+	}
+	break;
+
+    case 'F':
+	if (st_end == m_state) {
+	    const quint16 crc = qChecksum(m_data, static_cast<uint>(m_size));
+	    if (payload.size() < 2 ||
+		qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(payload.constData())) != crc) {
+		fail(tr("The receiver's CRC does not match."));
+		break;
+	    }
+	    finish(true);
+	}
+	break;
+
+    case 'X':
+	fail(tr("The receiver refused the transfer."));
+	break;
+    }
+}
+
+/**
+ * @brief Map a sequence number to the block number near the window
+ * @param seq sequence number (block number modulo 256)
+ * @return block number at or after m_base
+ */
+qint64 BlockXfer::block_index(quint8 seq) const
+{
+    return m_base + static_cast<quint8>(seq - static_cast<quint8>(m_base));
+}
+
+/**
+ * @brief Return the time to wait for the receiver's next reply
+ * The reply can only arrive after the data in flight was sent, which at
+ * a low baud rate takes much longer than the receiver needs to answer.
+ * @return timeout in ms
+ */
+int BlockXfer::ack_timeout() const
+{
+    qint64 bytes = m_dev ? m_dev->bytesToWrite() : 0;
+    switch (m_state) {
+    case st_data:
+	// pump() fills the window right after the timer was started
+	bytes += window * (block_size + 7);
+	break;
+    case st_end:
+	// the receiver computes the CRC of the stored data before it replies
+	bytes += m_size / 16;
+	break;
+    default:
+	break;
+    }
+    // a start bit, 8 data bits and a stop bit per byte
+    return static_cast<int>(bytes * 10 * 1000 / m_baud_rate) + ack_margin;
+}
+
+/**
+ * @brief Send all blocks again starting at @p block
+ * @param block block number
+ */
+void BlockXfer::go_back(qint64 block)
+{
+    m_resends++;
+    m_base = block;
+    m_next = block;
+    m_timer.start(ack_timeout());
+    pump();
+}
+
+void BlockXfer::fail(const QString& message)
+{
+    m_error = message;
+    finish(false);
+}
+
+/**
+ * @brief Stop the transfer, unmap the file, and report the result
+ * @param ok true if the file was transferred
+ */
+void BlockXfer::finish(bool ok)
+{
+    m_timer.stop();
+    if (m_dev) {
+	disconnect(m_dev, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()));
+	disconnect(m_dev, SIGNAL(aboutToClose()), this, SLOT(device_closing()));
+    }
+    m_dev = nullptr;
+    m_state = st_idle;
+    if (ok)
+	m_base = m_blocks;
+    emit progress(acknowledged(), m_size);
+    if (m_data)
+	m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_data)));
+    m_data = nullptr;
+    m_file.close();
+    DBG_BLOCKXFER("%s: %s, %d resends", __func__, ok ? "done" : "failed", m_resends);
+    emit finished(ok);
+}
@@ -0,0 +1,129 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 windowed binary file transfer
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QFile>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/**
+ * @brief The BlockXfer class sends a binary file to a receiver on the P2.
+ *
+ * The protocol is a lean sliding window protocol with go-back-N error
+ * recovery. All messages in both directions are frames of the form
+ * <pre>
+ * SOH type seq len.lo len.hi payload[len] crc.lo crc.hi
+ * </pre>
+ * where crc is the CRC-16/X.25 (see qChecksum()) of type up to the end of
+ * the payload. Multi byte values are little endian.
+ *
+ * Host to receiver:
+ * <ul>
+ * <li>'S' start: u32 size, u32 hub address (0 for the receiver's default), u16 block size</li>
+ * <li>'D' data: block number seq (mod 256), up to block size bytes</li>
+ * <li>'E' end: u32 size, u16 CRC of the entire file</li>
+ * </ul>
+ * Receiver to host:
+ * <ul>
+ * <li>'K' start accepted</li>
+ * <li>'A' acknowledge: all blocks up to and including seq were stored</li>
+ * <li>'N' not acknowledged: resend starting at block seq</li>
+ * <li>'F' finished: u16 CRC of the stored data</li>
+ * <li>'X' refused: e.g. the size does not fit</li>
+ * </ul>
+ *
+ * Up to @ref window blocks are in flight before the first is acknowledged,
+ * so there is no round trip per block and the throughput is close to the
+ * line rate. A NAK or an acknowledge timeout resends all blocks from the
+ * oldest unacknowledged one. The acknowledge timeout is the time it
+ * takes to send the data in flight at the port's baud rate plus
+ * @ref ack_margin, since the receiver's replies can only arrive after it.
+ *
+ * Like SendFile, the transfer is driven by bytesWritten() and the data
+ * which the terminal receives, which must be passed to @ref received.
+ * The transfer is cancelled when the device is about to be closed.
+ */
+class BlockXfer : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr char SOH = 0x01;
+    static constexpr int block_size = 1024;	//!< payload bytes per data frame
+    static constexpr int window = 16;		//!< blocks in flight; must be less than 128
+    static constexpr int ack_margin = 500;	//!< ms to wait for an acknowledge after the data in flight was sent
+    static constexpr qint32 default_baud = 115200;	//!< baud rate assumed for devices which are not serial ports
+    static constexpr int max_retries = 10;	//!< timeouts or NAKs in a row before giving up
+    static constexpr int progress_interval = 250;	//!< ms between progress signals
+
+    explicit BlockXfer(QObject* parent = nullptr);
+    ~BlockXfer();
+
+    bool start(QIODevice* dev, const QString& filename, quint32 address = 0);
+    void cancel();
+
+    bool running() const;
+    QString filename() const;
+    QString error_string() const;
+    qint64 acknowledged() const;
+    qint64 size() const;
+    qint64 bytes_per_second() const;
+    qint64 eta_ms() const;
+    int resends() const;
+
+    static QByteArray frame(char type, quint8 seq, const QByteArray& payload = QByteArray());
+
+signals:
+    void progress(qint64 acknowledged, qint64 total);
+    void finished(bool ok);
+
+public slots:
+    void received(const QByteArray& data);
+
+private slots:
+    void pump();
+    void timed_out();
+    void device_closing();
+
+private:
+    enum State {
+	st_idle,		    //!< not running
+	st_start,		    //!< waiting for 'K'
+	st_data,		    //!< sending blocks
+	st_end			    //!< waiting for 'F'
+    };
+
+    QPointer<QIODevice> m_dev;		    //!< device to write to
+    qint32 m_baud_rate;			    //!< baud rate for the acknowledge timeout
+    QFile m_file;			    //!< file being sent
+    const char* m_data;			    //!< mapped file contents
+    qint64 m_size;			    //!< file size
+    quint32 m_address;			    //!< hub address, or 0
+    State m_state;			    //!< protocol state
+    qint64 m_blocks;			    //!< number of blocks
+    qint64 m_base;			    //!< oldest unacknowledged block
+    qint64 m_next;			    //!< next block to send
+    int m_retries;			    //!< consecutive timeouts or NAKs
+    int m_resends;			    //!< number of go-back-N restarts
+    QByteArray m_rx;			    //!< received bytes of an incomplete frame
+    QTimer m_timer;			    //!< acknowledge timeout
+    QElapsedTimer m_clock;		    //!< time since the start
+    QElapsedTimer m_update;		    //!< time since the last progress signal
+    QString m_error;			    //!< most recent error message
+
+    void send_start();
+    void send_end();
+    void handle(char type, quint8 seq, const QByteArray& payload);
+    qint64 block_index(quint8 seq) const;
+    int ack_timeout() const;
+    void go_back(qint64 block);
+    void fail(const QString& message);
+    void finish(bool ok);
+};
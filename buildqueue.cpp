@@ -0,0 +1,213 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 bounded build job scheduler
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QThread>
+#include "buildqueue.h"
+
+BuildQueue::BuildQueue(QObject* parent, int max_jobs)
+    : QObject(parent)
+    , m_max_jobs(1)
+    , m_next_id(1)
+    , m_succeeded(0)
+    , m_failed(0)
+    , m_queue()
+    , m_running()
+    , m_timer()
+{
+    set_max_jobs(max_jobs);
+}
+
+BuildQueue::~BuildQueue()
+{
+    cancel();
+}
+
+/**
+ * @brief Return the maximum number of concurrently running jobs
+ * @return number of jobs
+ */
+int BuildQueue::max_jobs() const
+{
+    return m_max_jobs;
+}
+
+/**
+ * @brief Return the number of jobs waiting to be started
+ * @return number of jobs
+ */
+int BuildQueue::pending() const
+{
+    return m_queue.count();
+}
+
+/**
+ * @brief Return the number of currently running jobs
+ * @return number of jobs
+ */
+int BuildQueue::running() const
+{
+    return m_running.count();
+}
+
+/**
+ * @brief Return true, if jobs are pending or running
+ * @return true if busy, or false if idle
+ */
+bool BuildQueue::busy() const
+{
+    return !m_queue.isEmpty() || !m_running.isEmpty();
+}
+
+/**
+ * @brief Return the number of milliseconds since start()
+ * @return elapsed time in ms
+ */
+qint64 BuildQueue::elapsed() const
+{
+    return m_timer.isValid() ? m_timer.elapsed() : 0;
+}
+
+/**
+ * @brief Set the maximum number of concurrently running jobs
+ * @param max_jobs number of jobs; if less than 1 use QThread::idealThreadCount()
+ */
+void BuildQueue::set_max_jobs(int max_jobs)
+{
+    if (max_jobs < 1)
+	max_jobs = QThread::idealThreadCount();
+    m_max_jobs = qMax(1, max_jobs);
+}
+
+/**
+ * @brief Append a job to the queue
+ * @param program program to run
+ * @param args list of arguments
+ * @param workdir working directory for the program
+ * @return job identifier which is passed to the signals
+ */
+int BuildQueue::enqueue(const QString& program, const QStringList& args, const QString& workdir)
+{
+    Job job;
+    job.id = m_next_id++;
+    job.program = program;
+    job.args = args;
+    job.workdir = workdir;
+    m_queue.enqueue(job);
+    return job.id;
+}
+
+/**
+ * @brief Start as many queued jobs as allowed by @ref m_max_jobs
+ */
+void BuildQueue::start()
+{
+    if (m_running.isEmpty()) {
+	m_succeeded = 0;
+	m_failed = 0;
+	m_timer.start();
+    }
+    while (m_running.count() < m_max_jobs && !m_queue.isEmpty())
+	launch(m_queue.dequeue());
+    if (m_running.isEmpty())
+	emit all_finished(m_succeeded, m_failed);
+}
+
+/**
+ * @brief Drop all pending jobs and kill the running ones
+ */
+void BuildQueue::cancel()
+{
+    m_queue.clear();
+    const QList<QProcess*> processes = m_running.keys();
+    m_running.clear();
+    foreach(QProcess* process, processes) {
+	process->disconnect(this);
+	process->kill();
+	process->waitForFinished(100);
+	process->deleteLater();
+    }
+}
+
+/**
+ * @brief Create a QProcess for @p job and start it asynchronously
+ * @param job const reference to the Job to start
+ */
+void BuildQueue::launch(const Job& job)
+{
+    QProcess* process = new QProcess(this);
+    process->setProgram(job.program);
+#if defined(Q_OS_WIN)
+    // Windows really sucks: not even argument passing to a process works as elsewhere
+    process->setNativeArguments(job.args.join(QChar::Space));
+#else
+    process->setArguments(job.args);
+#endif
+    if (!job.workdir.isEmpty())
+	process->setWorkingDirectory(job.workdir);
+
+    bool ok;
+    ok = connect(process, QOverload<int,QProcess::ExitStatus>::of(&QProcess::finished),
+		 this, &BuildQueue::process_finished);
+    Q_ASSERT(ok);
+    ok = connect(process, &QProcess::errorOccurred,
+		 this, &BuildQueue::process_error);
+    Q_ASSERT(ok);
+
+    m_running.insert(process, job.id);
+    emit job_started(job.id);
+    process->start();
+}
+
+/**
+ * @brief Finish a job, emit its results and start the next one
+ * @param process pointer to the QProcess which finished
+ * @param ok true if the job succeeded
+ * @param exit_code exit code of the process
+ */
+void BuildQueue::done(QProcess* process, bool ok, int exit_code)
+{
+    if (!m_running.contains(process))
+	return;
+    const int id = m_running.take(process);
+    const QString output = QString::fromUtf8(process->readAllStandardOutput());
+    QString errors = QString::fromUtf8(process->readAllStandardError());
+    if (!ok && errors.isEmpty())
+	errors = process->errorString();
+    process->deleteLater();
+
+    if (ok) {
+	m_succeeded++;
+    } else {
+	m_failed++;
+    }
+    emit job_finished(id, ok, exit_code, output, errors);
+
+    while (m_running.count() < m_max_jobs && !m_queue.isEmpty())
+	launch(m_queue.dequeue());
+    if (m_running.isEmpty())
+	emit all_finished(m_succeeded, m_failed);
+}
+
+void BuildQueue::process_finished(int exit_code, QProcess::ExitStatus status)
+{
+    QProcess* process = qobject_cast<QProcess*>(sender());
+    if (!process)
+	return;
+    done(process, QProcess::NormalExit == status && 0 == exit_code, exit_code);
+}
+
+void BuildQueue::process_error(QProcess::ProcessError error)
+{
+    QProcess* process = qobject_cast<QProcess*>(sender());
+    if (!process)
+	return;
+    // Only a failure to start is not followed by finished()
+    if (QProcess::FailedToStart == error)
+	done(process, false, -1);
+}
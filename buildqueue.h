@@ -0,0 +1,74 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 bounded build job scheduler
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QHash>
+#include <QStringList>
+
+/**
+ * @brief The BuildQueue class runs a number of external processes
+ * (e.g. flexspin) concurrently, but never more than @ref max_jobs at a time.
+ *
+ * Jobs are started asynchronously as QProcess instances and the
+ * queue is refilled whenever one of the running jobs finishes,
+ * so the total time is roughly that of the slowest job(s).
+ */
+class BuildQueue : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BuildQueue(QObject* parent = nullptr, int max_jobs = -1);
+    ~BuildQueue();
+
+    int max_jobs() const;
+    int pending() const;
+    int running() const;
+    bool busy() const;
+    qint64 elapsed() const;
+
+    int enqueue(const QString& program, const QStringList& args,
+		const QString& workdir = QString());
+
+signals:
+    void job_started(int id);
+    void job_finished(int id, bool ok, int exit_code, const QString& output, const QString& errors);
+    void all_finished(int succeeded, int failed);
+
+public slots:
+    void set_max_jobs(int max_jobs = -1);
+    void start();
+    void cancel();
+
+private slots:
+    void process_finished(int exit_code, QProcess::ExitStatus status);
+    void process_error(QProcess::ProcessError error);
+
+private:
+    struct Job {
+	int id;			    //!< job identifier returned by enqueue()
+	QString program;	    //!< program to run
+	QStringList args;	    //!< program arguments
+	QString workdir;	    //!< working directory (if not empty)
+    };
+
+    int m_max_jobs;		    //!< maximum number of concurrent jobs
+    int m_next_id;		    //!< next job identifier
+    int m_succeeded;		    //!< number of jobs which succeeded
+    int m_failed;		    //!< number of jobs which failed
+    QQueue<Job> m_queue;	    //!< jobs waiting to be started
+    QHash<QProcess*,int> m_running;  //!< running processes and their job identifiers
+    QElapsedTimer m_timer;	    //!< time since start()
+
+    void launch(const Job& job);
+    void done(QProcess* process, bool ok, int exit_code);
+};
@@ -0,0 +1,409 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial capture to disk
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QtConcurrent>
+#include <QtEndian>
+#include "capture.h"
+
+#define	DEBUG_CAPTURE	0
+
+#if defined(DEBUG_CAPTURE) && (DEBUG_CAPTURE != 0)
+#define	DBG_CAPTURE(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_CAPTURE(X,...) /* X */
+#endif
+
+const char Capture::index_magic[8] = {'Q','F','P','C','I','D','X','1'};
+
+Capture::Capture(QObject* parent)
+    : QThread(parent)
+    , m_mutex()
+    , m_wakeup()
+    , m_queue()
+    , m_queued(0)
+    , m_queue_size(default_queue_size)
+    , m_capturing(false)
+    , m_stop(false)
+    , m_clock()
+    , m_start_ms(0)
+    , m_basename()
+    , m_segment_size(default_segment_size)
+    , m_compress(false)
+    , m_written(0)
+    , m_dropped(0)
+    , m_segments(0)
+    , m_data()
+    , m_index()
+    , m_buffer()
+    , m_offset(0)
+    , m_index_ns(0)
+    , m_failed(false)
+    , m_compressors()
+{
+}
+
+Capture::~Capture()
+{
+    stop();
+}
+
+/**
+ * @brief Start capturing to a new set of segment files
+ * @param basename path and base name of the files
+ * @param segment_size rotate segments after this many bytes
+ * @param compress if true, compress finished segments
+ * @return true on success, or false if already capturing
+ */
+bool Capture::start(const QString& basename, qint64 segment_size, bool compress)
+{
+    if (isRunning())
+	return false;
+
+    m_basename = basename;
+    m_segment_size = qMax<qint64>(write_size, segment_size);
+    m_compress = compress;
+    m_written = 0;
+    m_dropped = 0;
+    m_segments = 0;
+    m_queue.clear();
+    m_queued = 0;
+    m_stop = false;
+    m_failed = false;
+    m_start_ms = QDateTime::currentMSecsSinceEpoch();
+    m_clock.start();
+    m_capturing = true;
+    QThread::start(QThread::LowPriority);
+    return true;
+}
+
+/**
+ * @brief Stop capturing and wait until the queued data is written
+ */
+void Capture::stop()
+{
+    if (!isRunning())
+	return;
+    m_mutex.lock();
+    m_capturing = false;
+    m_stop = true;
+    m_wakeup.wakeOne();
+    m_mutex.unlock();
+    wait();
+}
+
+/**
+ * @brief Queue received data to be written
+ * This never blocks on disk I/O. If the writer can't keep up and
+ * the queue is over its budget, the data is dropped and counted.
+ * @param data const reference to the QByteArray with the data
+ */
+void Capture::append(const QByteArray& data)
+{
+    if (data.isEmpty())
+	return;
+    QMutexLocker lock(&m_mutex);
+    if (!m_capturing)
+	return;
+    if (m_queued + data.size() > m_queue_size) {
+	m_dropped += static_cast<quint64>(data.size());
+	return;
+    }
+    Chunk chunk;
+    chunk.ns = m_clock.nsecsElapsed();
+    chunk.data = data;
+    m_queue.enqueue(chunk);
+    m_queued += data.size();
+    m_wakeup.wakeOne();
+}
+
+/**
+ * @brief Return true while capturing
+ * @return true if data is accepted
+ */
+bool Capture::capturing() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_capturing;
+}
+
+/**
+ * @brief Return the base name of the files
+ * @return path and base name
+ */
+QString Capture::basename() const
+{
+    return m_basename;
+}
+
+/**
+ * @brief Return the number of bytes written to disk
+ * @return number of bytes
+ */
+quint64 Capture::bytes_written() const
+{
+    return m_written;
+}
+
+/**
+ * @brief Return the number of bytes dropped because the queue was full or writing failed
+ * @return number of bytes
+ */
+quint64 Capture::bytes_dropped() const
+{
+    return m_dropped;
+}
+
+/**
+ * @brief Return the number of segments started
+ * @return number of segments
+ */
+int Capture::segments() const
+{
+    return m_segments;
+}
+
+/**
+ * @brief Return the name of a segment file
+ * @param basename path and base name of the files
+ * @param segment segment number
+ * @return file name
+ */
+QString Capture::segment_name(const QString& basename, int segment)
+{
+    return QString("%1.%2.cap").arg(basename).arg(segment, 4, 10, QChar('0'));
+}
+
+/**
+ * @brief Return the name of a segment's index file
+ * @param basename path and base name of the files
+ * @param segment segment number
+ * @return file name
+ */
+QString Capture::index_name(const QString& basename, int segment)
+{
+    return QString("%1.%2.idx").arg(basename).arg(segment, 4, 10, QChar('0'));
+}
+
+/**
+ * @brief Return the name of a compressed segment file
+ * @param basename path and base name of the files
+ * @param segment segment number
+ * @return file name
+ */
+QString Capture::compressed_name(const QString& basename, int segment)
+{
+    return segment_name(basename, segment) + QLatin1String(".z");
+}
+
+/**
+ * @brief Compress a segment file in blocks and remove it
+ * This runs in a thread pool worker.
+ * @param filename name of the segment file
+ * @param compressed name of the compressed file
+ * @return true on success
+ */
+bool Capture::compress(const QString& filename, const QString& compressed)
+{
+    QFile src(filename);
+    if (!src.open(QIODevice::ReadOnly))
+	return false;
+    QFile dst(compressed);
+    if (!dst.open(QIODevice::WriteOnly))
+	return false;
+
+    while (!src.atEnd()) {
+	const QByteArray block = qCompress(src.read(block_size));
+	uchar size[4];
+	qToLittleEndian<quint32>(static_cast<quint32>(block.size()), size);
+	if (dst.write(reinterpret_cast<const char*>(size), sizeof(size)) != sizeof(size) ||
+	    dst.write(block) != block.size()) {
+	    dst.remove();
+	    return false;
+	}
+    }
+    dst.close();
+    src.close();
+    DBG_CAPTURE("%s: %s -> %s", __func__, qPrintable(filename), qPrintable(compressed));
+    return src.remove();
+}
+
+/**
+ * @brief Writer thread
+ */
+void Capture::run()
+{
+    int segment = 0;
+    m_buffer.reserve(write_size + 64 * 1024);
+    if (!open_segment(segment))
+	return;
+
+    QElapsedTimer flushed;
+    flushed.start();
+    bool stop = false;
+    while (!stop) {
+	QQueue<Chunk> chunks;
+	m_mutex.lock();
+	if (m_queue.isEmpty() && !m_stop)
+	    m_wakeup.wait(&m_mutex, flush_interval);
+	chunks.swap(m_queue);
+	m_queued = 0;
+	stop = m_stop;
+	m_mutex.unlock();
+
+	const bool idle = chunks.isEmpty();
+	while (!chunks.isEmpty()) {
+	    if (m_offset >= m_segment_size) {
+		close_segment(segment);
+		if (!open_segment(++segment)) {
+		    // nowhere to write the rest to
+		    foreach(const Chunk& chunk, chunks)
+			m_dropped += static_cast<quint64>(chunk.data.size());
+		    chunks.clear();
+		    stop = true;
+		    break;
+		}
+	    }
+	    write_chunk(chunks.dequeue());
+	}
+
+	// write what has been buffered at least every flush_interval,
+	// also while data keeps arriving
+	if (idle || flushed.elapsed() >= flush_interval) {
+	    flush();
+	    flushed.restart();
+	}
+    }
+    close_segment(segment);
+    m_compressors.waitForFinished();
+    m_compressors.clearFutures();
+}
+
+/**
+ * @brief Open the files of a new segment
+ * @param segment segment number
+ * @return true on success
+ */
+bool Capture::open_segment(int segment)
+{
+    m_data.setFileName(segment_name(m_basename, segment));
+    if (!m_data.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+	fail(tr("Could not create capture file %1: %2")
+	     .arg(m_data.fileName())
+	     .arg(m_data.errorString()));
+	return false;
+    }
+    m_index.setFileName(index_name(m_basename, segment));
+    if (!m_index.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+	fail(tr("Could not create capture index %1: %2")
+	     .arg(m_index.fileName())
+	     .arg(m_index.errorString()));
+	m_data.close();
+	return false;
+    }
+    uchar start[8];
+    qToLittleEndian<qint64>(m_start_ms, start);
+    m_index.write(index_magic, sizeof(index_magic));
+    m_index.write(reinterpret_cast<const char*>(start), sizeof(start));
+    m_offset = 0;
+    m_index_ns = -1;
+    m_segments.ref();
+    DBG_CAPTURE("%s: %s", __func__, qPrintable(m_data.fileName()));
+    return true;
+}
+
+/**
+ * @brief Write the remaining data and close the files of a segment
+ * Compression of the segment is started in a thread pool worker.
+ * @param segment segment number
+ */
+void Capture::close_segment(int segment)
+{
+    if (!m_data.isOpen())
+	return;
+    flush();
+    m_data.close();
+    m_index.close();
+    const QString filename = m_data.fileName();
+    if (m_compress && !m_failed) {
+	m_compressors.addFuture(QtConcurrent::run(Capture::compress, filename,
+						  compressed_name(m_basename, segment)));
+    }
+    emit segment_finished(filename);
+}
+
+/**
+ * @brief Append a chunk to the buffer and add an index record if it is due
+ * @param chunk const reference to the Chunk
+ */
+void Capture::write_chunk(const Chunk& chunk)
+{
+    if (m_failed) {
+	m_dropped += static_cast<quint64>(chunk.data.size());
+	return;
+    }
+    if (m_index_ns < 0 || chunk.ns - m_index_ns >= index_interval)
+	write_index(chunk.ns, m_offset);
+    m_buffer += chunk.data;
+    m_offset += chunk.data.size();
+    if (m_buffer.size() >= write_size)
+	flush();
+}
+
+/**
+ * @brief Add a record to the index
+ * @param ns time in ns since the start
+ * @param offset offset into the segment
+ */
+void Capture::write_index(qint64 ns, qint64 offset)
+{
+    uchar record[16];
+    qToLittleEndian<qint64>(ns, record);
+    qToLittleEndian<qint64>(offset, record + 8);
+    m_index.write(reinterpret_cast<const char*>(record), sizeof(record));
+    m_index_ns = ns;
+}
+
+/**
+ * @brief Write the buffered data to the segment file
+ */
+void Capture::flush()
+{
+    if (m_buffer.isEmpty() || !m_data.isOpen())
+	return;
+    const qint64 written = m_data.write(m_buffer);
+    if (written != m_buffer.size()) {
+	m_dropped += static_cast<quint64>(m_buffer.size() - qMax<qint64>(0, written));
+	fail(tr("Could not write capture file %1: %2")
+	     .arg(m_data.fileName())
+	     .arg(m_data.errorString()));
+    }
+    if (written > 0)
+	m_written += static_cast<quint64>(written);
+    m_data.flush();
+    m_index.flush();
+    // keep the capacity
+    m_buffer.resize(0);
+}
+
+/**
+ * @brief Stop accepting data and report an error
+ * @param message error message
+ */
+void Capture::fail(const QString& message)
+{
+    if (m_failed)
+	return;
+    m_failed = true;
+    m_mutex.lock();
+    m_capturing = false;
+    m_mutex.unlock();
+    emit failed(message);
+}
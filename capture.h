@@ -0,0 +1,120 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial capture to disk
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QFutureSynchronizer>
+
+/**
+ * @brief The Capture class appends the raw bytes received from the serial port to disk.
+ *
+ * The GUI thread hands received data to @ref append, which only queues
+ * the (implicitly shared) QByteArray with a monotonic timestamp. If the
+ * queue is over its budget, the data is dropped and counted instead, so
+ * capturing can never slow down the terminal.
+ *
+ * A writer thread collects the queued data in a large buffer and writes
+ * it in big blocks to a segment file. Segments are rotated when they
+ * reach a given size. Every segment has an index file with a sparse
+ * list of timestamps and the offsets of the data received at that time.
+ * Finished segments can be compressed in blocks by a thread pool worker.
+ *
+ * Files written for a base name "name":
+ * <ul>
+ * <li>name.NNNN.cap: raw data of segment NNNN</li>
+ * <li>name.NNNN.idx: index; header @ref index_magic, qint64 start time
+ * in ms since the epoch (UTC), and records of qint64 ns since the start
+ * and qint64 offset into the segment, all little endian</li>
+ * <li>name.NNNN.cap.z: compressed segment; blocks of @ref block_size
+ * bytes, each stored as quint32 size (little endian) and qCompress() data</li>
+ * </ul>
+ */
+class Capture : public QThread
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 default_segment_size = 64 * 1024 * 1024;	//!< rotate segments after this many bytes
+    static constexpr qint64 default_queue_size = 16 * 1024 * 1024;	//!< drop data if more than this is queued
+    static constexpr int write_size = 1024 * 1024;			//!< write to disk in blocks of this size
+    static constexpr int flush_interval = 500;				//!< write partial blocks after this many ms
+    static constexpr qint64 index_interval = 100 * 1000 * 1000;		//!< add an index record after this many ns
+    static constexpr int block_size = 1024 * 1024;			//!< compression block size
+    static const char index_magic[8];
+
+    explicit Capture(QObject* parent = nullptr);
+    ~Capture();
+
+    bool start(const QString& basename,
+	       qint64 segment_size = default_segment_size,
+	       bool compress = false);
+    void stop();
+    void append(const QByteArray& data);
+
+    bool capturing() const;
+    QString basename() const;
+    quint64 bytes_written() const;
+    quint64 bytes_dropped() const;
+    int segments() const;
+
+    static QString segment_name(const QString& basename, int segment);
+    static QString index_name(const QString& basename, int segment);
+    static QString compressed_name(const QString& basename, int segment);
+    static bool compress(const QString& filename, const QString& compressed);
+
+signals:
+    void segment_finished(const QString& filename);
+    void failed(const QString& message);
+
+protected:
+    void run() override;
+
+private:
+    struct Chunk {
+	qint64 ns;		    //!< time of arrival in ns since start
+	QByteArray data;	    //!< received data
+    };
+
+    mutable QMutex m_mutex;		    //!< protects the queue and flags
+    QWaitCondition m_wakeup;		    //!< wakes the writer thread
+    QQueue<Chunk> m_queue;		    //!< data waiting to be written
+    qint64 m_queued;			    //!< number of bytes in m_queue
+    qint64 m_queue_size;		    //!< maximum number of bytes in m_queue
+    bool m_capturing;			    //!< true while accepting data
+    bool m_stop;			    //!< tells the writer thread to finish
+    QElapsedTimer m_clock;		    //!< monotonic clock since start
+    qint64 m_start_ms;			    //!< wall clock time of start in ms since the epoch
+    QString m_basename;			    //!< base name of the files
+    qint64 m_segment_size;		    //!< segment rotation size
+    bool m_compress;			    //!< compress finished segments
+    QAtomicInteger<quint64> m_written;	    //!< number of bytes written
+    QAtomicInteger<quint64> m_dropped;	    //!< number of bytes dropped
+    QAtomicInt m_segments;		    //!< number of segments started
+
+    // used by the writer thread only
+    QFile m_data;			    //!< current segment
+    QFile m_index;			    //!< current segment's index
+    QByteArray m_buffer;		    //!< data not yet written to m_data
+    qint64 m_offset;			    //!< offset of the end of m_buffer in the segment
+    qint64 m_index_ns;			    //!< time of the most recent index record
+    bool m_failed;			    //!< a write failed; drop everything
+    QFutureSynchronizer<bool> m_compressors;  //!< running compressions
+
+    bool open_segment(int segment);
+    void close_segment(int segment);
+    void write_chunk(const Chunk& chunk);
+    void write_index(qint64 ns, qint64 offset);
+    void flush();
+    void fail(const QString& message);
+};
@@ -0,0 +1,367 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial capture reader
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QRegularExpression>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include "capture.h"
+#include "capturefile.h"
+
+#define	DEBUG_CAPTUREFILE	0
+
+#if defined(DEBUG_CAPTUREFILE) && (DEBUG_CAPTUREFILE != 0)
+#define	DBG_CAPTUREFILE(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_CAPTUREFILE(X,...) /* X */
+#endif
+
+CaptureFile::CaptureFile()
+    : m_basename()
+    , m_error()
+    , m_segments()
+    , m_records()
+    , m_size(0)
+    , m_start_ms(0)
+    , m_block_segment(-1)
+    , m_block_index(-1)
+    , m_block()
+{
+}
+
+CaptureFile::~CaptureFile()
+{
+    close();
+}
+
+/**
+ * @brief Return the base name of a capture from the name of one of its files
+ * @param filename name of a segment, compressed segment, or index file
+ * @return path and base name
+ */
+QString CaptureFile::basename(const QString& filename)
+{
+    static const QRegularExpression re(QStringLiteral("^(.*)\\.\\d{4}\\.(cap|cap\\.z|idx)$"));
+    const QRegularExpressionMatch match = re.match(filename);
+    return match.hasMatch() ? match.captured(1) : filename;
+}
+
+/**
+ * @brief Open all segments of a capture
+ * @param filename name of one of the capture's files, or its base name
+ * @return true on success, or false if no segment was found
+ */
+bool CaptureFile::open(const QString& filename)
+{
+    close();
+    m_basename = basename(filename);
+    for (int segment = 0; open_segment(segment); segment++)
+	;
+    if (m_segments.isEmpty()) {
+	if (m_error.isEmpty())
+	    m_error = QObject::tr("No capture segments found for %1.").arg(m_basename);
+	return false;
+    }
+    DBG_CAPTUREFILE("%s: %s: %d segments, %lld bytes, %d index records", __func__,
+		    qPrintable(m_basename), m_segments.count(), m_size, m_records.count());
+    return true;
+}
+
+/**
+ * @brief Unmap and close all segments
+ */
+void CaptureFile::close()
+{
+    foreach(const Segment& seg, m_segments) {
+	if (seg.data)
+	    seg.file->unmap(reinterpret_cast<uchar*>(const_cast<char*>(seg.data)));
+	seg.file->close();
+    }
+    m_segments.clear();
+    m_records.clear();
+    m_error.clear();
+    m_size = 0;
+    m_start_ms = 0;
+    m_block_segment = -1;
+    m_block_index = -1;
+    m_block.clear();
+}
+
+/**
+ * @brief Return the path and base name of the capture
+ * @return base name
+ */
+QString CaptureFile::basename() const
+{
+    return m_basename;
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString CaptureFile::error_string() const
+{
+    return m_error;
+}
+
+/**
+ * @brief Return the total number of bytes in all segments
+ * @return size in bytes
+ */
+qint64 CaptureFile::size() const
+{
+    return m_size;
+}
+
+/**
+ * @brief Return the time when the last byte was received
+ * @return time in ns since the start
+ */
+qint64 CaptureFile::duration() const
+{
+    return time(m_size);
+}
+
+/**
+ * @brief Return the time when the capture was started
+ * @return wall clock time in ms since the epoch (UTC)
+ */
+qint64 CaptureFile::start_ms() const
+{
+    return m_start_ms;
+}
+
+static bool record_ns_less(qint64 ns, const CaptureFile::Record& r)
+{
+    return ns < r.ns;
+}
+
+static bool record_offset_less(qint64 offset, const CaptureFile::Record& r)
+{
+    return offset < r.offset;
+}
+
+/**
+ * @brief Return the stream offset of the data received up to a time
+ *
+ * The index has one record at most every Capture::index_interval,
+ * and the data following a record was received within that interval,
+ * so the offset is interpolated over it.
+ * @param ns time in ns since the start
+ * @return stream offset
+ */
+qint64 CaptureFile::offset(qint64 ns) const
+{
+    if (m_records.isEmpty())
+	return ns > 0 ? m_size : 0;
+    QVector<Record>::const_iterator it = std::upper_bound(m_records.constBegin(), m_records.constEnd(),
+							  ns, record_ns_less);
+    if (it == m_records.constBegin())
+	return 0;
+    const Record& r = *(it - 1);
+    const bool last = it == m_records.constEnd();
+    const qint64 end = last ? m_size : it->offset;
+    const qint64 interval = Capture::index_interval;
+    const qint64 window = last ? interval : qMin(it->ns - r.ns, interval);
+    const qint64 dt = ns - r.ns;
+    if (window <= 0 || dt >= window)
+	return end;
+    return r.offset + (end - r.offset) * dt / window;
+}
+
+/**
+ * @brief Return the time when the byte at a stream offset was received
+ * This is the inverse of @ref offset.
+ * @param offset stream offset
+ * @return time in ns since the start
+ */
+qint64 CaptureFile::time(qint64 offset) const
+{
+    if (m_records.isEmpty())
+	return 0;
+    QVector<Record>::const_iterator it = std::upper_bound(m_records.constBegin(), m_records.constEnd(),
+							  offset, record_offset_less);
+    if (it == m_records.constBegin())
+	return m_records.first().ns;
+    const Record& r = *(it - 1);
+    const bool last = it == m_records.constEnd();
+    const qint64 end = last ? m_size : it->offset;
+    const qint64 interval = Capture::index_interval;
+    const qint64 window = last ? interval : qMin(it->ns - r.ns, interval);
+    if (end <= r.offset)
+	return r.ns;
+    return r.ns + window * (qMin(offset, end) - r.offset) / (end - r.offset);
+}
+
+static bool segment_less(qint64 offset, const CaptureFile::Segment& seg)
+{
+    return offset < seg.base;
+}
+
+/**
+ * @brief Read bytes from the stream
+ * @param offset stream offset of the first byte
+ * @param len number of bytes to read
+ * @return QByteArray with the data; shorter than @p len at the end of the stream
+ */
+QByteArray CaptureFile::read(qint64 offset, qint64 len) const
+{
+    QByteArray result;
+    len = qMin(len, m_size - offset);
+    if (offset < 0 || len <= 0)
+	return result;
+    result.reserve(static_cast<int>(len));
+
+    QVector<Segment>::const_iterator it = std::upper_bound(m_segments.constBegin(), m_segments.constEnd(),
+							   offset, segment_less);
+    int segment = static_cast<int>(it - m_segments.constBegin()) - 1;
+    while (len > 0 && segment >= 0 && segment < m_segments.count()) {
+	const Segment& seg = m_segments[segment];
+	const qint64 pos = offset - seg.base;
+	if (pos >= seg.size) {
+	    segment++;
+	    continue;
+	}
+	qint64 avail = seg.size - pos;
+	const char* src = seg.compressed ? block(segment, pos, &avail) : seg.data + pos;
+	if (!src)
+	    break;
+	const qint64 n = qMin(len, avail);
+	result.append(src, static_cast<int>(n));
+	offset += n;
+	len -= n;
+    }
+    return result;
+}
+
+/**
+ * @brief Open a segment and its index
+ * @param segment segment number
+ * @return true on success, or false if the segment does not exist
+ */
+bool CaptureFile::open_segment(int segment)
+{
+    Segment seg;
+    seg.compressed = false;
+    seg.data = nullptr;
+    seg.base = m_size;
+    seg.size = 0;
+
+    const QString plain = Capture::segment_name(m_basename, segment);
+    const QString compressed = Capture::compressed_name(m_basename, segment);
+    if (QFile::exists(plain)) {
+	seg.file.reset(new QFile(plain));
+    } else if (QFile::exists(compressed)) {
+	seg.file.reset(new QFile(compressed));
+	seg.compressed = true;
+    } else {
+	return false;
+    }
+    if (!seg.file->open(QIODevice::ReadOnly)) {
+	m_error = QObject::tr("Could not open capture file %1: %2")
+		  .arg(seg.file->fileName())
+		  .arg(seg.file->errorString());
+	return false;
+    }
+
+    const qint64 fsize = seg.file->size();
+    if (!seg.compressed) {
+	seg.size = fsize;
+	if (fsize > 0) {
+	    seg.data = reinterpret_cast<const char*>(seg.file->map(0, fsize));
+	    if (!seg.data) {
+		m_error = QObject::tr("Could not map capture file %1: %2")
+			  .arg(seg.file->fileName())
+			  .arg(seg.file->errorString());
+		return false;
+	    }
+	}
+    } else {
+	// each block is a quint32 LE size and qCompress() data,
+	// which starts with the uncompressed size as quint32 BE
+	qint64 pos = 0;
+	while (pos + 8 <= fsize) {
+	    uchar head[8];
+	    seg.file->seek(pos);
+	    if (seg.file->read(reinterpret_cast<char*>(head), sizeof(head)) != sizeof(head))
+		break;
+	    seg.blocks += pos;
+	    seg.size += qFromBigEndian<quint32>(head + 4);
+	    pos += 4 + qFromLittleEndian<quint32>(head);
+	}
+    }
+
+    load_index(segment, seg.base);
+    m_size += seg.size;
+    m_segments += seg;
+    return true;
+}
+
+/**
+ * @brief Load the index records of a segment
+ * @param segment segment number
+ * @param base stream offset of the segment
+ * @return true on success, or false if the index is missing or invalid
+ */
+bool CaptureFile::load_index(int segment, qint64 base)
+{
+    QFile file(Capture::index_name(m_basename, segment));
+    QByteArray data;
+    if (file.open(QIODevice::ReadOnly))
+	data = file.readAll();
+    if (data.size() < 16 || memcmp(data.constData(), Capture::index_magic, sizeof(Capture::index_magic))) {
+	// without an index the segment continues where the previous one ended
+	Record r;
+	r.ns = m_records.isEmpty() ? 0 : m_records.last().ns;
+	r.offset = base;
+	m_records += r;
+	return false;
+    }
+
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+    if (0 == segment)
+	m_start_ms = qFromLittleEndian<qint64>(p + 8);
+    for (int pos = 16; pos + 16 <= data.size(); pos += 16) {
+	Record r;
+	r.ns = qFromLittleEndian<qint64>(p + pos);
+	r.offset = base + qFromLittleEndian<qint64>(p + pos + 8);
+	m_records += r;
+    }
+    return true;
+}
+
+/**
+ * @brief Return a pointer into the decompressed block of a compressed segment
+ * @param segment segment number
+ * @param offset offset into the segment
+ * @param avail pointer to a qint64 receiving the number of bytes available
+ * @return pointer to the data, or nullptr if the block can't be read
+ */
+const char* CaptureFile::block(int segment, qint64 offset, qint64* avail) const
+{
+    const Segment& seg = m_segments[segment];
+    const int index = static_cast<int>(offset / Capture::block_size);
+    if (index >= seg.blocks.count())
+	return nullptr;
+    if (segment != m_block_segment || index != m_block_index) {
+	uchar head[4];
+	seg.file->seek(seg.blocks[index]);
+	if (seg.file->read(reinterpret_cast<char*>(head), sizeof(head)) != sizeof(head))
+	    return nullptr;
+	m_block = qUncompress(seg.file->read(qFromLittleEndian<quint32>(head)));
+	m_block_segment = segment;
+	m_block_index = index;
+    }
+    const int pos = static_cast<int>(offset % Capture::block_size);
+    if (pos >= m_block.size())
+	return nullptr;
+    *avail = m_block.size() - pos;
+    return m_block.constData() + pos;
+}
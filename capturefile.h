@@ -0,0 +1,76 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial capture reader
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QByteArray>
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The CaptureFile class reads the files written by @ref Capture.
+ *
+ * All segments of a capture are presented as one contiguous stream of
+ * bytes. Plain segments are memory mapped, compressed segments are
+ * decompressed one block at a time when they are read.
+ *
+ * The index records of all segments are merged into one list sorted by
+ * time, so converting between time and stream offset is a binary search.
+ */
+class CaptureFile
+{
+public:
+    struct Record {
+	qint64 ns;		    //!< time in ns since the start
+	qint64 offset;		    //!< stream offset
+    };
+
+    struct Segment {
+	QSharedPointer<QFile> file; //!< segment file
+	bool compressed;	    //!< true if stored in compressed blocks
+	const char* data;	    //!< mapped data of a plain segment
+	qint64 base;		    //!< stream offset of the first byte
+	qint64 size;		    //!< number of (uncompressed) bytes
+	QVector<qint64> blocks;	    //!< file offsets of the compressed blocks
+    };
+
+    CaptureFile();
+    ~CaptureFile();
+
+    bool open(const QString& filename);
+    void close();
+
+    QString basename() const;
+    QString error_string() const;
+    qint64 size() const;
+    qint64 duration() const;
+    qint64 start_ms() const;
+
+    qint64 offset(qint64 ns) const;
+    qint64 time(qint64 offset) const;
+    QByteArray read(qint64 offset, qint64 len) const;
+
+    static QString basename(const QString& filename);
+
+private:
+    QString m_basename;		    //!< path and base name of the files
+    QString m_error;		    //!< most recent error message
+    QVector<Segment> m_segments;    //!< segments in stream order
+    QVector<Record> m_records;	    //!< index records sorted by time
+    qint64 m_size;		    //!< total number of bytes
+    qint64 m_start_ms;		    //!< start time in ms since the epoch
+    mutable int m_block_segment;    //!< segment of the cached block
+    mutable int m_block_index;	    //!< index of the cached block
+    mutable QByteArray m_block;	    //!< cached decompressed block
+
+    bool open_segment(int segment);
+    bool load_index(int segment, qint64 base);
+    const char* block(int segment, qint64 offset, qint64* avail) const;
+};
@@ -0,0 +1,387 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 source dependency graph
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <cctype>
+#include <cstring>
+#include "depgraph.h"
+#include "propconst.h"
+
+#define	DEBUG_DEPGRAPH	0
+
+#if defined(DEBUG_DEPGRAPH) && (DEBUG_DEPGRAPH != 0)
+#define	DBG_DEPGRAPH(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_DEPGRAPH(X,...) /* X */
+#endif
+
+/**
+ * @brief Return the key under which a file is stored in the graph
+ * @param filename relative or absolute file name
+ * @return cleaned absolute file path
+ */
+static QString node_key(const QString& filename)
+{
+    return QDir::cleanPath(QFileInfo(filename).absoluteFilePath());
+}
+
+/**
+ * @brief Return the modification time of a file
+ * @param filename file name
+ * @return milliseconds since epoch, or -1 if the file does not exist
+ */
+static qint64 file_mtime(const QString& filename)
+{
+    const QFileInfo info(filename);
+    if (!info.exists())
+	return -1;
+    return info.lastModified().toMSecsSinceEpoch();
+}
+
+DepGraph::DepGraph(QObject* parent)
+    : QObject(parent)
+    , m_watcher()
+    , m_include_paths()
+    , m_nodes()
+    , m_users()
+{
+    bool ok;
+    ok = connect(&m_watcher, &QFileSystemWatcher::fileChanged,
+		 this, &DepGraph::file_changed);
+    Q_ASSERT(ok);
+}
+
+/**
+ * @brief Return the include paths used to resolve references
+ * @return QStringList with the paths
+ */
+QStringList DepGraph::include_paths() const
+{
+    return m_include_paths;
+}
+
+/**
+ * @brief Set the include paths used to resolve references
+ * Changing the paths drops the graph, because references may resolve differently.
+ * @param include_paths list of directories
+ */
+void DepGraph::set_include_paths(const QStringList& include_paths)
+{
+    if (include_paths == m_include_paths)
+	return;
+    m_include_paths = include_paths;
+    clear();
+}
+
+/**
+ * @brief Forget all files and dependencies
+ */
+void DepGraph::clear()
+{
+    const QStringList files = m_watcher.files();
+    if (!files.isEmpty())
+	m_watcher.removePaths(files);
+    m_nodes.clear();
+    m_users.clear();
+}
+
+/**
+ * @brief Return the direct dependencies of a file
+ * The file is scanned only if it was not scanned before, or if it changed since.
+ * @param filename name of the source file
+ * @return QStringList with absolute paths of the files it references
+ */
+QStringList DepGraph::dependencies(const QString& filename)
+{
+    const QString key = node_key(filename);
+    Node& n = node(key);
+    if (!n.scanned)
+	scan(key, n);
+    return n.deps;
+}
+
+/**
+ * @brief Return a file and all files it depends on, directly or indirectly
+ * @param filename name of the source file
+ * @return QSet of absolute paths
+ */
+QSet<QString> DepGraph::closure(const QString& filename)
+{
+    QSet<QString> seen;
+    QStringList todo(node_key(filename));
+    while (!todo.isEmpty()) {
+	const QString key = todo.takeLast();
+	if (seen.contains(key))
+	    continue;
+	seen.insert(key);
+	foreach(const QString& dep, dependencies(key)) {
+	    if (!seen.contains(dep))
+		todo += dep;
+	}
+    }
+    return seen;
+}
+
+/**
+ * @brief Return the newest modification time of a file and its dependencies
+ * @param filename name of the source file
+ * @return milliseconds since epoch, or -1 if the file does not exist
+ */
+qint64 DepGraph::newest(const QString& filename)
+{
+    const QString root = node_key(filename);
+    const QSet<QString> files = closure(root);
+    if (node(root).mtime < 0)
+	return -1;
+    qint64 mtime = -1;
+    foreach(const QString& key, files)
+	mtime = qMax(mtime, node(key).mtime);
+    return mtime;
+}
+
+/**
+ * @brief Return true if a file or one of its dependencies changed after @p since
+ * @param filename name of the source file
+ * @param since milliseconds since epoch of the last build (or < 0 if never built)
+ * @return true if the file needs to be rebuilt
+ */
+bool DepGraph::stale(const QString& filename, qint64 since)
+{
+    if (since < 0)
+	return true;
+    const qint64 mtime = newest(filename);
+    DBG_DEPGRAPH("%s: %s newest=%lld since=%lld", __func__,
+		 qPrintable(filename), mtime, since);
+    return mtime < 0 || mtime > since;
+}
+
+/**
+ * @brief Slot called when a watched file was modified, replaced, or removed
+ * Emits invalidated() for the file and for all files depending on it.
+ * @param path absolute path of the file
+ */
+void DepGraph::file_changed(const QString& path)
+{
+    const QString key = node_key(path);
+    if (!m_nodes.contains(key))
+	return;
+
+    Node& n = m_nodes[key];
+    n.mtime = file_mtime(key);
+    n.scanned = false;
+    // Editors which save by renaming make the watcher drop the path
+    if (n.mtime >= 0 && !m_watcher.files().contains(key))
+	m_watcher.addPath(key);
+    DBG_DEPGRAPH("%s: %s mtime=%lld", __func__, qPrintable(key), n.mtime);
+
+    QSet<QString> seen;
+    QStringList todo(key);
+    while (!todo.isEmpty()) {
+	const QString file = todo.takeLast();
+	if (seen.contains(file))
+	    continue;
+	seen.insert(file);
+	emit invalidated(file);
+	foreach(const QString& user, m_users.value(file)) {
+	    if (!seen.contains(user))
+		todo += user;
+	}
+    }
+}
+
+/**
+ * @brief Return a reference to the node for @p key and create it if needed
+ * @param key absolute file path
+ * @return reference to the Node
+ */
+DepGraph::Node& DepGraph::node(const QString& key)
+{
+    QHash<QString,Node>::iterator it = m_nodes.find(key);
+    if (it != m_nodes.end())
+	return it.value();
+
+    Node n;
+    n.mtime = file_mtime(key);
+    n.scanned = false;
+    if (n.mtime >= 0)
+	m_watcher.addPath(key);
+    return m_nodes.insert(key, n).value();
+}
+
+/**
+ * @brief Scan a file for references and update the edges of the graph
+ * @param key absolute file path
+ * @param n reference to the Node for the file
+ */
+void DepGraph::scan(const QString& key, Node& n)
+{
+    foreach(const QString& dep, n.deps)
+	m_users[dep].remove(key);
+    n.deps.clear();
+    n.scanned = true;
+
+    QFile file(key);
+    if (!file.open(QIODevice::ReadOnly))
+	return;
+    const QByteArray source = file.readAll();
+    file.close();
+
+    QStringList includes;
+    QStringList objects;
+    references(source, &includes, &objects);
+
+    foreach(const QString& name, includes) {
+	const QString path = resolve(key, name, false);
+	if (!path.isEmpty() && !n.deps.contains(path))
+	    n.deps += path;
+    }
+    foreach(const QString& name, objects) {
+	const QString path = resolve(key, name, true);
+	if (!path.isEmpty() && !n.deps.contains(path))
+	    n.deps += path;
+    }
+    foreach(const QString& dep, n.deps)
+	m_users[dep].insert(key);
+    DBG_DEPGRAPH("%s: %s -> %s", __func__, qPrintable(key),
+		 qPrintable(n.deps.join(QChar::Space)));
+}
+
+/**
+ * @brief Resolve a referenced file name like flexspin does
+ * The directory of the referencing file is searched first, then the include paths.
+ * Object references without a suffix are tried with .spin2 and .spin.
+ * @param from absolute path of the referencing file
+ * @param name referenced name
+ * @param object true if the reference comes from an OBJ section
+ * @return absolute path of the referenced file, or an empty string if not found
+ */
+QString DepGraph::resolve(const QString& from, const QString& name, bool object) const
+{
+    QStringList names;
+    if (object && QFileInfo(name).suffix().isEmpty()) {
+	names += QString("%1.spin2").arg(name);
+	names += QString("%1.spin").arg(name);
+    } else {
+	names += name;
+    }
+
+    if (QFileInfo(name).isAbsolute()) {
+	foreach(const QString& candidate, names)
+	    if (QFileInfo::exists(candidate))
+		return node_key(candidate);
+	return QString();
+    }
+
+    QStringList dirs(QFileInfo(from).absolutePath());
+    dirs += m_include_paths;
+    foreach(const QString& dir, dirs) {
+	foreach(const QString& candidate, names) {
+	    const QString path = QString("%1/%2").arg(dir).arg(candidate);
+	    if (QFileInfo::exists(path))
+		return node_key(path);
+	}
+    }
+    return QString();
+}
+
+/**
+ * @brief Extract the file names referenced by a source
+ * Sections and the include directive are taken from the CPropTokens lists,
+ * comments (single line ' and nested { }) are skipped.
+ * @param source source text
+ * @param includes pointer to a QStringList receiving #include file names
+ * @param objects pointer to a QStringList receiving OBJ file names
+ */
+void DepGraph::references(const QByteArray& source, QStringList* includes, QStringList* objects)
+{
+    static const QSet<QByteArray> sections = [] {
+	QSet<QByteArray> set;
+	foreach(const QString& name, g_tokens.list(g_sections))
+	    set.insert(name.toLatin1().toUpper());
+	return set;
+    }();
+    static const QByteArray section_obj = g_tokens.list({TOK_OBJ}).value(0).toLatin1().toUpper();
+    static const QByteArray cpp_include = g_tokens.list({TOK_CPP_INCLUDE}).value(0).toLatin1();
+
+    const char* p = source.constData();
+    const char* const end = p + source.size();
+    int depth = 0;		// nesting depth of { } comments
+    bool in_obj = false;	// true while inside an OBJ section
+
+    while (p < end) {
+	const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+	if (!eol)
+	    eol = end;
+
+	if (0 == depth) {
+	    // section names start in column 0
+	    const char* w = p;
+	    while (w < eol && (isalpha(static_cast<uchar>(*w)) || '_' == *w))
+		w++;
+	    if (w > p && (w == eol || !isalnum(static_cast<uchar>(*w)))) {
+		const QByteArray word = QByteArray(p, static_cast<int>(w - p)).toUpper();
+		if (sections.contains(word))
+		    in_obj = word == section_obj;
+	    }
+
+	    // preprocessor include directive
+	    const char* s = p;
+	    while (s < eol && isspace(static_cast<uchar>(*s)))
+		s++;
+	    if (eol - s > cpp_include.size() && 0 == qstrncmp(s, cpp_include.constData(), cpp_include.size())) {
+		s += cpp_include.size();
+		while (s < eol && isspace(static_cast<uchar>(*s)))
+		    s++;
+		if (s < eol && '"' == *s) {
+		    const char* q = static_cast<const char*>(memchr(s + 1, '"', static_cast<size_t>(eol - s - 1)));
+		    if (q)
+			*includes += QString::fromUtf8(s + 1, static_cast<int>(q - s - 1));
+		}
+		p = eol + 1;
+		continue;
+	    }
+	}
+
+	bool colon = false;
+	bool found = false;
+	for (const char* c = p; c < eol; c++) {
+	    if (depth > 0) {
+		if ('{' == *c)
+		    depth++;
+		else if ('}' == *c)
+		    depth--;
+		continue;
+	    }
+	    if ('\'' == *c)
+		break;
+	    if ('{' == *c) {
+		depth++;
+		continue;
+	    }
+	    if (':' == *c) {
+		colon = true;
+		continue;
+	    }
+	    if ('"' == *c) {
+		const char* q = static_cast<const char*>(memchr(c + 1, '"', static_cast<size_t>(eol - c - 1)));
+		if (!q)
+		    break;
+		if (in_obj && colon && !found) {
+		    *objects += QString::fromUtf8(c + 1, static_cast<int>(q - c - 1));
+		    found = true;
+		}
+		c = q;
+	    }
+	}
+	p = eol + 1;
+    }
+}
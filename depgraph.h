@@ -0,0 +1,64 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 source dependency graph
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+/**
+ * @brief The DepGraph class keeps track of the files a source depends on.
+ *
+ * Sources are scanned for references in OBJ sections and for #include
+ * directives. The references are resolved against the directory of the
+ * referencing file and the flexspin include paths. Scan results and file
+ * modification times are cached and kept up to date by a QFileSystemWatcher,
+ * so deciding whether a build is stale does not touch the file system.
+ */
+class DepGraph : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DepGraph(QObject* parent = nullptr);
+
+    QStringList include_paths() const;
+    QStringList dependencies(const QString& filename);
+    QSet<QString> closure(const QString& filename);
+    qint64 newest(const QString& filename);
+    bool stale(const QString& filename, qint64 since);
+
+signals:
+    void invalidated(const QString& filename);
+
+public slots:
+    void set_include_paths(const QStringList& include_paths);
+    void clear();
+
+private slots:
+    void file_changed(const QString& path);
+
+private:
+    struct Node {
+	qint64 mtime;		    //!< last modification time in ms since epoch (-1 if missing)
+	bool scanned;		    //!< true if deps is up to date
+	QStringList deps;	    //!< resolved absolute paths of direct dependencies
+    };
+
+    QFileSystemWatcher m_watcher;		//!< watches all known files
+    QStringList m_include_paths;		//!< flexspin include paths
+    QHash<QString,Node> m_nodes;		//!< known files
+    QHash<QString,QSet<QString>> m_users;	//!< reverse edges: file to files depending on it
+
+    Node& node(const QString& filename);
+    void scan(const QString& filename, Node& n);
+    QString resolve(const QString& from, const QString& name, bool object) const;
+    static void references(const QByteArray& source, QStringList* includes, QStringList* objects);
+};
@@ -0,0 +1,291 @@
+/***************************************************************************************
+ *
+ * Qt5 Propeller 2 fleet upload dialog
+ *
+ * Copyright 🄯 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ ***************************************************************************************/
+#include <QFileInfo>
+#include <algorithm>
+#include <QLocale>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSerialPortInfo>
+#include "fleetdlg.h"
+#include "ui_fleetdlg.h"
+#include "fleetupload.h"
+#include "propload.h"
+#include "proptypes.h"
+
+static bool port_info_less(const QSerialPortInfo& a, const QSerialPortInfo& b)
+{
+    return a.portName() < b.portName();
+}
+
+FleetDlg::FleetDlg(QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::FleetDlg),
+    m_binary(),
+    m_baud_rate(Serial_Baud230400),
+    m_data_bits(QSerialPort::Data8),
+    m_parity(QSerialPort::NoParity),
+    m_stop_bits(QSerialPort::OneStop),
+    m_exclude(),
+    m_uploads(),
+    m_running(0),
+    m_passed(0),
+    m_failed(0),
+    m_timer()
+{
+    ui->setupUi(this);
+    ui->tw_ports->setColumnCount(col_count);
+    ui->tw_ports->setHorizontalHeaderLabels({tr("Port"), tr("Description"), tr("Progress"),
+					     tr("Status"), tr("Attempts"), tr("Time")});
+
+    bool ok = connect(ui->pb_refresh, &QPushButton::clicked,
+		      this, &FleetDlg::fill_ports);
+    Q_ASSERT(ok);
+    ok = connect(ui->pb_start, &QPushButton::clicked,
+		 this, &FleetDlg::start);
+    Q_ASSERT(ok);
+    fill_ports();
+}
+
+FleetDlg::~FleetDlg()
+{
+    foreach(FleetUpload* upload, m_uploads.keys())
+	upload->wait();
+    delete ui;
+}
+
+/**
+ * @brief Set the binary to upload
+ * @param binary const reference to the binary
+ * @param filename name of the source, for display only
+ */
+void FleetDlg::set_binary(const QByteArray& binary, const QString& filename)
+{
+    m_binary = binary;
+    ui->lbl_binary->setText(tr("%1 (%2 bytes)")
+			    .arg(QFileInfo(filename).fileName())
+			    .arg(QLocale::system().toString(binary.size())));
+}
+
+/**
+ * @brief Set the parameters used for all ports
+ * @param baud_rate baud rate
+ * @param data_bits data bits
+ * @param parity parity
+ * @param stop_bits stop bits
+ */
+void FleetDlg::set_port(qint32 baud_rate, QSerialPort::DataBits data_bits,
+			QSerialPort::Parity parity, QSerialPort::StopBits stop_bits)
+{
+    m_baud_rate = baud_rate;
+    m_data_bits = data_bits;
+    m_parity = parity;
+    m_stop_bits = stop_bits;
+}
+
+/**
+ * @brief Set the name of a port which must not be used
+ * @param port_name name of the port which is open in the terminal
+ */
+void FleetDlg::set_exclude(const QString& port_name)
+{
+    m_exclude = port_name;
+    fill_ports();
+}
+
+/**
+ * @brief Close the dialog unless uploads are still running
+ */
+void FleetDlg::reject()
+{
+    if (m_running > 0) {
+	ui->lbl_summary->setText(tr("Waiting for %1 upload(s) to finish.").arg(m_running));
+	return;
+    }
+    QDialog::reject();
+}
+
+/**
+ * @brief Fill the table with the available serial ports
+ */
+void FleetDlg::fill_ports()
+{
+    QList<QSerialPortInfo> ports = QSerialPortInfo::availablePorts();
+    std::sort(ports.begin(), ports.end(), port_info_less);
+
+    ui->tw_ports->setRowCount(0);
+    foreach(const QSerialPortInfo& info, ports) {
+	if (info.portName() == m_exclude || info.systemLocation() == m_exclude)
+	    continue;
+	const int row = ui->tw_ports->rowCount();
+	ui->tw_ports->insertRow(row);
+
+	QTableWidgetItem* it = new QTableWidgetItem(info.portName());
+	it->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+	it->setCheckState(Qt::Checked);
+	ui->tw_ports->setItem(row, col_port, it);
+
+	it = new QTableWidgetItem(info.description());
+	it->setFlags(Qt::ItemIsEnabled);
+	ui->tw_ports->setItem(row, col_description, it);
+
+	QProgressBar* pb = new QProgressBar;
+	pb->setRange(0, progress_max);
+	pb->setValue(0);
+	ui->tw_ports->setCellWidget(row, col_progress, pb);
+
+	for (int col = col_status; col < col_count; col++) {
+	    it = new QTableWidgetItem();
+	    it->setFlags(Qt::ItemIsEnabled);
+	    ui->tw_ports->setItem(row, col, it);
+	}
+    }
+    ui->tw_ports->resizeColumnsToContents();
+    ui->pb_start->setEnabled(ui->tw_ports->rowCount() > 0 && !m_binary.isEmpty());
+}
+
+/**
+ * @brief Start the uploads to all checked ports
+ * The binary is encoded once; all uploads share the encoded lines.
+ */
+void FleetDlg::start()
+{
+    if (m_binary.isEmpty() || m_running > 0)
+	return;
+
+    PropLoad encoder(nullptr);
+    const QList<QByteArray> stream = encoder.encode(m_binary);
+
+    foreach(FleetUpload* upload, m_uploads.keys())
+	upload->deleteLater();
+    m_uploads.clear();
+    m_passed = 0;
+    m_failed = 0;
+    m_timer.start();
+
+    for (int row = 0; row < ui->tw_ports->rowCount(); row++) {
+	QTableWidgetItem* it = ui->tw_ports->item(row, col_port);
+	if (Qt::Checked != it->checkState())
+	    continue;
+	FleetUpload* upload = new FleetUpload(it->text(), this);
+	upload->set_image(stream, m_binary.size());
+	upload->set_port(m_baud_rate, m_data_bits, m_parity, m_stop_bits);
+	upload->set_retries(ui->sb_retries->value());
+	bool ok = connect(upload, &FleetUpload::progress,
+			  this, &FleetDlg::upload_progress);
+	Q_ASSERT(ok);
+	ok = connect(upload, &FleetUpload::message,
+		     this, &FleetDlg::upload_message);
+	Q_ASSERT(ok);
+	ok = connect(upload, &FleetUpload::finished,
+		     this, &FleetDlg::upload_finished);
+	Q_ASSERT(ok);
+	m_uploads.insert(upload, row);
+	ui->tw_ports->item(row, col_status)->setText(tr("Uploading"));
+	qobject_cast<QProgressBar*>(ui->tw_ports->cellWidget(row, col_progress))->setValue(0);
+    }
+    if (m_uploads.isEmpty())
+	return;
+
+    m_running = m_uploads.count();
+    ui->pb_start->setEnabled(false);
+    ui->pb_refresh->setEnabled(false);
+    foreach(FleetUpload* upload, m_uploads.keys())
+	upload->start();
+    update_summary();
+}
+
+/**
+ * @brief Update the progress bar of an upload
+ * @param value number of bytes sent
+ * @param total number of bytes to send
+ */
+void FleetDlg::upload_progress(qint64 value, qint64 total)
+{
+    FleetUpload* upload = qobject_cast<FleetUpload*>(sender());
+    const int row = m_uploads.value(upload, -1);
+    if (row < 0)
+	return;
+    QProgressBar* pb = qobject_cast<QProgressBar*>(ui->tw_ports->cellWidget(row, col_progress));
+    if (pb && total > 0)
+	pb->setValue(static_cast<int>(value * progress_max / total));
+    update_row(upload, row);
+}
+
+/**
+ * @brief Show the most recent message of an upload
+ * @param text message
+ */
+void FleetDlg::upload_message(const QString& text)
+{
+    FleetUpload* upload = qobject_cast<FleetUpload*>(sender());
+    const int row = m_uploads.value(upload, -1);
+    if (row < 0)
+	return;
+    QTableWidgetItem* it = ui->tw_ports->item(row, col_status);
+    it->setText(text.section(QChar::LineFeed, 0, 0));
+    it->setToolTip(text);
+}
+
+/**
+ * @brief Show the result of a finished upload
+ */
+void FleetDlg::upload_finished()
+{
+    FleetUpload* upload = qobject_cast<FleetUpload*>(sender());
+    const int row = m_uploads.value(upload, -1);
+    if (row < 0)
+	return;
+    if (upload->passed())
+	m_passed++;
+    else
+	m_failed++;
+    QTableWidgetItem* it = ui->tw_ports->item(row, col_status);
+    it->setText(upload->passed() ? tr("Passed") : tr("Failed"));
+    it->setForeground(upload->passed() ? Qt::darkGreen : Qt::red);
+    if (!upload->passed())
+	it->setToolTip(upload->error_string());
+    ui->tw_ports->item(row, col_time)->setText(tr("%1 s").arg(upload->elapsed() / 1000.0, 0, 'f', 1));
+    update_row(upload, row);
+
+    if (--m_running == 0) {
+	ui->pb_start->setEnabled(true);
+	ui->pb_refresh->setEnabled(true);
+    }
+    update_summary();
+}
+
+/**
+ * @brief Update the number of attempts of an upload
+ * @param upload pointer to the FleetUpload
+ * @param row table row
+ */
+void FleetDlg::update_row(FleetUpload* upload, int row)
+{
+    ui->tw_ports->item(row, col_attempts)->setText(QString::number(upload->attempts()));
+}
+
+/**
+ * @brief Update the pass/fail summary
+ */
+void FleetDlg::update_summary()
+{
+    const double seconds = m_timer.elapsed() / 1000.0;
+    if (m_running > 0) {
+	ui->lbl_summary->setText(tr("Uploading to %1 port(s): %2 passed, %3 failed.")
+				 .arg(m_uploads.count())
+				 .arg(m_passed)
+				 .arg(m_failed));
+    } else {
+	ui->lbl_summary->setText(tr("%1 passed, %2 failed in %3 s.")
+				 .arg(m_passed)
+				 .arg(m_failed)
+				 .arg(seconds, 0, 'f', 1));
+    }
+}
@@ -0,0 +1,77 @@
+/***************************************************************************************
+ *
+ * Qt5 Propeller 2 fleet upload dialog
+ *
+ * Copyright 🄯 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ ***************************************************************************************/
+#pragma once
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSerialPort>
+
+namespace Ui {
+class FleetDlg;
+}
+
+class FleetUpload;
+
+/**
+ * @brief The FleetDlg class uploads one binary to the boards on many serial ports at once.
+ */
+class FleetDlg : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit FleetDlg(QWidget *parent = nullptr);
+    ~FleetDlg();
+
+    void set_binary(const QByteArray& binary, const QString& filename);
+    void set_port(qint32 baud_rate,
+		  QSerialPort::DataBits data_bits,
+		  QSerialPort::Parity parity,
+		  QSerialPort::StopBits stop_bits);
+    void set_exclude(const QString& port_name);
+
+public slots:
+    void reject() override;
+
+private slots:
+    void fill_ports();
+    void start();
+    void upload_progress(qint64 value, qint64 total);
+    void upload_message(const QString& text);
+    void upload_finished();
+
+private:
+    enum Column {
+	col_port,
+	col_description,
+	col_progress,
+	col_status,
+	col_attempts,
+	col_time,
+	col_count
+    };
+    static constexpr int progress_max = 1000;
+
+    Ui::FleetDlg *ui;
+    QByteArray m_binary;			//!< binary to upload
+    qint32 m_baud_rate;				//!< baud rate of the ports
+    QSerialPort::DataBits m_data_bits;		//!< data bits of the ports
+    QSerialPort::Parity m_parity;		//!< parity of the ports
+    QSerialPort::StopBits m_stop_bits;		//!< stop bits of the ports
+    QString m_exclude;				//!< port which is in use by the terminal
+    QHash<FleetUpload*,int> m_uploads;		//!< running uploads and their rows
+    int m_running;				//!< number of uploads still running
+    int m_passed;				//!< number of uploads which passed
+    int m_failed;				//!< number of uploads which failed
+    QElapsedTimer m_timer;			//!< time since the start
+
+    void update_row(FleetUpload* upload, int row);
+    void update_summary();
+};
@@ -0,0 +1,198 @@
+/***************************************************************************************
+ *
+ * Qt5 Propeller 2 capture replay dialog
+ *
+ * Copyright 🄯 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ ***************************************************************************************/
+#include <QDateTime>
+#include <QFileInfo>
+#include <QLocale>
+#include <QSignalBlocker>
+#include "replaydlg.h"
+#include "ui_replaydlg.h"
+#include "replay.h"
+#include "vt220.h"
+
+ReplayDlg::ReplayDlg(const vt220* live, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::ReplayDlg),
+    m_term(new vt220(this)),
+    m_replay(new Replay(m_term, this))
+{
+    ui->setupUi(this);
+    m_term->set_font_family(live->font_family());
+    m_term->set_zoom(live->zoom());
+    m_term->set_backlog_max(live->backlog_max());
+    const QSize size = live->term_geometry();
+    m_term->term_set_size(size.width(), size.height());
+    ui->verticalLayout->insertWidget(0, m_term, 1);
+    adjustSize();
+    ui->sl_position->setMaximum(slider_max);
+    ui->cb_speed->addItem(tr("1×"), 1.0);
+    ui->cb_speed->addItem(tr("2×"), 2.0);
+    ui->cb_speed->addItem(tr("5×"), 5.0);
+    ui->cb_speed->addItem(tr("10×"), 10.0);
+    ui->cb_speed->addItem(tr("100×"), 100.0);
+    ui->cb_speed->addItem(tr("Max"), 0.0);
+
+    connect(ui->pb_play, &QPushButton::toggled,
+	    this, &ReplayDlg::play_toggled);
+    connect(ui->cb_speed, QOverload<int>::of(&QComboBox::currentIndexChanged),
+	    this, &ReplayDlg::speed_changed);
+    connect(ui->sl_position, &QSlider::sliderMoved,
+	    this, &ReplayDlg::slider_moved);
+    connect(ui->sl_position, &QSlider::sliderReleased,
+	    this, &ReplayDlg::slider_released);
+    connect(ui->sl_position, &QSlider::valueChanged,
+	    this, &ReplayDlg::slider_changed);
+    connect(m_replay, &Replay::position_changed,
+	    this, &ReplayDlg::position_changed);
+    connect(m_replay, &Replay::finished,
+	    this, &ReplayDlg::replay_finished);
+}
+
+ReplayDlg::~ReplayDlg()
+{
+    delete ui;
+}
+
+/**
+ * @brief Open a capture for replay
+ * @param filename name of one of the capture's files
+ * @return true on success
+ */
+bool ReplayDlg::open(const QString& filename)
+{
+    if (!m_replay->open(filename))
+	return false;
+    const CaptureFile& capture = m_replay->capture();
+    QLocale locale = QLocale::system();
+    ui->lbl_file->setText(tr("%1 (%2, started %3)")
+			  .arg(QFileInfo(capture.basename()).fileName())
+			  .arg(locale.formattedDataSize(capture.size()))
+			  .arg(locale.toString(QDateTime::fromMSecsSinceEpoch(capture.start_ms()),
+					       QLocale::ShortFormat)));
+    position_changed(m_replay->position(), m_replay->offset());
+    return true;
+}
+
+/**
+ * @brief Return the most recent error message of the replay
+ * @return error message
+ */
+QString ReplayDlg::error_string() const
+{
+    return m_replay->error_string();
+}
+
+void ReplayDlg::play_toggled(bool on)
+{
+    if (on) {
+	m_replay->play();
+	ui->pb_play->setText(tr("&Pause"));
+    } else {
+	m_replay->pause();
+	ui->pb_play->setText(tr("&Play"));
+    }
+}
+
+void ReplayDlg::speed_changed(int index)
+{
+    m_replay->set_speed(ui->cb_speed->itemData(index).toDouble());
+}
+
+/**
+ * @brief Show the time at the slider while it is dragged
+ * @param value slider position
+ */
+void ReplayDlg::slider_moved(int value)
+{
+    show_time(slider_ns(value));
+}
+
+/**
+ * @brief Seek to the slider position when dragging ends
+ */
+void ReplayDlg::slider_released()
+{
+    m_replay->seek(slider_ns(ui->sl_position->value()));
+}
+
+/**
+ * @brief Seek when the slider is moved by a click on its groove or with the keyboard
+ * @param value slider position
+ */
+void ReplayDlg::slider_changed(int value)
+{
+    if (ui->sl_position->isSliderDown())
+	return;
+    m_replay->seek(slider_ns(value));
+}
+
+/**
+ * @brief Return the capture time of a slider position
+ * @param value slider position
+ * @return time in ns
+ */
+qint64 ReplayDlg::slider_ns(int value) const
+{
+    // in double, because duration * value overflows for captures of days
+    return static_cast<qint64>(static_cast<double>(m_replay->duration()) * value / slider_max);
+}
+
+/**
+ * @brief Update the slider and the labels with the replay position
+ * @param ns capture time in ns
+ * @param offset stream offset
+ */
+void ReplayDlg::position_changed(qint64 ns, qint64 offset)
+{
+    QLocale locale = QLocale::system();
+    const qint64 duration = m_replay->duration();
+    if (!ui->sl_position->isSliderDown() && duration > 0) {
+	const QSignalBlocker block(ui->sl_position);
+	ui->sl_position->setValue(static_cast<int>(static_cast<double>(ns) * slider_max / duration));
+    }
+    show_time(ns);
+    ui->lbl_stats->setText(tr("Offset %1, parsed %2 at %3/s, %4 snapshots")
+			   .arg(locale.toString(offset))
+			   .arg(locale.formattedDataSize(m_replay->parsed_bytes()))
+			   .arg(locale.formattedDataSize(m_replay->bytes_per_second()))
+			   .arg(m_replay->snapshots()));
+}
+
+void ReplayDlg::replay_finished()
+{
+    ui->pb_play->setChecked(false);
+}
+
+/**
+ * @brief Show a capture time, the duration, and the wall clock time
+ * @param ns capture time in ns
+ */
+void ReplayDlg::show_time(qint64 ns)
+{
+    const QDateTime when = QDateTime::fromMSecsSinceEpoch(m_replay->capture().start_ms() + ns / 1000000);
+    ui->lbl_time->setText(tr("%1 / %2 (%3)")
+			  .arg(time_str(ns))
+			  .arg(time_str(m_replay->duration()))
+			  .arg(when.toString(QLatin1String("yyyy-MM-dd hh:mm:ss.zzz"))));
+}
+
+/**
+ * @brief Format a time as hours, minutes, seconds, and milliseconds
+ * @param ns time in ns
+ * @return QString with the time
+ */
+QString ReplayDlg::time_str(qint64 ns)
+{
+    const qint64 ms = ns / 1000000;
+    return QString("%1:%2:%3.%4")
+	    .arg(ms / 3600000)
+	    .arg((ms / 60000) % 60, 2, 10, QChar('0'))
+	    .arg((ms / 1000) % 60, 2, 10, QChar('0'))
+	    .arg(ms % 1000, 3, 10, QChar('0'));
+}
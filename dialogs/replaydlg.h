@@ -0,0 +1,60 @@
+/***************************************************************************************
+ *
+ * Qt5 Propeller 2 capture replay dialog
+ *
+ * Copyright 🄯 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ ***************************************************************************************/
+#pragma once
+#include <QDialog>
+
+namespace Ui {
+class ReplayDlg;
+}
+
+class Replay;
+class vt220;
+
+/**
+ * @brief The ReplayDlg class controls a @ref Replay of a capture in a terminal.
+ *
+ * The capture is replayed in a terminal of the dialog's own, which takes
+ * the font, zoom, size, and backlog of the live terminal, so the live
+ * terminal keeps displaying the serial port while the dialog is open.
+ *
+ * Seeking parses the capture from the nearest snapshot in the GUI thread,
+ * because the terminal is a widget. While the slider is dragged only the
+ * time is shown, and the replay seeks when the slider is released.
+ */
+class ReplayDlg : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ReplayDlg(const vt220* live, QWidget *parent = nullptr);
+    ~ReplayDlg();
+
+    bool open(const QString& filename);
+    QString error_string() const;
+
+private slots:
+    void play_toggled(bool on);
+    void speed_changed(int index);
+    void slider_moved(int value);
+    void slider_released();
+    void slider_changed(int value);
+    void position_changed(qint64 ns, qint64 offset);
+    void replay_finished();
+
+private:
+    static constexpr int slider_max = 10000;
+    Ui::ReplayDlg *ui;
+    vt220* m_term;
+    Replay* m_replay;
+
+    qint64 slider_ns(int value) const;
+    void show_time(qint64 ns);
+    static QString time_str(qint64 ns);
+};
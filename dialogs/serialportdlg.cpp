@@ -19,7 +19,7 @@ static const char blankString[] = QT_TRANSLATE_NOOP("SerialPortDialog", "N/A");
 SerialPortDlg::SerialPortDlg(QWidget *parent)
     : QDialog(parent)
     , ui(new Ui::SerialPortDialog)
-    , m_int_validator(new QIntValidator(0, 4000000, this))
+    , m_int_validator(new QIntValidator(0, Serial_BaudMax, this))
     , m_settings()
 {
     ui->setupUi(this);
@@ -71,6 +71,8 @@ void SerialPortDlg::set_settings(const SerialPortDlg::Settings& s)
     m_settings.parity = s.parity;
     m_settings.flow_control = s.flow_control;
     m_settings.local_echo = s.local_echo;
+    m_settings.read_buffer_kib = s.read_buffer_kib;
+    m_settings.overflow_policy = s.overflow_policy;
     setup_dialog();
 }
 
@@ -160,6 +162,8 @@ void SerialPortDlg::fill_ports_parameters()
     ui->cb_baud_rate->addItem(locale.toString(Serial_Baud230400), Serial_Baud230400);
     ui->cb_baud_rate->addItem(locale.toString(Serial_Baud921600), Serial_Baud921600);
     ui->cb_baud_rate->addItem(locale.toString(Serial_Baud2000000), Serial_Baud2000000);
+    ui->cb_baud_rate->addItem(locale.toString(Serial_Baud3000000), Serial_Baud3000000);
+    ui->cb_baud_rate->addItem(locale.toString(Serial_Baud4000000), Serial_Baud4000000);
     ui->cb_baud_rate->addItem(tr("Custom"));
 
     foreach(const QSerialPort::DataBits key, data_bits_str.keys()) {
@@ -181,6 +185,10 @@ void SerialPortDlg::fill_ports_parameters()
 	if (QSerialPort::UnknownFlowControl != key)
 	    ui->cb_flow_control->addItem(tr(flow_control_str.value(key)), key);
     }
+
+    foreach(const Overflow_Policy key, overflow_policy_str.keys()) {
+	ui->cb_overflow_policy->addItem(tr(overflow_policy_str.value(key)), key);
+    }
 }
 
 void SerialPortDlg::fill_ports_info()
@@ -226,12 +234,14 @@ void SerialPortDlg::setup_dialog(bool load_settings)
 
 	s.beginGroup(id_grp_serialport);
 	s.beginGroup(settings.name);
-	settings.baud_rate = static_cast<Serial_BaudRate>(s.value(id_baud_rate, Serial_Baud230400).toInt());
+	settings.baud_rate = s.value(id_baud_rate, Serial_Baud230400).toInt();
 	settings.data_bits = static_cast<QSerialPort::DataBits>(s.value(id_data_bits, QSerialPort::Data8).toInt());
 	settings.parity = static_cast<QSerialPort::Parity>(s.value(id_parity, QSerialPort::NoParity).toInt());
 	settings.stop_bits = static_cast<QSerialPort::StopBits>(s.value(id_stop_bits, QSerialPort::OneStop).toInt());
 	settings.flow_control = static_cast<QSerialPort::FlowControl>(s.value(id_flow_control, QSerialPort::NoFlowControl).toInt());
 	settings.local_echo = s.value(id_local_echo, false).toBool();
+	settings.read_buffer_kib = s.value(id_read_buffer_size, 0).toInt();
+	settings.overflow_policy = static_cast<Overflow_Policy>(s.value(id_overflow_policy, Overflow_Throttle).toInt());
 	s.endGroup();
 	s.endGroup();
     } else {
@@ -267,6 +277,12 @@ void SerialPortDlg::setup_dialog(bool load_settings)
     }
 
     ui->cb_local_echo->setChecked(settings.local_echo);
+    ui->sb_read_buffer->setValue(settings.read_buffer_kib);
+
+    idx = ui->cb_overflow_policy->findData(settings.overflow_policy);
+    if (idx >= 0) {
+	ui->cb_overflow_policy->setCurrentIndex(idx);
+    }
 
     // Create human readable strings from the settings
     settings.str.baud_rate = locale.toString(settings.baud_rate);
@@ -298,6 +314,8 @@ void SerialPortDlg::save_settings()
     s.setValue(id_stop_bits, m_settings.stop_bits);
     s.setValue(id_flow_control, m_settings.flow_control);
     s.setValue(id_local_echo, m_settings.local_echo);
+    s.setValue(id_read_buffer_size, m_settings.read_buffer_kib);
+    s.setValue(id_overflow_policy, m_settings.overflow_policy);
     s.endGroup();
     s.endGroup();
 }
@@ -308,9 +326,9 @@ void SerialPortDlg::read_settings()
 
     int idx = ui->cb_baud_rate->currentIndex();
     if (ui->cb_baud_rate->itemData(ui->cb_baud_rate->currentIndex()).isNull()) {
-	m_settings.baud_rate = static_cast<Serial_BaudRate>(ui->cb_baud_rate->currentText().toInt());
+	m_settings.baud_rate = ui->cb_baud_rate->currentText().toInt();
     } else {
-	m_settings.baud_rate = static_cast<Serial_BaudRate>(ui->cb_baud_rate->itemData(idx).toInt());
+	m_settings.baud_rate = ui->cb_baud_rate->itemData(idx).toInt();
     }
     m_settings.str.baud_rate = QString::number(m_settings.baud_rate);
 
@@ -331,4 +349,8 @@ void SerialPortDlg::read_settings()
     m_settings.str.flow_control = flow_control_str.value(m_settings.flow_control);
 
     m_settings.local_echo = ui->cb_local_echo->isChecked();
+    m_settings.read_buffer_kib = ui->sb_read_buffer->value();
+
+    idx = ui->cb_overflow_policy->currentIndex();
+    m_settings.overflow_policy = static_cast<Overflow_Policy>(ui->cb_overflow_policy->itemData(idx).toInt());
 }
@@ -24,12 +24,14 @@ class SerialPortDlg : public QDialog
 public:
     struct Settings {
 	QString name;
-	Serial_BaudRate baud_rate;
+	qint32 baud_rate;
 	QSerialPort::DataBits data_bits;
 	QSerialPort::Parity parity;
 	QSerialPort::StopBits stop_bits;
 	QSerialPort::FlowControl flow_control;
 	bool local_echo;
+	int read_buffer_kib;
+	Overflow_Policy overflow_policy;
 	struct {
 	    QString baud_rate;
 	    QString data_bits;
@@ -9,6 +9,7 @@
  ***************************************************************************************/
 #include "textbrowserdlg.h"
 #include "ui_textbrowserdlg.h"
+#include "mappedview.h"
 
 TextBrowserDlg::TextBrowserDlg(QWidget *parent) :
     QDialog(parent),
@@ -24,5 +25,33 @@ TextBrowserDlg::~TextBrowserDlg()
 
 void TextBrowserDlg::set_text(const QString& text)
 {
-    ui->textBrowser->setPlainText(text);
+    ui->view->set_text(text);
+}
+
+/**
+ * @brief Display a text file without loading it into memory
+ * @param filename name of the file
+ * @return true on success, or false if the file can't be opened
+ */
+bool TextBrowserDlg::set_file(const QString& filename)
+{
+    return ui->view->set_file(filename, MappedView::TEXT);
+}
+
+/**
+ * @brief Display a hex dump of binary data
+ * @param data const reference to the QByteArray
+ */
+void TextBrowserDlg::set_binary(const QByteArray& data)
+{
+    ui->view->set_data(data, MappedView::HEXDUMP);
+}
+
+/**
+ * @brief Highlight a row and scroll it into view
+ * @param row row number (0 based), or -1 for none
+ */
+void TextBrowserDlg::set_current_row(int row)
+{
+    ui->view->set_current_row(row);
 }
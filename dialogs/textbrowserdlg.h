@@ -23,6 +23,9 @@ public:
     ~TextBrowserDlg();
 
     void set_text(const QString& text);
+    bool set_file(const QString& filename);
+    void set_binary(const QByteArray& data);
+    void set_current_row(int row);
 private:
     Ui::TextBrowserDlg *ui;
 };
@@ -0,0 +1,199 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 parallel upload to a fleet of boards
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QElapsedTimer>
+#include "fleetupload.h"
+#include "propload.h"
+#include "proptypes.h"
+#include "serialtune.h"
+
+#define	DEBUG_FLEET	0
+
+#if defined(DEBUG_FLEET) && (DEBUG_FLEET != 0)
+#define	DBG_FLEET(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_FLEET(X,...) /* X */
+#endif
+
+FleetUpload::FleetUpload(const QString& port_name, QObject* parent)
+    : QThread(parent)
+    , m_port_name(port_name)
+    , m_stream()
+    , m_size(0)
+    , m_baud_rate(Serial_Baud230400)
+    , m_data_bits(QSerialPort::Data8)
+    , m_parity(QSerialPort::NoParity)
+    , m_stop_bits(QSerialPort::OneStop)
+    , m_retries(2)
+    , m_passed(false)
+    , m_attempts(0)
+    , m_elapsed(0)
+    , m_error()
+{
+}
+
+/**
+ * @brief Set the image to upload
+ * @param stream const reference to the lines returned by PropLoad::encode()
+ * @param size size of the image in bytes
+ */
+void FleetUpload::set_image(const QList<QByteArray>& stream, qint64 size)
+{
+    m_stream = stream;
+    m_size = size;
+}
+
+/**
+ * @brief Set the serial port parameters
+ * @param baud_rate baud rate
+ * @param data_bits data bits
+ * @param parity parity
+ * @param stop_bits stop bits
+ */
+void FleetUpload::set_port(qint32 baud_rate, QSerialPort::DataBits data_bits,
+			   QSerialPort::Parity parity, QSerialPort::StopBits stop_bits)
+{
+    m_baud_rate = baud_rate;
+    m_data_bits = data_bits;
+    m_parity = parity;
+    m_stop_bits = stop_bits;
+}
+
+/**
+ * @brief Set the number of retries after a failed upload
+ * @param retries number of retries
+ */
+void FleetUpload::set_retries(int retries)
+{
+    m_retries = qMax(0, retries);
+}
+
+/**
+ * @brief Return the name of the serial port
+ * @return port name
+ */
+QString FleetUpload::port_name() const
+{
+    return m_port_name;
+}
+
+/**
+ * @brief Return true if the upload succeeded
+ * @return true if passed
+ */
+bool FleetUpload::passed() const
+{
+    return m_passed;
+}
+
+/**
+ * @brief Return the number of attempts made so far
+ * @return number of attempts
+ */
+int FleetUpload::attempts() const
+{
+    return m_attempts.loadAcquire();
+}
+
+/**
+ * @brief Return the time the upload took
+ * @return time in ms
+ */
+qint64 FleetUpload::elapsed() const
+{
+    return m_elapsed;
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString FleetUpload::error_string() const
+{
+    return m_error;
+}
+
+/**
+ * @brief Remember an error of PropLoad and pass it on
+ * @param text error message
+ */
+void FleetUpload::load_error(const QString& text)
+{
+    m_error = text;
+    emit message(text);
+}
+
+/**
+ * @brief Open the port and upload the image until it succeeds or the retries are used up
+ */
+void FleetUpload::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+    m_passed = false;
+    m_attempts = 0;
+    m_error.clear();
+
+    QSerialPort stty(m_port_name);
+    stty.setBaudRate(m_baud_rate);
+    stty.setDataBits(m_data_bits);
+    stty.setParity(m_parity);
+    stty.setStopBits(m_stop_bits);
+    stty.setFlowControl(QSerialPort::NoFlowControl);
+    if (!stty.open(QIODevice::ReadWrite)) {
+	m_error = tr("Could not open %1: %2")
+		  .arg(m_port_name)
+		  .arg(stty.errorString());
+	emit message(m_error);
+	m_elapsed = timer.elapsed();
+	return;
+    }
+#if defined(Q_OS_LINUX)
+    const int fd = static_cast<int>(stty.handle());
+    SerialTune::set_baud_rate(fd, m_baud_rate);
+    SerialTune::set_low_latency(fd);
+#endif
+
+    while (!m_passed && m_attempts.loadAcquire() <= m_retries) {
+	m_attempts.ref();
+	if (m_attempts.loadAcquire() > 1)
+	    emit message(tr("Retrying (attempt %1).").arg(m_attempts.loadAcquire()));
+	m_passed = upload(&stty);
+    }
+    stty.close();
+    m_elapsed = timer.elapsed();
+    DBG_FLEET("%s: %s %s after %d attempts in %lldms", __func__, qPrintable(m_port_name),
+	      m_passed ? "passed" : "failed", m_attempts.loadAcquire(), m_elapsed);
+}
+
+/**
+ * @brief Reset the board and send the image once
+ * @param stty pointer to the open QSerialPort
+ * @return true on success
+ */
+bool FleetUpload::upload(QSerialPort* stty)
+{
+    // reset the Propeller like SerTerm::reset_prop() does
+    stty->setDataTerminalReady(false);
+    msleep(reset_ms);
+    stty->setDataTerminalReady(true);
+    msleep(boot_ms);
+    stty->clear(QSerialPort::Input);
+
+    PropLoad propload(stty);
+    bool ok = connect(&propload, &PropLoad::Progress,
+		      this, &FleetUpload::progress,
+		      Qt::DirectConnection);
+    Q_ASSERT(ok);
+    ok = connect(&propload, &PropLoad::Error,
+		 this, &FleetUpload::load_error,
+		 Qt::DirectConnection);
+    Q_ASSERT(ok);
+    return propload.load_encoded(m_stream, m_size);
+}
@@ -0,0 +1,77 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 parallel upload to a fleet of boards
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QThread>
+#include <QList>
+#include <QByteArray>
+#include <QSerialPort>
+#include <QAtomicInteger>
+
+/**
+ * @brief The FleetUpload class uploads an encoded image to the board on one port.
+ *
+ * One FleetUpload is started for every port of the fleet. Each opens its
+ * own QSerialPort in its thread, resets the board by toggling DTR, and
+ * sends the image which was encoded once by PropLoad::encode(). The
+ * lines of the image are implicitly shared between all threads, so the
+ * fleet costs no extra memory and the uploads run in parallel.
+ *
+ * A failed upload is retried after another reset. The result is read
+ * with @ref passed, @ref attempts, and @ref elapsed after the thread
+ * has finished.
+ */
+class FleetUpload : public QThread
+{
+    Q_OBJECT
+public:
+    static constexpr int reset_ms = 10;		//!< duration of the DTR reset pulse
+    static constexpr int boot_ms = 20;		//!< time for the ROM to start after a reset
+
+    explicit FleetUpload(const QString& port_name, QObject* parent = nullptr);
+
+    void set_image(const QList<QByteArray>& stream, qint64 size);
+    void set_port(qint32 baud_rate,
+		  QSerialPort::DataBits data_bits = QSerialPort::Data8,
+		  QSerialPort::Parity parity = QSerialPort::NoParity,
+		  QSerialPort::StopBits stop_bits = QSerialPort::OneStop);
+    void set_retries(int retries);
+
+    QString port_name() const;
+    bool passed() const;
+    int attempts() const;
+    qint64 elapsed() const;
+    QString error_string() const;
+
+signals:
+    void progress(qint64 value, qint64 total);
+    void message(const QString& text);
+
+protected:
+    void run() override;
+
+private slots:
+    void load_error(const QString& text);
+
+private:
+    QString m_port_name;		    //!< name of the serial port
+    QList<QByteArray> m_stream;		    //!< encoded image
+    qint64 m_size;			    //!< size of the image
+    qint32 m_baud_rate;			    //!< baud rate
+    QSerialPort::DataBits m_data_bits;	    //!< data bits
+    QSerialPort::Parity m_parity;	    //!< parity
+    QSerialPort::StopBits m_stop_bits;	    //!< stop bits
+    int m_retries;			    //!< number of retries after a failure
+    bool m_passed;			    //!< the upload succeeded
+    QAtomicInt m_attempts;		    //!< number of attempts made
+    qint64 m_elapsed;			    //!< time taken in ms
+    QString m_error;			    //!< most recent error message
+
+    bool upload(QSerialPort* stty);
+};
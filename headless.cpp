@@ -0,0 +1,363 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 command line loader and terminal
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QThread>
+#include <cstdio>
+#include <cstring>
+#if defined(Q_OS_UNIX)
+#include <csignal>
+#include <cstdlib>
+#include <termios.h>
+#include <unistd.h>
+#endif
+#include "headless.h"
+#include "idstrings.h"
+#include "propload.h"
+#include "proptypes.h"
+#include "serialtune.h"
+
+#if defined(Q_OS_UNIX)
+static struct termios saved_tio;	    //!< settings of the terminal on stdin
+static volatile sig_atomic_t tio_saved = 0; //!< saved_tio must be restored
+
+/**
+ * @brief Restore the settings of the terminal on stdin, if they were changed
+ * This is async-signal-safe.
+ */
+static void restore_tty()
+{
+    if (!tio_saved)
+	return;
+    tio_saved = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_tio);
+}
+
+/**
+ * @brief Restore the terminal and die from the signal as if it was not caught
+ * @param sig signal number
+ */
+static void restore_tty_signal(int sig)
+{
+    restore_tty();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+#endif
+
+Headless::Headless(QObject* parent)
+    : QObject(parent)
+    , m_clock()
+    , m_stty(nullptr)
+    , m_stdin(nullptr)
+    , m_verbose(false)
+    , m_percent(-1)
+    , m_raw(false)
+{
+    m_clock.start();
+}
+
+/**
+ * @brief Check the command line for options which select the headless mode
+ * This is done before any application object is created.
+ * @param argc number of arguments
+ * @param argv array of arguments
+ * @return true if --load (-l) or --term (-t) is given
+ */
+bool Headless::wanted(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++) {
+	const QByteArray arg(argv[i]);
+	if (arg == "--load" || arg.startsWith("--load=") || arg == "--term" ||
+	    arg == "-l" || arg == "-t")
+	    return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Parse the arguments, upload, and run the terminal
+ * @param arguments const reference to the application's arguments
+ * @return exit code
+ */
+int Headless::exec(const QStringList& arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(tr("Upload a binary to a Propeller 2 and run a terminal."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption opt_port({QLatin1String("p"), QLatin1String("port")},
+				      tr("Serial port to use; defaults to the port of the GUI."),
+				      tr("port"));
+    const QCommandLineOption opt_baud({QLatin1String("b"), QLatin1String("baud")},
+				      tr("Baud rate; defaults to the baud rate of the GUI."),
+				      tr("baud"));
+    const QCommandLineOption opt_load({QLatin1String("l"), QLatin1String("load")},
+				      tr("Binary file to upload."),
+				      tr("file"));
+    const QCommandLineOption opt_term({QLatin1String("t"), QLatin1String("term")},
+				      tr("Connect stdin and stdout to the port after the upload."));
+    const QCommandLineOption opt_verbose({QLatin1String("V"), QLatin1String("verbose")},
+					 tr("Print messages and timings."));
+    parser.addOption(opt_port);
+    parser.addOption(opt_baud);
+    parser.addOption(opt_load);
+    parser.addOption(opt_term);
+    parser.addOption(opt_verbose);
+    if (!parser.parse(arguments)) {
+	print(parser.errorText());
+	return Exit_Usage;
+    }
+    if (parser.isSet(QLatin1String("help")))
+	parser.showHelp(Exit_Ok);
+    if (parser.isSet(QLatin1String("version")))
+	parser.showVersion();
+    m_verbose = parser.isSet(opt_verbose);
+
+    QSettings s;
+    s.beginGroup(id_grp_serialport);
+    const QString port_name = parser.isSet(opt_port) ? parser.value(opt_port)
+						     : s.value(id_port_name, QLatin1String("ttyUSB0")).toString();
+    s.beginGroup(port_name);
+    qint32 baud_rate = s.value(id_baud_rate, Serial_Baud230400).toInt();
+    s.endGroup();
+    s.endGroup();
+    if (parser.isSet(opt_baud)) {
+	bool ok;
+	baud_rate = parser.value(opt_baud).toInt(&ok);
+	if (!ok || baud_rate <= 0 || baud_rate > Serial_BaudMax) {
+	    print(tr("Invalid baud rate '%1'.").arg(parser.value(opt_baud)));
+	    return Exit_Usage;
+	}
+    }
+
+    QByteArray binary;
+    if (parser.isSet(opt_load)) {
+	QFile file(parser.value(opt_load));
+	if (!file.open(QIODevice::ReadOnly)) {
+	    print(tr("Could not open %1: %2")
+		  .arg(file.fileName())
+		  .arg(file.errorString()));
+	    return Exit_File;
+	}
+	binary = file.readAll();
+    }
+
+    m_stty = new QSerialPort(port_name, this);
+    m_stty->setBaudRate(baud_rate);
+    m_stty->setDataBits(QSerialPort::Data8);
+    m_stty->setParity(QSerialPort::NoParity);
+    m_stty->setStopBits(QSerialPort::OneStop);
+    m_stty->setFlowControl(QSerialPort::NoFlowControl);
+    if (!m_stty->open(QIODevice::ReadWrite)) {
+	print(tr("Could not open %1: %2")
+	      .arg(port_name)
+	      .arg(m_stty->errorString()));
+	return Exit_Port;
+    }
+#if defined(Q_OS_LINUX)
+    const int fd = static_cast<int>(m_stty->handle());
+    if (SerialTune::set_baud_rate(fd, baud_rate) < 0)
+	print(tr("Could not set baud rate %1.").arg(baud_rate));
+    SerialTune::set_low_latency(fd);
+#endif
+    m_stty->setDataTerminalReady(true);
+    if (m_verbose)
+	print(tr("Opened %1 at %2 baud after %3 ms.")
+	      .arg(port_name)
+	      .arg(baud_rate)
+	      .arg(m_clock.elapsed()));
+
+    if (!binary.isEmpty()) {
+	reset_prop();
+	PropLoad propload(m_stty);
+	propload.set_verbose(m_verbose);
+	propload.set_clock_freq(180000000);
+	propload.set_clock_mode(0);
+	propload.set_user_baud(static_cast<quint32>(baud_rate));
+	bool ok = connect(&propload, &PropLoad::Progress,
+			  this, &Headless::progress);
+	Q_ASSERT(ok);
+	ok = connect(&propload, &PropLoad::Message,
+		     this, &Headless::message);
+	Q_ASSERT(ok);
+	ok = connect(&propload, &PropLoad::Error,
+		     this, &Headless::error);
+	Q_ASSERT(ok);
+	if (m_verbose)
+	    print(tr("First byte after %1 ms.").arg(m_clock.elapsed()));
+	if (!propload.load_data(binary))
+	    return Exit_Upload;
+	print(tr("Uploaded %1 bytes to %2 in %3 ms.")
+	      .arg(binary.size())
+	      .arg(port_name)
+	      .arg(m_clock.elapsed()));
+    }
+
+    if (!parser.isSet(opt_term))
+	return Exit_Ok;
+
+#if defined(Q_OS_UNIX)
+    bool ok = connect(m_stty, &QSerialPort::readyRead,
+		      this, &Headless::port_ready_read);
+    Q_ASSERT(ok);
+    ok = connect(m_stty, &QSerialPort::errorOccurred,
+		 this, &Headless::port_error);
+    Q_ASSERT(ok);
+    m_stdin = new QSocketNotifier(STDIN_FILENO, QSocketNotifier::Read, this);
+    ok = connect(m_stdin, &QSocketNotifier::activated,
+		 this, &Headless::stdin_ready);
+    Q_ASSERT(ok);
+    if (raw_mode())
+	print(tr("Press Ctrl-] to quit."));
+    port_ready_read();
+    const int result = QCoreApplication::exec();
+    restore_tty();
+    m_raw = false;
+    return result;
+#else
+    print(tr("The terminal is not supported on this platform."));
+    return Exit_Usage;
+#endif
+}
+
+/**
+ * @brief Print the upload progress in percent
+ * @param value number of bytes sent
+ * @param total number of bytes to send
+ */
+void Headless::progress(qint64 value, qint64 total)
+{
+    const int percent = total > 0 ? static_cast<int>(value * 100 / total) : 100;
+    if (percent == m_percent)
+	return;
+    m_percent = percent;
+    fprintf(stderr, "\r%s", qPrintable(tr("Uploading: %1%").arg(percent, 3)));
+    if (percent >= 100)
+	fputc('\n', stderr);
+    fflush(stderr);
+}
+
+void Headless::message(const QString& text)
+{
+    if (m_verbose)
+	print(text);
+}
+
+void Headless::error(const QString& text)
+{
+    if (m_percent >= 0 && m_percent < 100)
+	fputc('\n', stderr);
+    print(text);
+}
+
+/**
+ * @brief Copy the data received from the port to stdout
+ */
+void Headless::port_ready_read()
+{
+    const QByteArray data = m_stty->readAll();
+    if (data.isEmpty())
+	return;
+    fwrite(data.constData(), 1, static_cast<size_t>(data.size()), stdout);
+    fflush(stdout);
+}
+
+/**
+ * @brief Quit the terminal if the port went away
+ * @param error error code of the port
+ */
+void Headless::port_error(QSerialPort::SerialPortError error)
+{
+    if (QSerialPort::ResourceError != error)
+	return;
+    print(tr("Lost %1: %2").arg(m_stty->portName()).arg(m_stty->errorString()));
+    QCoreApplication::exit(Exit_Disconnected);
+}
+
+/**
+ * @brief Send the data read from stdin to the port; quit at the end of input
+ */
+void Headless::stdin_ready()
+{
+#if defined(Q_OS_UNIX)
+    char buffer[4096];
+    const ssize_t got = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (got <= 0) {
+	m_stdin->setEnabled(false);
+	m_stty->waitForBytesWritten(1000);
+	QCoreApplication::exit(Exit_Ok);
+	return;
+    }
+    const char* quit = m_raw ? static_cast<const char*>(memchr(buffer, quit_key, static_cast<size_t>(got))) : nullptr;
+    if (quit) {
+	m_stty->write(buffer, quit - buffer);
+	m_stdin->setEnabled(false);
+	m_stty->waitForBytesWritten(1000);
+	QCoreApplication::exit(Exit_Ok);
+	return;
+    }
+    m_stty->write(buffer, got);
+#endif
+}
+
+/**
+ * @brief Print a line to stderr
+ * @param text text to print
+ */
+void Headless::print(const QString& text)
+{
+    // output processing is off in raw mode
+    fprintf(stderr, m_raw ? "%s\r\n" : "%s\n", qPrintable(text));
+    fflush(stderr);
+}
+
+/**
+ * @brief Put the terminal on stdin into raw mode
+ * The previous settings are restored by restore_tty(), which is called
+ * at the end of exec(), at exit, and on the signals which terminate.
+ * @return true if stdin is a terminal and is now in raw mode
+ */
+bool Headless::raw_mode()
+{
+#if defined(Q_OS_UNIX)
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_tio) < 0)
+	return false;
+    struct termios tio = saved_tio;
+    cfmakeraw(&tio);
+    tio_saved = 1;
+    atexit(restore_tty);
+    static const int signals[] = {SIGHUP, SIGINT, SIGQUIT, SIGTERM, SIGABRT, SIGSEGV};
+    for (size_t i = 0; i < sizeof(signals) / sizeof(signals[0]); i++)
+	signal(signals[i], restore_tty_signal);
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &tio) < 0) {
+	restore_tty();
+	return false;
+    }
+    m_raw = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Reset the Propeller by toggling DTR like SerTerm::reset_prop()
+ */
+void Headless::reset_prop()
+{
+    m_stty->setDataTerminalReady(false);
+    QThread::msleep(10);
+    m_stty->setDataTerminalReady(true);
+    m_stty->clear(QSerialPort::Input);
+}
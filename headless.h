@@ -0,0 +1,72 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 command line loader and terminal
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QElapsedTimer>
+#include <QSerialPort>
+#include <QStringList>
+
+class QSocketNotifier;
+
+/**
+ * @brief The Headless class uploads a binary and runs a terminal without the GUI.
+ *
+ * It is used when qflexprop is started with --load or --term, e.g.
+ * <pre>qflexprop --port /dev/ttyUSB0 --baud 2000000 --load image.binary --term</pre>
+ * Only a QCoreApplication is created, the serial port is opened by name,
+ * and nothing else is set up before the first byte is sent.
+ *
+ * Progress and errors are printed to stderr. In terminal mode the data
+ * received from the port is written to stdout unchanged, so the calling
+ * terminal interprets the escape sequences, and stdin is sent to the port.
+ * If stdin is a terminal, it is put into raw mode, so every key is sent
+ * to the port as it is typed, including Ctrl-C. Ctrl-] (@ref quit_key)
+ * quits. The terminal's settings are restored on exit and on signals.
+ */
+class Headless : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr char quit_key = 0x1d;	//!< Ctrl-] quits the raw terminal
+
+    enum ExitCode {
+	Exit_Ok = 0,
+	Exit_Usage,
+	Exit_Port,
+	Exit_File,
+	Exit_Upload,
+	Exit_Disconnected
+    };
+
+    explicit Headless(QObject* parent = nullptr);
+
+    static bool wanted(int argc, char* argv[]);
+    int exec(const QStringList& arguments);
+
+private slots:
+    void progress(qint64 value, qint64 total);
+    void message(const QString& text);
+    void error(const QString& text);
+    void port_ready_read();
+    void port_error(QSerialPort::SerialPortError error);
+    void stdin_ready();
+
+private:
+    QElapsedTimer m_clock;		    //!< time since the start
+    QSerialPort* m_stty;		    //!< serial port
+    QSocketNotifier* m_stdin;		    //!< notifier for data on stdin
+    bool m_verbose;			    //!< print timings and messages
+    int m_percent;			    //!< last progress printed
+    bool m_raw;				    //!< stdin is a terminal in raw mode
+
+    void print(const QString& text);
+    bool raw_mode();
+    void reset_prop();
+};
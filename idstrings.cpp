@@ -41,6 +41,8 @@ const QLatin1String id_parity("parity");
 const QLatin1String id_stop_bits("stop_bits");
 const QLatin1String id_flow_control("flow_control");
 const QLatin1String id_local_echo("local_echo");
+const QLatin1String id_read_buffer_size("read_buffer_size");
+const QLatin1String id_overflow_policy("overflow_policy");
 const QLatin1String id_parity_data_stop("data_parity_stop");
 
 const QLatin1String id_port_name("port_name");
@@ -59,6 +61,8 @@ const QLatin1String id_zoom("zoom");
 const QLatin1String id_font_family("font_family");
 
 const QLatin1String id_grp_serterm("serterm");
+const QLatin1String id_sendfile_line_delay("sendfile_line_delay");
+const QLatin1String id_sendfile_echo_wait("sendfile_echo_wait");
 
 const QLatin1String id_dcd("dcd");
 const QLatin1String id_dsr("dsr");
@@ -73,6 +77,21 @@ const QLatin1String id_fe("fe");
 const QLatin1String id_pe("pe");
 const QLatin1String id_pwr("pwr");
 
+const QLatin1String id_grp_capture("capture");
+const QLatin1String id_capture("capture");
+const QLatin1String id_capture_path("path");
+const QLatin1String id_capture_segment_size("segment_size");
+const QLatin1String id_capture_compress("compress");
+const QLatin1String id_read_buffer("read_buffer");
+const QLatin1String id_grp_triggers("triggers");
+const QLatin1String id_triggers_enabled("enabled");
+const QLatin1String id_trigger("trigger");
+const QLatin1String id_trigger_name("name");
+const QLatin1String id_trigger_pattern("pattern");
+const QLatin1String id_trigger_regex("regex");
+const QLatin1String id_trigger_actions("actions");
+const QLatin1String id_trigger_response("response");
+
 const QLatin1String id_progress("progress");
 const QLatin1String id_download_path("downloads");
 
@@ -98,6 +117,7 @@ const QLatin1String p2tools_path("");
 const QLatin1String id_grp_flexspin("flexspin");
 const QLatin1String id_compile_verbose_upload("quiet_mode");
 const QLatin1String id_compile_switch_to_term("switch_to_term)");
+const QLatin1String id_compile_background("compile_background");
 const QLatin1String id_flexspin_executable("executable");
 const QLatin1String id_flexspin_quiet("quiet");
 const QLatin1String id_flexspin_include_paths("include_paths");
@@ -109,13 +129,16 @@ const QLatin1String id_flexspin_hub_address("hub_adress");
 const QLatin1String id_flexspin_skip_coginit("skip_coginit");
 
 const char id_process_tb[] = "tb";		//!< for property QTextBrowser* of QObjects
-const char id_tab_lst[] = "lst";		//!< for property lst listing of tab widgets
-const char id_tab_p2asm[] = "p2asm";		//!< for property p2asm (intermediate) of tab widgets
+const char id_tab_lst[] = "lst";		//!< for property lst listing file name of tab widgets
+const char id_tab_p2asm[] = "p2asm";		//!< for property p2asm (intermediate) file name of tab widgets
 const char id_tab_binary[] = "binary";		//!< for property binary output of tab widgets
+const char id_tab_built[] = "built";		//!< for property last build time (ms since epoch) of tab widgets
 
 const char prop_sha256[] = "sha256";
 const char prop_filename[] = "filename";
 const char prop_filetype[] = "filetype";
+const char prop_mtime[] = "mtime";
+const char prop_size[] = "size";
 
 const QMap<int,QString> direction_str {
     {QSerialPort::Direction(0), QStringLiteral("?")},
@@ -180,6 +203,12 @@ const QMap<QSerialPort::FlowControl,const char *> flow_ctrl_tooltip {
     {QSerialPort::UnknownFlowControl, QT_TRANSLATE_NOOP("SerTerm", "Invalid flow control setting.")}
 };
 
+const QMap<Overflow_Policy,const char*> overflow_policy_str {
+    {Overflow_Throttle, QT_TRANSLATE_NOOP("SerTerm", "Throttle (RTS/CTS)")},
+    {Overflow_CaptureOnly, QT_TRANSLATE_NOOP("SerTerm", "Capture only")},
+    {Overflow_Discard, QT_TRANSLATE_NOOP("SerTerm", "Discard")}
+};
+
 const QMap<QString,QString> pinout_leds = {
     {id_dcd, QT_TRANSLATE_NOOP("SerTerm", "Status of the Data Carrier Detect line.")},
     {id_dsr, QT_TRANSLATE_NOOP("SerTerm", "Status of the Data Set Ready line.")},
@@ -10,6 +10,7 @@
 #pragma once
 #include <QLatin1String>
 #include <QSerialPort>
+#include "proptypes.h"
 
 #define	DEBUG_DATA	0
 
@@ -41,6 +42,8 @@ extern const QLatin1String id_parity;
 extern const QLatin1String id_stop_bits;
 extern const QLatin1String id_flow_control;
 extern const QLatin1String id_local_echo;
+extern const QLatin1String id_read_buffer_size;
+extern const QLatin1String id_overflow_policy;
 extern const QLatin1String id_parity_data_stop;
 
 extern const QLatin1String id_port_name;
@@ -59,6 +62,8 @@ extern const QLatin1String id_zoom;
 extern const QLatin1String id_font_family;
 
 extern const QLatin1String id_grp_serterm;
+extern const QLatin1String id_sendfile_line_delay;
+extern const QLatin1String id_sendfile_echo_wait;
 
 extern const QLatin1String id_dcd;
 extern const QLatin1String id_dsr;
@@ -73,6 +78,21 @@ extern const QLatin1String id_fe;
 extern const QLatin1String id_pe;
 extern const QLatin1String id_pwr;
 
+extern const QLatin1String id_grp_capture;
+extern const QLatin1String id_capture;
+extern const QLatin1String id_capture_path;
+extern const QLatin1String id_capture_segment_size;
+extern const QLatin1String id_capture_compress;
+extern const QLatin1String id_read_buffer;
+extern const QLatin1String id_grp_triggers;
+extern const QLatin1String id_triggers_enabled;
+extern const QLatin1String id_trigger;
+extern const QLatin1String id_trigger_name;
+extern const QLatin1String id_trigger_pattern;
+extern const QLatin1String id_trigger_regex;
+extern const QLatin1String id_trigger_actions;
+extern const QLatin1String id_trigger_response;
+
 extern const QLatin1String id_progress;
 extern const QLatin1String id_download_path;
 
@@ -95,12 +115,14 @@ extern const QMap<QSerialPort::Parity,const char *> parity_str;
 extern const QMap<QSerialPort::FlowControl,const char*> flow_control_str;
 extern const QMap<QSerialPort::FlowControl,const char *> flow_ctrl_str;
 extern const QMap<QSerialPort::FlowControl,const char *> flow_ctrl_tooltip;
+extern const QMap<Overflow_Policy,const char*> overflow_policy_str;
 extern const QMap<QString,QString> pinout_leds;
 
 extern const QLatin1String p2tools_path;
 extern const QLatin1String id_grp_flexspin;
 extern const QLatin1String id_compile_verbose_upload;
 extern const QLatin1String id_compile_switch_to_term;
+extern const QLatin1String id_compile_background;
 extern const QLatin1String id_flexspin_executable;
 extern const QLatin1String id_flexspin_include_paths;
 extern const QLatin1String id_flexspin_quiet;
@@ -115,7 +137,10 @@ extern const char id_process_tb[];
 extern const char id_tab_lst[];
 extern const char id_tab_p2asm[];
 extern const char id_tab_binary[];
+extern const char id_tab_built[];
 
 extern const char prop_sha256[];
 extern const char prop_filename[];
 extern const char prop_filetype[];
+extern const char prop_mtime[];
+extern const char prop_size[];
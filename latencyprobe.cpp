@@ -0,0 +1,542 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial latency and jitter probe
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QStringList>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include "latencyprobe.h"
+
+#define	DEBUG_LATENCYPROBE	0
+
+#if defined(DEBUG_LATENCYPROBE) && (DEBUG_LATENCYPROBE != 0)
+#define	DBG_LATENCYPROBE(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_LATENCYPROBE(X,...) /* X */
+#endif
+
+/*
+ * Host to P2:
+ *   'P' seq.32 ns.64 pad[3]	echoed as 'p' followed by the same 15 bytes
+ *   'U' count.32 data[count]	answered with 'u' count.32 ticks.32 clkfreq.32
+ *   'D' count.32		answered with 'd' count.32 data[count]
+ * All numbers are little endian, the bulk data bytes are (index & 0xff).
+ */
+static constexpr int upstream_reply_size = 13;
+static constexpr int downstream_header_size = 5;
+static constexpr int hist_bar_width = 50;
+
+LatencyProbe::LatencyProbe(QObject* parent)
+    : QObject(parent)
+    , m_dev(nullptr)
+    , m_baud_rate(0)
+    , m_state(st_idle)
+    , m_timer()
+    , m_clock()
+    , m_update()
+    , m_rx()
+    , m_error()
+    , m_burst(0)
+    , m_seq(0)
+    , m_burst_seq(0)
+    , m_pending(0)
+    , m_answered(0)
+    , m_lost(0)
+    , m_rtt()
+    , m_up_ticks(0)
+    , m_up_clkfreq(0)
+    , m_down_count(-1)
+    , m_down_first(0)
+    , m_down_start_ns(0)
+    , m_down_end_ns(0)
+    , m_down_errors(0)
+    , m_last_ns(-1)
+    , m_intervals()
+{
+    m_timer.setSingleShot(true);
+    bool ok = connect(&m_timer, SIGNAL(timeout()), SLOT(timeout()));
+    Q_ASSERT(ok);
+}
+
+LatencyProbe::~LatencyProbe()
+{
+    cancel();
+}
+
+/**
+ * @brief Start probing
+ * @param dev pointer to the device connected to the echo program
+ * @param baud_rate baud rate of the device
+ * @return true if the probe was started
+ */
+bool LatencyProbe::start(QIODevice* dev, qint32 baud_rate)
+{
+    cancel();
+    m_error.clear();
+    if (!dev || !dev->isOpen()) {
+	m_error = tr("The device is not open.");
+	return false;
+    }
+    m_dev = dev;
+    m_baud_rate = baud_rate;
+    bool ok = connect(m_dev, SIGNAL(aboutToClose()), this, SLOT(device_closing()),
+		      Qt::UniqueConnection);
+    Q_ASSERT(ok);
+    m_rx.clear();
+    m_burst = 0;
+    m_seq = 0;
+    m_pending = 0;
+    m_lost = 0;
+    m_rtt.clear();
+    m_rtt.reserve(bursts * burst_size);
+    m_up_ticks = 0;
+    m_up_clkfreq = 0;
+    m_down_count = -1;
+    m_down_errors = 0;
+    m_last_ns = -1;
+    m_intervals.clear();
+    m_clock.start();
+    m_update.start();
+    m_state = st_ping;
+    DBG_LATENCYPROBE("%s: %d bursts of %d pings at %d baud", __func__, bursts, burst_size, baud_rate);
+    next_burst();
+    return true;
+}
+
+/**
+ * @brief Stop probing
+ */
+void LatencyProbe::cancel()
+{
+    if (!m_dev)
+	return;
+    m_error = tr("Cancelled.");
+    finish(false);
+}
+
+/**
+ * @brief Return true while the probe is running
+ * @return true if running
+ */
+bool LatencyProbe::running() const
+{
+    return !m_dev.isNull();
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString LatencyProbe::error_string() const
+{
+    return m_error;
+}
+
+/**
+ * @brief Return the value at a percentile of a sorted list
+ * @param sorted const reference to the sorted values
+ * @param p percentile from 0.0 to 1.0
+ * @return value, or 0 if the list is empty
+ */
+static qint64 percentile(const QVector<qint64>& sorted, double p)
+{
+    if (sorted.isEmpty())
+	return 0;
+    const int index = qRound(p * (sorted.count() - 1));
+    return sorted[qBound(0, index, sorted.count() - 1)];
+}
+
+/**
+ * @brief Format a time in ns as µs
+ * @param ns time in ns
+ * @return string with one decimal
+ */
+static QString usec(qint64 ns)
+{
+    return QString::number(static_cast<double>(ns) / 1e3, 'f', 1);
+}
+
+/**
+ * @brief Append the min, percentiles and max of a list of times
+ * @param lines pointer to the list of lines to append to
+ * @param values list of times in ns
+ */
+static void append_percentiles(QStringList* lines, QVector<qint64> values)
+{
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    foreach(qint64 value, values)
+	sum += static_cast<double>(value);
+    const double mean = sum / values.count();
+    double var = 0.0;
+    foreach(qint64 value, values)
+	var += (value - mean) * (value - mean);
+    const double stddev = std::sqrt(var / values.count());
+    *lines += QObject::tr("    min %1 µs, median %2 µs, 90%: %3 µs, 99%: %4 µs, 99.9%: %5 µs, max %6 µs")
+	      .arg(usec(values.first()))
+	      .arg(usec(percentile(values, 0.5)))
+	      .arg(usec(percentile(values, 0.9)))
+	      .arg(usec(percentile(values, 0.99)))
+	      .arg(usec(percentile(values, 0.999)))
+	      .arg(usec(values.last()));
+    *lines += QObject::tr("    mean %1 µs, standard deviation %2 µs")
+	      .arg(usec(static_cast<qint64>(mean)))
+	      .arg(usec(static_cast<qint64>(stddev)));
+}
+
+/**
+ * @brief Format a throughput
+ * @param bps bytes per second
+ * @param line_rate bytes per second the baud rate allows
+ * @return string with the rate and the percentage of the line rate
+ */
+static QString rate(qint64 bps, qint64 line_rate)
+{
+    if (line_rate <= 0)
+	return QObject::tr("%1 bytes/s").arg(bps);
+    return QObject::tr("%1 bytes/s (%2% of the line rate)")
+	    .arg(bps)
+	    .arg(QString::number(100.0 * bps / line_rate, 'f', 1));
+}
+
+/**
+ * @brief Return the results as text
+ * @return multi line report
+ */
+QString LatencyProbe::report() const
+{
+    QStringList lines;
+    const qint64 line_rate = m_baud_rate / 10;
+    lines += tr("Line rate at %1 baud (8N1): %2 bytes/s").arg(m_baud_rate).arg(line_rate);
+    lines += QString();
+
+    lines += tr("Round trip of %1 byte pings in %2 bursts of %3:")
+	     .arg(ping_size).arg(m_burst).arg(burst_size);
+    lines += tr("    %1 echoed, %2 lost").arg(m_rtt.count()).arg(m_lost);
+    if (!m_rtt.isEmpty())
+	append_percentiles(&lines, m_rtt);
+    lines += QString();
+
+    lines += tr("Throughput:");
+    if (m_up_ticks > 0 && m_up_clkfreq > 0) {
+	const qint64 bps = static_cast<qint64>((bulk_size - 1) * static_cast<double>(m_up_clkfreq) / m_up_ticks);
+	lines += tr("    host to P2: %1").arg(rate(bps, line_rate));
+    } else {
+	lines += tr("    host to P2: not measured");
+    }
+    if (m_down_end_ns > m_down_start_ns) {
+	const qint64 bytes = m_down_count - m_down_first;
+	const qint64 bps = static_cast<qint64>(bytes * 1e9 / (m_down_end_ns - m_down_start_ns));
+	lines += tr("    P2 to host: %1").arg(rate(bps, line_rate));
+	if (m_down_errors > 0)
+	    lines += tr("    P2 to host: %1 bytes with unexpected values").arg(m_down_errors);
+    } else {
+	lines += tr("    P2 to host: not measured");
+    }
+    lines += QString();
+
+    if (m_intervals.isEmpty())
+	return lines.join(QChar('\n'));
+
+    lines += tr("readyRead() deliveries while receiving from the P2:");
+    lines += tr("    %1 deliveries, %2 bytes per delivery on average")
+	     .arg(m_intervals.count() + 1)
+	     .arg(QString::number(static_cast<double>(m_down_count) / (m_intervals.count() + 1), 'f', 1));
+    lines += tr("    interval between deliveries:");
+    append_percentiles(&lines, m_intervals);
+    lines += QString();
+
+    // histogram of the intervals in powers of two µs
+    QVector<int> hist(hist_buckets, 0);
+    foreach(qint64 ns, m_intervals) {
+	qint64 us = ns / 1000;
+	int bucket = 0;
+	while (us >= 2 && bucket < hist_buckets - 1) {
+	    us >>= 1;
+	    bucket++;
+	}
+	hist[bucket]++;
+    }
+    int first = 0;
+    while (first < hist_buckets && 0 == hist[first])
+	first++;
+    int last = hist_buckets - 1;
+    while (last > first && 0 == hist[last])
+	last--;
+    const int peak = *std::max_element(hist.constBegin(), hist.constEnd());
+    lines += tr("    interval (µs)      count");
+    for (int bucket = first; bucket <= last; bucket++) {
+	const QString range = bucket == hist_buckets - 1
+			      ? QString(">= %1").arg(1 << bucket)
+			      : QString("%1 - %2").arg(bucket ? 1 << bucket : 0).arg((1 << (bucket + 1)) - 1);
+	const int bar = peak > 0 ? (hist[bucket] * hist_bar_width + peak - 1) / peak : 0;
+	lines += QString("    %1 %2 %3")
+		 .arg(range, 17)
+		 .arg(hist[bucket], 6)
+		 .arg(QString(bar, QChar('#')));
+    }
+    return lines.join(QChar('\n'));
+}
+
+/**
+ * @brief Handle the data received from the echo program
+ * @param data const reference to the received data
+ */
+void LatencyProbe::received(const QByteArray& data)
+{
+    if (st_idle == m_state)
+	return;
+    const qint64 now = m_clock.nsecsElapsed();
+    m_rx += data;
+    switch (m_state) {
+    case st_idle:
+	break;
+    case st_ping:
+	parse_pings(now);
+	break;
+    case st_upstream:
+	parse_upstream();
+	break;
+    case st_downstream:
+	parse_downstream(now);
+	break;
+    }
+}
+
+/**
+ * @brief Send the next burst of pings, or start the throughput phase
+ */
+void LatencyProbe::next_burst()
+{
+    if (st_ping != m_state)
+	return;
+    if (m_burst >= bursts) {
+	send_upstream();
+	return;
+    }
+
+    QByteArray burst(burst_size * ping_size, '\0');
+    uchar* p = reinterpret_cast<uchar*>(burst.data());
+    m_burst_seq = m_seq;
+    for (int i = 0; i < burst_size; i++, p += ping_size) {
+	p[0] = 'P';
+	qToLittleEndian<quint32>(m_seq++, p + 1);
+	qToLittleEndian<qint64>(m_clock.nsecsElapsed(), p + 5);
+    }
+    m_pending = burst_size;
+    m_answered = 0;
+    m_burst++;
+    m_dev->write(burst);
+    m_timer.start(reply_timeout);
+
+    if (m_update.elapsed() >= progress_interval) {
+	m_update.restart();
+	emit progress(m_burst, bursts + 2);
+    }
+}
+
+/**
+ * @brief Handle a missing reply
+ */
+void LatencyProbe::timeout()
+{
+    switch (m_state) {
+    case st_idle:
+	break;
+    case st_ping:
+	if (m_rtt.isEmpty() && 1 == m_burst) {
+	    m_error = tr("No echo from the P2. Is examples/latency_echo.spin2 running?");
+	    finish(false);
+	    break;
+	}
+	DBG_LATENCYPROBE("%s: burst %d lost %d pings", __func__, m_burst, m_pending);
+	m_lost += m_pending;
+	m_pending = 0;
+	next_burst();
+	break;
+    case st_upstream:
+	m_error = tr("No report from the P2 for the data sent to it.");
+	finish(false);
+	break;
+    case st_downstream:
+	m_error = tr("Received only %1 of %2 bytes from the P2.")
+		  .arg(qMax<qint64>(0, m_down_count))
+		  .arg(bulk_size);
+	finish(false);
+	break;
+    }
+}
+
+/**
+ * @brief Stop probing because the device is about to be closed
+ */
+void LatencyProbe::device_closing()
+{
+    m_error = tr("The device was closed.");
+    finish(false);
+}
+
+/**
+ * @brief Send the bulk data to the P2
+ */
+void LatencyProbe::send_upstream()
+{
+    m_state = st_upstream;
+    m_rx.clear();
+    QByteArray data(static_cast<int>(1 + 4 + bulk_size), '\0');
+    uchar* p = reinterpret_cast<uchar*>(data.data());
+    p[0] = 'U';
+    qToLittleEndian<quint32>(static_cast<quint32>(bulk_size), p + 1);
+    for (qint64 i = 0; i < bulk_size; i++)
+	p[5 + i] = static_cast<uchar>(i);
+    m_dev->write(data);
+    m_timer.start(static_cast<int>(bulk_timeout()));
+    emit progress(bursts, bursts + 2);
+}
+
+/**
+ * @brief Ask the P2 to send its bulk data
+ */
+void LatencyProbe::send_downstream()
+{
+    m_state = st_downstream;
+    m_rx.clear();
+    m_down_count = -1;
+    m_last_ns = -1;
+    QByteArray data(5, '\0');
+    uchar* p = reinterpret_cast<uchar*>(data.data());
+    p[0] = 'D';
+    qToLittleEndian<quint32>(static_cast<quint32>(bulk_size), p + 1);
+    m_dev->write(data);
+    m_timer.start(static_cast<int>(bulk_timeout()));
+    emit progress(bursts + 1, bursts + 2);
+}
+
+/**
+ * @brief Take the round trip times of the echoed pings
+ * @param now time of the delivery in ns
+ */
+void LatencyProbe::parse_pings(qint64 now)
+{
+    int pos = 0;
+    while (m_rx.size() - pos >= ping_size) {
+	const uchar* p = reinterpret_cast<const uchar*>(m_rx.constData()) + pos;
+	if ('p' != p[0]) {
+	    // resynchronize
+	    pos++;
+	    continue;
+	}
+	pos += ping_size;
+	const quint32 index = qFromLittleEndian<quint32>(p + 1) - m_burst_seq;
+	if (index >= static_cast<quint32>(burst_size) || (m_answered & (1u << index)))
+	    continue;
+	m_answered |= 1u << index;
+	m_rtt += now - qFromLittleEndian<qint64>(p + 5);
+	if (--m_pending == 0) {
+	    m_timer.stop();
+	    QTimer::singleShot(burst_gap, this, SLOT(next_burst()));
+	}
+    }
+    m_rx.remove(0, pos);
+}
+
+/**
+ * @brief Take the P2's timing of the data sent to it
+ */
+void LatencyProbe::parse_upstream()
+{
+    const int start = m_rx.indexOf('u');
+    if (start < 0) {
+	m_rx.clear();
+	return;
+    }
+    m_rx.remove(0, start);
+    if (m_rx.size() < upstream_reply_size)
+	return;
+    const uchar* p = reinterpret_cast<const uchar*>(m_rx.constData());
+    const qint64 count = qFromLittleEndian<quint32>(p + 1);
+    m_up_ticks = qFromLittleEndian<quint32>(p + 5);
+    m_up_clkfreq = qFromLittleEndian<quint32>(p + 9);
+    m_timer.stop();
+    DBG_LATENCYPROBE("%s: %lld bytes in %lld ticks at %lld Hz", __func__, count, m_up_ticks, m_up_clkfreq);
+    if (count != bulk_size) {
+	m_error = tr("The P2 received %1 of %2 bytes.").arg(count).arg(bulk_size);
+	finish(false);
+	return;
+    }
+    send_downstream();
+}
+
+/**
+ * @brief Count and time the bulk data from the P2
+ * @param now time of the delivery in ns
+ */
+void LatencyProbe::parse_downstream(qint64 now)
+{
+    if (m_down_count < 0) {
+	const int start = m_rx.indexOf('d');
+	if (start < 0) {
+	    m_rx.clear();
+	    return;
+	}
+	m_rx.remove(0, start);
+	if (m_rx.size() < downstream_header_size)
+	    return;
+	m_rx.remove(0, downstream_header_size);
+	m_down_count = 0;
+    }
+    if (m_rx.isEmpty())
+	return;
+
+    if (m_last_ns >= 0) {
+	m_intervals += now - m_last_ns;
+    } else {
+	m_down_start_ns = now;
+	m_down_first = m_rx.size();
+    }
+    m_last_ns = now;
+    m_down_end_ns = now;
+
+    const uchar* p = reinterpret_cast<const uchar*>(m_rx.constData());
+    for (int i = 0; i < m_rx.size(); i++)
+	if (p[i] != static_cast<uchar>(m_down_count + i))
+	    m_down_errors++;
+    m_down_count += m_rx.size();
+    m_rx.clear();
+
+    if (m_down_count >= bulk_size)
+	finish(true);
+}
+
+/**
+ * @brief Stop probing and report the result
+ * @param ok true if all phases were completed
+ */
+void LatencyProbe::finish(bool ok)
+{
+    m_timer.stop();
+    m_state = st_idle;
+    if (m_dev)
+	disconnect(m_dev, SIGNAL(aboutToClose()), this, SLOT(device_closing()));
+    m_dev = nullptr;
+    emit progress(bursts + 2, bursts + 2);
+    DBG_LATENCYPROBE("%s: %s, %d round trips, %d intervals", __func__,
+		     ok ? "done" : "failed", m_rtt.count(), m_intervals.count());
+    emit finished(ok);
+}
+
+/**
+ * @brief Return the time to wait for the bulk data in one direction
+ * @return timeout in ms, twice the time at the line rate plus 2s
+ */
+qint64 LatencyProbe::bulk_timeout() const
+{
+    const qint64 baud_rate = qMax(m_baud_rate, 300);
+    return 2000 + bulk_size * 10 * 1000 * 2 / baud_rate;
+}
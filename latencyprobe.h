@@ -0,0 +1,116 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial latency and jitter probe
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QVector>
+
+/**
+ * @brief The LatencyProbe class measures the serial round trip to an echo program on the P2.
+ *
+ * The probe talks to examples/latency_echo.spin2 and runs three phases:
+ *
+ * First @ref bursts bursts of @ref burst_size pings are sent. Each ping
+ * carries a sequence number and the time it was written, and the echo
+ * program returns it unchanged, so the round trip time of every ping is
+ * known without bookkeeping on the host. A burst which is not answered
+ * within @ref reply_timeout counts its missing pings as lost.
+ *
+ * Then @ref bulk_size bytes are sent to the P2, which measures the time
+ * from the first to the last byte with its system counter, and the P2
+ * sends @ref bulk_size bytes back, whose arrival is timed on the host.
+ * This gives the throughput of each direction separately.
+ *
+ * While the P2 sends its bulk data, the interval between the calls to
+ * @ref received is recorded. These are the readyRead() deliveries of
+ * the application's read path, so their distribution shows the effect
+ * of the adapter's latency timer, the driver and the event loop.
+ *
+ * The received data must be passed to @ref received. The probe is
+ * cancelled when the device is about to be closed.
+ */
+class LatencyProbe : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int bursts = 50;			//!< number of ping bursts
+    static constexpr int burst_size = 8;		//!< pings per burst
+    static constexpr int ping_size = 16;		//!< bytes per ping and its echo
+    static constexpr int burst_gap = 20;		//!< ms between the end of a burst and the next
+    static constexpr int reply_timeout = 1000;		//!< ms to wait for the echoes of a burst
+    static constexpr qint64 bulk_size = 32 * 1024;	//!< bytes sent in each direction
+    static constexpr int hist_buckets = 21;		//!< powers of two from 1µs to 1s in the histogram
+    static constexpr int progress_interval = 250;	//!< ms between progress signals
+
+    explicit LatencyProbe(QObject* parent = nullptr);
+    ~LatencyProbe();
+
+    bool start(QIODevice* dev, qint32 baud_rate);
+    void cancel();
+
+    bool running() const;
+    QString error_string() const;
+    QString report() const;
+
+signals:
+    void progress(qint64 value, qint64 total);
+    void finished(bool ok);
+
+public slots:
+    void received(const QByteArray& data);
+
+private slots:
+    void next_burst();
+    void timeout();
+    void device_closing();
+
+private:
+    enum State {
+	st_idle,		    //!< not running
+	st_ping,		    //!< sending bursts of pings
+	st_upstream,		    //!< waiting for the P2's 'u' report
+	st_downstream		    //!< receiving the P2's bulk data
+    };
+
+    QPointer<QIODevice> m_dev;		    //!< device to probe
+    qint32 m_baud_rate;			    //!< baud rate for the timeouts and the line rate
+    State m_state;			    //!< current phase
+    QTimer m_timer;			    //!< reply timeout
+    QElapsedTimer m_clock;		    //!< time since the start
+    QElapsedTimer m_update;		    //!< time since the last progress signal
+    QByteArray m_rx;			    //!< received data not yet parsed
+    QString m_error;			    //!< most recent error message
+    int m_burst;			    //!< number of bursts sent
+    quint32 m_seq;			    //!< sequence number of the next ping
+    quint32 m_burst_seq;		    //!< sequence number of the first ping of the burst
+    int m_pending;			    //!< pings of the burst still waiting for their echo
+    quint32 m_answered;			    //!< bit mask of the pings of the burst which were echoed
+    int m_lost;				    //!< pings without an echo
+    QVector<qint64> m_rtt;		    //!< round trip times in ns
+    qint64 m_up_ticks;			    //!< P2 system clocks for the data sent to the P2
+    qint64 m_up_clkfreq;		    //!< P2 system clock frequency
+    qint64 m_down_count;		    //!< bytes received from the P2
+    qint64 m_down_first;		    //!< bytes in the first delivery from the P2
+    qint64 m_down_start_ns;		    //!< time of the first delivery from the P2
+    qint64 m_down_end_ns;		    //!< time of the last delivery from the P2
+    qint64 m_down_errors;		    //!< bytes from the P2 with an unexpected value
+    qint64 m_last_ns;			    //!< time of the previous delivery, or -1
+    QVector<qint64> m_intervals;	    //!< intervals between deliveries in ns
+
+    void send_upstream();
+    void send_downstream();
+    void parse_pings(qint64 now);
+    void parse_upstream();
+    void parse_downstream(qint64 now);
+    void finish(bool ok);
+    qint64 bulk_timeout() const;
+};
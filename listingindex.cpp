@@ -0,0 +1,263 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 listing address index
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QFile>
+#include <QHash>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "listingindex.h"
+
+#define	DEBUG_LISTINGINDEX	0
+
+#if defined(DEBUG_LISTINGINDEX) && (DEBUG_LISTINGINDEX != 0)
+#define	DBG_LISTINGINDEX(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_LISTINGINDEX(X,...) /* X */
+#endif
+
+ListingIndex::ListingIndex()
+    : m_by_addr()
+    , m_by_line()
+{
+}
+
+/**
+ * @brief Return true if the index has no entries
+ * @return true if empty
+ */
+bool ListingIndex::isEmpty() const
+{
+    return m_by_addr.isEmpty();
+}
+
+/**
+ * @brief Return the number of address ranges
+ * @return number of entries
+ */
+int ListingIndex::count() const
+{
+    return m_by_addr.count();
+}
+
+/**
+ * @brief Drop all entries
+ */
+void ListingIndex::clear()
+{
+    m_by_addr.clear();
+    m_by_line.clear();
+}
+
+/**
+ * @brief Build the index from a listing file
+ * @param filename name of the .lst file
+ * @param source text of the source which was compiled
+ * @return true on success, or false if the file can't be opened
+ */
+bool ListingIndex::load(const QString& filename, const QString& source)
+{
+    clear();
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly))
+	return false;
+    const qint64 size = file.size();
+    if (size <= 0)
+	return true;
+    const uchar* data = file.map(0, size);
+    if (data) {
+	parse(reinterpret_cast<const char*>(data), size, source);
+	file.unmap(const_cast<uchar*>(data));
+    } else {
+	const QByteArray contents = file.readAll();
+	parse(contents.constData(), contents.size(), source);
+    }
+    return true;
+}
+
+/**
+ * @brief Return the value of a hex digit
+ * @param ch character
+ * @return value 0 … 15, or -1 if @p ch is not a hex digit
+ */
+static inline int hexdigit(char ch)
+{
+    if (ch >= '0' && ch <= '9')
+	return ch - '0';
+    if (ch >= 'a' && ch <= 'f')
+	return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F')
+	return ch - 'A' + 10;
+    return -1;
+}
+
+static bool addr_less(const ListingIndex::Entry& a, const ListingIndex::Entry& b)
+{
+    return a.addr < b.addr;
+}
+
+static bool addr_less_than(quint32 addr, const ListingIndex::Entry& e)
+{
+    return addr < e.addr;
+}
+
+static bool line_less(const ListingIndex::Entry& a, const ListingIndex::Entry& b)
+{
+    return a.line < b.line;
+}
+
+static bool line_less_than(const ListingIndex::Entry& e, int line)
+{
+    return e.line < line;
+}
+
+/**
+ * @brief Build the index from the contents of a listing
+ * @param data pointer to the listing text
+ * @param size number of bytes at @p data
+ * @param source text of the source which was compiled
+ */
+void ListingIndex::parse(const char* data, qint64 size, const QString& source)
+{
+    QElapsedTimer timer;
+    timer.start();
+    clear();
+
+    // hash the whitespace simplified source lines to their line numbers
+    QHash<QString,QVector<int>> lines;
+    const QStringList src = source.split(QChar::LineFeed);
+    for (int i = 0; i < src.count(); i++) {
+	const QString text = src[i].simplified();
+	if (!text.isEmpty())
+	    lines[text] += i + 1;
+    }
+
+    const char* p = data;
+    const char* const end = data + size;
+    int row = 0;
+    int line = -1;		// current source line
+    int line_row = -1;		// listing row where the current source line was found
+    while (p < end) {
+	const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+	if (!eol)
+	    eol = end;
+	const char* bar = static_cast<const char*>(memchr(p, '|', static_cast<size_t>(eol - p)));
+
+	if (bar) {
+	    // match the text to a source line, preferring the next one after the current
+	    QString text = QString::fromUtf8(bar + 1, static_cast<int>(eol - bar - 1)).simplified();
+	    QHash<QString,QVector<int>>::const_iterator it = lines.constFind(text);
+	    if (it == lines.constEnd() && text.startsWith(QChar('\''))) {
+		// source line echoed as a comment
+		while (text.startsWith(QChar('\'')))
+		    text.remove(0, 1);
+		it = lines.constFind(text.simplified());
+	    }
+	    if (it != lines.constEnd()) {
+		const QVector<int>& candidates = it.value();
+		QVector<int>::const_iterator c = std::upper_bound(candidates.constBegin(),
+								  candidates.constEnd(), line);
+		line = c != candidates.constEnd() ? *c : candidates.first();
+		line_row = row;
+	    }
+
+	    // parse the hub address and count the data bytes
+	    const char* s = p;
+	    quint32 addr = 0;
+	    int digits = 0;
+	    for (; s < bar && hexdigit(*s) >= 0; s++, digits++)
+		addr = (addr << 4) | static_cast<quint32>(hexdigit(*s));
+	    quint32 bytes = 0;
+	    while (digits > 0 && s < bar) {
+		while (s < bar && isspace(static_cast<uchar>(*s)))
+		    s++;
+		const char* t = s;
+		while (t < bar && hexdigit(*t) >= 0)
+		    t++;
+		if (2 == t - s)
+		    bytes++;	// a data byte; three digits are the cog address
+		else if (t == s)
+		    break;
+		s = t;
+	    }
+
+	    if (bytes > 0 && line > 0) {
+		if (!m_by_addr.isEmpty() && m_by_addr.last().line == line &&
+		    m_by_addr.last().addr + m_by_addr.last().size == addr) {
+		    // extend the previous range
+		    m_by_addr.last().size += bytes;
+		} else {
+		    Entry e;
+		    e.addr = addr;
+		    e.size = bytes;
+		    e.line = line;
+		    e.row = line_row;
+		    m_by_addr += e;
+		}
+	    }
+	}
+	row++;
+	p = eol + 1;
+    }
+
+    std::stable_sort(m_by_addr.begin(), m_by_addr.end(), addr_less);
+    m_by_line = m_by_addr;
+    std::stable_sort(m_by_line.begin(), m_by_line.end(), line_less);
+
+    DBG_LISTINGINDEX("%s: %d rows, %d ranges in %lldms", __func__,
+		     row, m_by_addr.count(), timer.elapsed());
+}
+
+/**
+ * @brief Return the source line which generated the byte at a hub address
+ * @param addr hub address
+ * @return source line number (1 based), or -1 if not found
+ */
+int ListingIndex::line(quint32 addr) const
+{
+    QVector<Entry>::const_iterator it = std::upper_bound(m_by_addr.constBegin(), m_by_addr.constEnd(),
+							  addr, addr_less_than);
+    if (it == m_by_addr.constBegin())
+	return -1;
+    --it;
+    if (addr - it->addr >= it->size)
+	return -1;
+    return it->line;
+}
+
+/**
+ * @brief Return the address ranges generated by a source line
+ * @param line source line number (1 based)
+ * @return QVector of entries sorted by address; empty if the line generated no bytes
+ */
+QVector<ListingIndex::Entry> ListingIndex::entries(int line) const
+{
+    QVector<Entry> result;
+    QVector<Entry>::const_iterator it = std::lower_bound(m_by_line.constBegin(), m_by_line.constEnd(),
+							  line, line_less_than);
+    for (; it != m_by_line.constEnd() && it->line == line; ++it)
+	result += *it;
+    return result;
+}
+
+/**
+ * @brief Return the first entry of a source line, or of the next one which generated bytes
+ * @param line source line number (1 based)
+ * @return pointer to the entry, or nullptr if there is none
+ */
+const ListingIndex::Entry* ListingIndex::next(int line) const
+{
+    QVector<Entry>::const_iterator it = std::lower_bound(m_by_line.constBegin(), m_by_line.constEnd(),
+							  line, line_less_than);
+    if (it == m_by_line.constEnd())
+	return nullptr;
+    return &*it;
+}
@@ -0,0 +1,54 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 listing address index
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The ListingIndex class maps source lines to hub addresses and back.
+ *
+ * It is built once per build from the flexspin listing (.lst) file.
+ * Each listing line has the form "hub [cog] [bytes...] | text" and the
+ * text is either an assembler source line or a source line echoed as a
+ * comment. Texts are matched against the lines of the source to find
+ * out which source line generated the following bytes.
+ *
+ * The ranges are kept in two compact arrays, one sorted by address and
+ * one sorted by source line, so both directions of the lookup are a
+ * binary search.
+ */
+class ListingIndex
+{
+public:
+    struct Entry {
+	quint32 addr;		//!< first hub address
+	quint32 size;		//!< number of bytes
+	qint32 line;		//!< source line number (1 based)
+	qint32 row;		//!< listing row where the source line appears (0 based)
+    };
+
+    ListingIndex();
+
+    bool isEmpty() const;
+    int count() const;
+    void clear();
+
+    bool load(const QString& filename, const QString& source);
+    void parse(const char* data, qint64 size, const QString& source);
+
+    int line(quint32 addr) const;
+    QVector<Entry> entries(int line) const;
+    const Entry* next(int line) const;
+
+private:
+    QVector<Entry> m_by_addr;		//!< ranges sorted by address
+    QVector<Entry> m_by_line;		//!< ranges sorted by source line
+};
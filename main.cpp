@@ -8,13 +8,12 @@
  *
  *****************************************************************************/
 #include "qflexprop.h"
+#include "headless.h"
 
 #include <QApplication>
 
-int main(int argc, char *argv[])
+static void setup_application(QCoreApplication& a)
 {
-    QApplication a(argc, argv);
-
     a.setApplicationName(QLatin1String("QFlexProp"));
     a.setApplicationVersion(QString("%1.%2.%3")
 			    .arg(VERSION_MAJOR)
@@ -22,6 +21,20 @@ int main(int argc, char *argv[])
 			    .arg(VERSION_PATCH));
     a.setOrganizationName(QLatin1String("pullmoll"));
     a.setOrganizationDomain(QLatin1String("pullmoll.github.io"));
+}
+
+int main(int argc, char *argv[])
+{
+    if (Headless::wanted(argc, argv)) {
+	// no GUI and no display needed to upload and run a terminal
+	QCoreApplication a(argc, argv);
+	setup_application(a);
+	Headless headless;
+	return headless.exec(a.arguments());
+    }
+
+    QApplication a(argc, argv);
+    setup_application(a);
 
     QFlexProp w;
     w.show();
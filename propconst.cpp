@@ -61,6 +61,7 @@ CPropTokens::CPropTokens()
     add(TOK_CPP_ELIFNDEF, "#elifndef", "Preprocessor condition");
     add(TOK_CPP_DEFINE, "#define", "Preprocessor definition");
     add(TOK_CPP_UNDEF, "#undef", "Preprocessor definition remove");
+    add(TOK_CPP_INCLUDE, "#include", "Preprocessor include file");
 
     add(TOK_CON, "CON", "CON");
     add(TOK_VAR, "VAR", "VAR");
@@ -608,39 +609,25 @@ void CPropTokens::add(const PropToken t, const QString& name, const QString& des
     m_tokens.insert(t, CPropToken(t, name, desc));
 }
 
-QStringList CPropTokens::list(const QList<PropToken>& filter) const
+QString CPropTokens::name(const PropToken t) const
 {
-    QStringList list;
-    if (filter.isEmpty()) {
-	list.reserve(TOK_);
-	foreach(const CPropToken& tok, m_tokens.values())
-	    if (!tok.name().isNull())
-		list += tok.name();
-    } else {
-	list.reserve(filter.count());
-	foreach(const PropToken t, filter) {
-	    const CPropToken& tok = m_tokens.value(t);
-	    if (!tok.name().isNull())
-		list += tok.name();
-	}
-    }
-    return list;
+    return m_tokens.value(t).name();
 }
 
-QStringList CPropTokens::list_esc(const QList<PropToken>& filter) const
+QStringList CPropTokens::list(const QList<PropToken>& filter) const
 {
     QStringList list;
     if (filter.isEmpty()) {
 	list.reserve(TOK_);
 	foreach(const CPropToken& tok, m_tokens.values())
 	    if (!tok.name().isNull())
-		list += QRegExp::escape(tok.name());
+		list += tok.name();
     } else {
 	list.reserve(filter.count());
 	foreach(const PropToken t, filter) {
 	    const CPropToken& tok = m_tokens.value(t);
 	    if (!tok.name().isNull())
-		list += QRegExp::escape(tok.name());
+		list += tok.name();
 	}
     }
     return list;
@@ -657,6 +644,7 @@ const QList<PropToken> g_preproc = {
     TOK_CPP_ELIFNDEF,
     TOK_CPP_DEFINE,
     TOK_CPP_UNDEF,
+    TOK_CPP_INCLUDE,
 };
 
 const QList<PropToken> g_keywords = {
@@ -1193,3 +1181,170 @@ const QList<PropToken> g_operator = {
 };
 
 const CPropTokens g_tokens;
+
+/**
+ * @brief Return the upper case ASCII value of a character
+ * @param ch character
+ * @return upper case character code, or 0 if @p ch is not ASCII
+ */
+static inline uchar upper_ascii(const QChar ch)
+{
+    const ushort uc = ch.unicode();
+    if (uc >= 0x80)
+	return 0;
+    return (uc >= 'a' && uc <= 'z') ? static_cast<uchar>(uc - 32) : static_cast<uchar>(uc);
+}
+
+/**
+ * @brief FNV-1a hash of the upper case ASCII characters of a string
+ * @param str pointer to the characters
+ * @param len number of characters
+ * @param ok pointer to a bool set to false if a non-ASCII character is found
+ * @return hash value
+ */
+static inline quint32 fnv1a_upper(const QChar* str, int len, bool* ok)
+{
+    quint32 hash = 2166136261u;
+    for (int i = 0; i < len; i++) {
+	const uchar ch = upper_ascii(str[i]);
+	if (!ch) {
+	    *ok = false;
+	    return 0;
+	}
+	hash = (hash ^ ch) * 16777619u;
+    }
+    *ok = true;
+    return hash;
+}
+
+CPropTokenHash::CPropTokenHash(const CPropTokens& tokens)
+    : m_entries()
+    , m_table()
+    , m_mask(0)
+    , m_max_symbol_length(0)
+{
+    const QList<QPair<const QList<PropToken>*,int>> classes = {
+	{&g_preproc, CLASS_PREPROC},
+	{&g_keywords, CLASS_KEYWORD},
+	{&g_conditionals, CLASS_CONDITIONAL},
+	{&g_sections, CLASS_SECTION},
+	{&g_operator, CLASS_OPERATOR},
+    };
+
+    // size the table for a load factor below 50%
+    int count = 0;
+    for (int i = 0; i < classes.count(); i++)
+	count += classes[i].first->count();
+    quint32 size = 16;
+    while (size < static_cast<quint32>(2 * count))
+	size <<= 1;
+    m_table.fill(-1, static_cast<int>(size));
+    m_mask = size - 1;
+
+    for (int i = 0; i < classes.count(); i++) {
+	foreach(const PropToken t, *classes[i].first)
+	    insert(tokens.name(t), t, classes[i].second);
+    }
+}
+
+/**
+ * @brief Insert a name into the table or add a class to an existing name
+ * @param name token name
+ * @param tok token
+ * @param cls class bit
+ */
+void CPropTokenHash::insert(const QString& name, PropToken tok, int cls)
+{
+    if (name.isEmpty())
+	return;
+    bool ok;
+    const quint32 hash = fnv1a_upper(name.constData(), name.length(), &ok);
+    if (!ok)
+	return;
+
+    quint32 slot = hash & m_mask;
+    while (m_table[static_cast<int>(slot)] >= 0) {
+	Entry& e = m_entries[m_table[static_cast<int>(slot)]];
+	if (e.name == name.toLatin1().toUpper()) {
+	    e.classes |= cls;
+	    return;
+	}
+	slot = (slot + 1) & m_mask;
+    }
+
+    Entry e;
+    e.name = name.toLatin1().toUpper();
+    e.tok = tok;
+    e.classes = cls;
+    m_table[static_cast<int>(slot)] = m_entries.count();
+    m_entries.append(e);
+
+    const QChar first = name.at(0);
+    if (!first.isLetter() && first != QChar('_') && first != QChar('#'))
+	m_max_symbol_length = qMax(m_max_symbol_length, name.length());
+}
+
+/**
+ * @brief Find the entry for a name
+ * @param str pointer to the characters
+ * @param len number of characters
+ * @return index into m_entries, or -1 if not found
+ */
+int CPropTokenHash::find(const QChar* str, int len) const
+{
+    bool ok;
+    const quint32 hash = fnv1a_upper(str, len, &ok);
+    if (!ok)
+	return -1;
+
+    quint32 slot = hash & m_mask;
+    for (;;) {
+	const int idx = m_table[static_cast<int>(slot)];
+	if (idx < 0)
+	    return -1;
+	const QByteArray& name = m_entries[idx].name;
+	if (name.size() == len) {
+	    int i = 0;
+	    while (i < len && upper_ascii(str[i]) == static_cast<uchar>(name[i]))
+		i++;
+	    if (i == len)
+		return idx;
+	}
+	slot = (slot + 1) & m_mask;
+    }
+}
+
+/**
+ * @brief Return the classes of a token name
+ * @param str pointer to the characters
+ * @param len number of characters
+ * @return bit mask of Class values, or CLASS_NONE if not found
+ */
+int CPropTokenHash::classes(const QChar* str, int len) const
+{
+    const int idx = find(str, len);
+    return idx < 0 ? CLASS_NONE : m_entries[idx].classes;
+}
+
+/**
+ * @brief Return the token for a name
+ * @param str pointer to the characters
+ * @param len number of characters
+ * @return PropToken, or TOK_0 if not found
+ */
+PropToken CPropTokenHash::token(const QChar* str, int len) const
+{
+    const int idx = find(str, len);
+    return idx < 0 ? TOK_0 : m_entries[idx].tok;
+}
+
+/**
+ * @brief Return the length of the longest operator or keyword made of symbols
+ * @return number of characters
+ */
+int CPropTokenHash::max_symbol_length() const
+{
+    return m_max_symbol_length;
+}
+
+const CPropTokenHash g_token_hash(g_tokens);
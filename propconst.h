@@ -12,6 +12,8 @@
 #include <QString>
 #include <QMap>
 #include <QList>
+#include <QVector>
+#include <QByteArray>
 
 typedef enum {
     TOK_0,
@@ -26,6 +28,7 @@ typedef enum {
     TOK_CPP_ELIFNDEF,
     TOK_CPP_DEFINE,
     TOK_CPP_UNDEF,
+    TOK_CPP_INCLUDE,
 
     TOK_CON,
     TOK_VAR,
@@ -594,14 +597,57 @@ public:
     CPropTokens();
 
     void add(const PropToken t, const QString& name = QString(), const QString& desc = QString());
+    QString name(const PropToken t) const;
     QStringList list(const QList<PropToken>& filter = QList<PropToken>()) const;
-    QStringList list_esc(const QList<PropToken>& filter = QList<PropToken>()) const;
 
 private:
     QMap<PropToken,CPropToken> m_tokens;
 };
 
+/**
+ * @brief The CPropTokenHash class is a case insensitive lookup table for token names
+ *
+ * The table is built once from a CPropTokens instance and uses open addressing
+ * with linear probing. Lookups take a pointer and length into the caller's text
+ * and neither allocate nor copy, so they can be used from the highlighter's
+ * per-line lexer.
+ */
+class CPropTokenHash
+{
+public:
+    enum Class {
+	CLASS_NONE		= 0,
+	CLASS_PREPROC		= (1 << 0),
+	CLASS_KEYWORD		= (1 << 1),
+	CLASS_CONDITIONAL	= (1 << 2),
+	CLASS_SECTION		= (1 << 3),
+	CLASS_OPERATOR		= (1 << 4),
+    };
+
+    CPropTokenHash(const CPropTokens& tokens);
+
+    int classes(const QChar* str, int len) const;
+    PropToken token(const QChar* str, int len) const;
+    int max_symbol_length() const;
+
+private:
+    struct Entry {
+	QByteArray name;	    //!< upper case Latin1 name
+	PropToken tok;		    //!< first token with this name
+	int classes;		    //!< bit mask of Class values
+    };
+
+    QVector<Entry> m_entries;	    //!< unique token names
+    QVector<int> m_table;	    //!< open addressing table of indices into m_entries (-1 = empty)
+    quint32 m_mask;		    //!< table size - 1
+    int m_max_symbol_length;	    //!< length of the longest name which is not an identifier
+
+    void insert(const QString& name, PropToken tok, int cls);
+    int find(const QChar* str, int len) const;
+};
+
 extern const CPropTokens g_tokens;
+extern const CPropTokenHash g_token_hash;
 extern const QList<PropToken> g_preproc;
 extern const QList<PropToken> g_keywords;
 extern const QList<PropToken> g_conditionals;
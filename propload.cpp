@@ -67,15 +67,7 @@ bool PropLoad::use_checksum() const
  */
 bool PropLoad::load_data(const QByteArray& data, bool patch_mode)
 {
-    switch (m_mode) {
-    case Prop_Hex:
-	return load_single_data_hex(data, patch_mode);
-    case Prop_Txt:
-	return load_single_data_txt(data, patch_mode);
-    }
-    emit Error(tr("Invalid PropMode (%2).")
-	       .arg(m_mode));
-    return false;
+    return load_single_data(data, patch_mode);
 }
 
 bool PropLoad::load_file(const QString& filename, bool patch_mode)
@@ -83,77 +75,24 @@ bool PropLoad::load_file(const QString& filename, bool patch_mode)
     return load_single_file(filename, patch_mode);
 }
 
-void PropLoad::set_verbose(bool on)
-{
-    m_verbose = on;
-}
-
-void PropLoad::set_mode(PropLoad::PropLoadMode mode)
-{
-    m_mode = mode;
-}
-
-void PropLoad::set_clock_freq(quint32 clock_freq)
-{
-    m_clock_freq = clock_freq;
-}
-
-void PropLoad::set_clock_mode(quint32 clock_mode)
-{
-    m_clock_mode = clock_mode;
-}
-
-void PropLoad::set_user_baud(quint32 user_baud)
-{
-    m_user_baud = user_baud;
-}
-
-void PropLoad::set_use_checksum(bool use_checksum)
-{
-    m_use_checksum = use_checksum;
-}
-
-/**
- * @brief Compute a checksum of unsigned 32 bit little endian values in @p data
- * @param data const reference to the byte array to checksum
- * @return sum of 32 bit little endian values in @p data
- */
-quint32 PropLoad::compute_checksum(const QByteArray& data)
-{
-    quint32 checksum = 0;
-    for (int offs = 0; offs < data.size(); offs += sizeof(quint32))
-	checksum += util.get_le32(data, offs);
-    return checksum;
-}
-
 /**
- * @brief Upload a single file using base64 encoding
- * @param data const reference to the data block to send
+ * @brief Encode data for the current mode without sending it
+ * The result is the sequence of lines which @ref load_data would send.
+ * It can be sent to any number of devices with @ref load_encoded, which
+ * is how the same image is uploaded to a fleet of boards.
+ * @param data const reference to the data block to encode
  * @param patch_mode if true, patch in the clock frequence, mode, and user baud
- * @return true on success, or false on error
+ * @return QList of QByteArray with header, data lines, and checksum or skip
  */
-bool PropLoad::load_single_data_txt(const QByteArray& data, bool patch_mode)
+QList<QByteArray> PropLoad::encode(const QByteArray& data, bool patch_mode) const
 {
     static const QByteArray::Base64Options opts = QByteArray::OmitTrailingEquals;
-    int totnum = 0;
+    const bool hex = Prop_Hex == m_mode;
+    QList<QByteArray> stream;
     quint32 checksum = 0;
 
-    if (m_verbose)
-	emit Message(tr("Loading %1 bytes.").arg(data.size()));
-
-    emit Progress(0, data.size());
-    QByteArray prop_txt("> Prop_Txt 0 0 0 0");
-    if (m_verbose)
-	emit Message(tr("Sending Prop_Txt header '%1'.")
-		     .arg(QString::fromLatin1(prop_txt)));
-
-    if (m_dev->write(prop_txt) != prop_txt.size()) {
-	emit Error(tr("Failed to send prop_txt '%1' %2 bytes")
-		   .arg(QString::fromLatin1(prop_txt))
-		   .arg(prop_txt.size()));
-	return false;
-    }
-
+    stream += hex ? QByteArray("> Prop_Hex 0 0 0 0")
+		  : QByteArray("> Prop_Txt 0 0 0 0");
     for (int offs = 0; offs < data.size(); offs += chunksize) {
 	QByteArray block = data.mid(offs, chunksize);
 	if (block.size() & 3) {
@@ -169,67 +108,58 @@ bool PropLoad::load_single_data_txt(const QByteArray& data, bool patch_mode)
 	    util.put_le32(block, 0x1c, m_user_baud);
 	}
 
-	// If checksumming is enabled, add the block to the checksum
 	if (m_use_checksum)
 	    checksum += compute_checksum(block);
-
-	// Send the block as hex bytes
-	QByteArray buffer = QByteArray("> ") + block.toBase64(opts);
-	if (m_verbose)
-	    emit Message(tr("Send %1 bytes block @0x%2 '%3'")
-			 .arg(block.size())
-			 .arg(offs, 4, 16, QChar('0'))
-			 .arg(QString::fromLatin1(buffer)));
-
-	if (m_dev->write(buffer) != buffer.length()) {
-	    emit Error(tr("Failed to send data block at offset 0x%1, %2 bytes")
-		       .arg(offs, 4, 16, QChar('0'))
-		       .arg(block.size()));
-	    return false;
-	}
-
-	// Wait for the block to be written
-#if WAIT_FOR_BYTES_WRITTEN > 0
-	// FIXME: do we need this?
-	if (!m_dev->waitForBytesWritten(30000)) {
-	    emit Error(tr("Failed to transfer %1 bytes block.")
-		       .arg(buffer.size()));
-	    return false;
-	}
-#endif
-	emit Progress(offs, data.size());
-	totnum += block.size();
+	stream += QByteArray("> ") + (hex ? block.toHex(' ') : block.toBase64(opts));
     }
 
     if (m_use_checksum) {
-	checksum = Prop - checksum;
 	QByteArray checksum_data(4, 0);
-	util.put_le32(checksum_data, 0, checksum);
-	QByteArray buffer = QByteArray(" ") + checksum_data.toBase64(opts) + QByteArray("?");
+	util.put_le32(checksum_data, 0, Prop - checksum);
+	stream += QByteArray(" ") + (hex ? checksum_data.toHex(' ') : checksum_data.toBase64(opts)) + QByteArray("?");
+    } else {
+	stream += QByteArray("~");
+    }
+    return stream;
+}
 
+/**
+ * @brief Send data which was encoded by @ref encode
+ * @param stream const reference to the encoded lines
+ * @param size size of the data for the progress
+ * @return true on success, or false on error
+ */
+bool PropLoad::load_encoded(const QList<QByteArray>& stream, qint64 size)
+{
+    const int count = stream.count();
+    emit Progress(0, size);
+    for (int i = 0; i < count; i++) {
+	const QByteArray& buffer = stream[i];
 	if (m_verbose)
-	    emit Message(tr("Send checksum '%1'.")
+	    emit Message(tr("Send line %1 of %2 '%3'")
+			 .arg(i + 1)
+			 .arg(count)
 			 .arg(QString::fromLatin1(buffer)));
-
 	if (m_dev->write(buffer) != buffer.length()) {
-	    emit Error(tr("Failed to send checksum at 0x%1 (%2) bytes")
-		       .arg(checksum, 8, 16, QChar('0'))
-		       .arg(checksum_data.size()));
+	    emit Error(tr("Failed to send line %1 of %2, %3 bytes")
+		       .arg(i + 1)
+		       .arg(count)
+		       .arg(buffer.size()));
 	    return false;
 	}
-
-	// Wait until the checksum is written
-#if WAIT_FOR_BYTES_WRITTEN > 0
-	// FIXME: do we need this?
-	if (!m_dev->waitForBytesWritten(30000)) {
+	// the base64 lines are sent without waiting for each
+	const bool wait = WAIT_FOR_BYTES_WRITTEN > 0 || Prop_Txt != m_mode;
+	if (wait && !m_dev->waitForBytesWritten(30000)) {
 	    emit Error(tr("Failed to transfer %1 bytes block.")
 		       .arg(buffer.size()));
 	    return false;
 	}
-#endif
+	emit Progress(size * (i + 1) / count, size);
+    }
 
-	buffer.clear();
+    if (m_use_checksum) {
 	// Now wait for a reply from the Prop
+	QByteArray buffer;
 	if (m_dev->waitForReadyRead(1000)) {
 	    // and read 1 byte
 	    buffer = m_dev->read(1);
@@ -237,167 +167,82 @@ bool PropLoad::load_single_data_txt(const QByteArray& data, bool patch_mode)
 
 	if (buffer.length() != 1 || buffer[0] != '.') {
 	    QString message = tr("Failed to transfer %1 bytes of data.")
-			      .arg(data.size());
+			      .arg(size);
 	    message += QChar::LineFeed + tr("Error response was '%1'")
 		       .arg(QString::fromLatin1(buffer));
 	    emit Error(message);
 	    return false;
 	}
-	if (m_verbose)
-	    emit Message(tr("Checksum 0x%1 validated.")
-			 .arg(checksum, 8, 16, QChar('0')));
-
-    } else {
-	// No checksum mode: write a tilde (~)
-
-	QByteArray buffer("~");
-	if (m_dev->write(buffer) != buffer.length()) {
-	    emit Error(tr("Failed to send skip '%1' (%2) bytes")
-		       .arg(QString::fromLatin1(buffer))
-		       .arg(buffer.size()));
-	    return false;
-	}
     }
-    emit Progress(data.size(), data.size());
+    emit Progress(size, size);
 
     emit Message(tr("%1 bytes of data loaded.")
-		 .arg(data.size()));
+		 .arg(size));
 
     return true;
 }
 
-/**
- * @brief Upload a single file using hexadecimal encoding
- * @param data const reference to the data block to send
- * @param patch_mode if true, patch in the clock frequence, mode, and user baud
- * @return true on success, or false on error
- */
-bool PropLoad::load_single_data_hex(const QByteArray& data, bool patch_mode)
+void PropLoad::set_verbose(bool on)
 {
-    int totnum = 0;
-    quint32 checksum = 0;
-
-    if (m_verbose)
-	emit Message(tr("Loading %1 bytes.")
-		     .arg(data.size()));
-
-    emit Progress(0, data.size());
-    QByteArray prop_hex("> Prop_Hex 0 0 0 0");
-    if (m_verbose)
-	emit Message(tr("Sending Prop_Hex header '%1'.").arg(QString::fromLatin1(prop_hex)));
-
-    if (m_dev->write(prop_hex) != prop_hex.size()) {
-	emit Error(tr("Failed to send prop_hex '%1' %2 bytes")
-		   .arg(QString::fromLatin1(prop_hex))
-		   .arg(prop_hex.size()));
-	return false;
-    }
-
-    for (int offs = 0; offs < data.size(); offs += chunksize) {
-	QByteArray block = data.mid(offs, chunksize);
-	if (block.size() & 3) {
-	    // pad block to multiples of 32 bit with zeroes
-	    block.append(4 - (block.size() & 3), 0);
-	}
-
-	// If patch_mode is enabled, patch the first block
-	if (patch_mode) {
-	    patch_mode = false;
-	    util.put_le32(block, 0x14, m_clock_freq);
-	    util.put_le32(block, 0x18, m_clock_mode);
-	    util.put_le32(block, 0x1c, m_user_baud);
-	}
-
-	// If checksumming is enabled, add the block to the checksum
-	if (m_use_checksum)
-	    checksum += compute_checksum(block);
-
-	// Send the block as hex bytes
-	QByteArray buffer = QByteArray("> ") + block.toHex(' ');
-	if (m_verbose)
-	    emit Message(tr("Send %1 bytes block @0x%2 '%3'")
-			 .arg(block.size())
-			 .arg(offs, 4, 16, QChar('0'))
-			 .arg(QString::fromLatin1(buffer)));
-
-	if (m_dev->write(buffer) != buffer.length()) {
-	    emit Error(tr("Failed to send data block at offset 0x%1, %2 bytes")
-		       .arg(offs, 4, 16, QChar('0'))
-		       .arg(block.size()));
-	    return false;
-	}
+    m_verbose = on;
+}
 
-	// Wait for the block to be written
-	if (!m_dev->waitForBytesWritten(30000)) {
-	    emit Error(tr("Failed to transfer %1 bytes block.")
-		       .arg(buffer.size()));
-	    return false;
-	}
-	emit Progress(offs, data.size());
-	totnum += block.size();
-    }
+void PropLoad::set_mode(PropLoad::PropLoadMode mode)
+{
+    m_mode = mode;
+}
 
-    if (m_use_checksum) {
-	checksum = Prop - checksum;
-	QByteArray checksum_data(4, 0);
-	util.put_le32(checksum_data, 0, checksum);
-	QByteArray buffer = QByteArray(" ") + checksum_data.toHex(' ') + QByteArray("?");
+void PropLoad::set_clock_freq(quint32 clock_freq)
+{
+    m_clock_freq = clock_freq;
+}
 
-	if (m_verbose)
-	    emit Message(tr("Send checksum '%1'.")
-			 .arg(QString::fromLatin1(buffer)));
+void PropLoad::set_clock_mode(quint32 clock_mode)
+{
+    m_clock_mode = clock_mode;
+}
 
-	if (m_dev->write(buffer) != buffer.length()) {
-	    emit Error(tr("Failed to send checksum at 0x%1 (%2) bytes")
-		       .arg(checksum, 8, 16, QChar('0'))
-		       .arg(checksum_data.size()));
-	    return false;
-	}
+void PropLoad::set_user_baud(quint32 user_baud)
+{
+    m_user_baud = user_baud;
+}
 
-	// Wait until the checksum is written
-	if (!m_dev->waitForBytesWritten(30000)) {
-	    emit Error(tr("Failed to transfer %1 bytes block.")
-		       .arg(buffer.size()));
-	    return false;
-	}
+void PropLoad::set_use_checksum(bool use_checksum)
+{
+    m_use_checksum = use_checksum;
+}
 
-	// Now wait for a reply from the Prop
-	buffer.clear();
-	if (m_dev->waitForReadyRead(1000)) {
-	    // and read 1 byte
-	    buffer = m_dev->read(1);
-	}
+/**
+ * @brief Compute a checksum of unsigned 32 bit little endian values in @p data
+ * @param data const reference to the byte array to checksum
+ * @return sum of 32 bit little endian values in @p data
+ */
+quint32 PropLoad::compute_checksum(const QByteArray& data) const
+{
+    quint32 checksum = 0;
+    for (int offs = 0; offs < data.size(); offs += sizeof(quint32))
+	checksum += util.get_le32(data, offs);
+    return checksum;
+}
 
-	if (buffer.length() != 1 || buffer[0] != '.') {
-	    QString message = tr("Failed to transfer %1 bytes of data.")
-			      .arg(data.size());
-	    message += QChar::LineFeed + tr("Error response was '%1'")
-		       .arg(QString::fromLatin1(buffer));
-	    emit Error(message);
-	    return false;
-	}
+/**
+ * @brief Upload a single data block in the current mode
+ * @param data const reference to the data block to send
+ * @param patch_mode if true, patch in the clock frequence, mode, and user baud
+ * @return true on success, or false on error
+ */
+bool PropLoad::load_single_data(const QByteArray& data, bool patch_mode)
+{
+    switch (m_mode) {
+    case Prop_Hex:
+    case Prop_Txt:
 	if (m_verbose)
-	    emit Message(tr("Checksum 0x%1 validated.")
-			 .arg(checksum, 8, 16, QChar('0')));
-
-    } else {
-	// No checksum mode: write a tilde (~)
-
-	QByteArray buffer("~");
-	if (m_dev->write(buffer) != buffer.length()) {
-	    emit Error(tr("Failed to send skip '%1' (%2) bytes")
-		       .arg(QString::fromLatin1(buffer))
-		       .arg(buffer.size()));
-	    return false;
-	}
+	    emit Message(tr("Loading %1 bytes.").arg(data.size()));
+	return load_encoded(encode(data, patch_mode), data.size());
     }
-    emit Progress(data.size(), data.size());
-
-    if (m_verbose)
-	emit Message(tr("%1 bytes of data loaded.")
-		     .arg(data.size()));
-
-    return true;
+    emit Error(tr("Invalid PropMode (%2).")
+	       .arg(m_mode));
+    return false;
 }
 
 /**
@@ -422,15 +267,7 @@ bool PropLoad::load_single_file(const QString& filename, bool patch_mode)
 			 .arg(filename)
 			 .arg(data.size()));
 	file.close();
-	switch (m_mode) {
-	case Prop_Hex:
-	    return load_single_data_hex(data, patch_mode);
-	case Prop_Txt:
-	    return load_single_data_txt(data, patch_mode);
-	}
-	emit Error(tr("Invalid PropMode (%2).")
-		   .arg(m_mode));
-	return false;
+	return load_single_data(data, patch_mode);
     }
 
     emit Error(tr("Could not open '%1' for reading.")
@@ -10,6 +10,7 @@
 #pragma once
 #include <QObject>
 #include <QByteArray>
+#include <QList>
 #include <QIODevice>
 
 class PropLoad : public QObject
@@ -33,6 +34,9 @@ public:
     bool load_data(const QByteArray& data, bool patch_mode = false);
     bool load_file(const QString& filename, bool patch_mode = false);
 
+    QList<QByteArray> encode(const QByteArray& data, bool patch_mode = false) const;
+    bool load_encoded(const QList<QByteArray>& stream, qint64 size);
+
 public slots:
     void set_verbose(bool on = true);
     void set_mode(PropLoadMode mode);
@@ -63,8 +67,7 @@ private:
 
     bool m_use_checksum;    //!< if true, calculate and verify the checksum
 
-    quint32 compute_checksum(const QByteArray& data);
-    bool load_single_data_txt(const QByteArray& data, bool patch_mode = false);
-    bool load_single_data_hex(const QByteArray& data, bool patch_mode = false);
+    quint32 compute_checksum(const QByteArray& data) const;
+    bool load_single_data(const QByteArray& data, bool patch_mode = false);
     bool load_single_file(const QString& filename, bool patch_mode = false);
 };
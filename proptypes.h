@@ -12,6 +12,9 @@
 
 /**
  * @brief Enumeration of baud rates also beyond the default maximum of 115200
+ *
+ * These are the presets offered in the serial port dialog. Any other rate
+ * up to @ref Serial_BaudMax can be entered and is stored as an integer.
  */
 typedef enum {
     Serial_Baud1200 = QSerialPort::Baud1200,
@@ -23,5 +26,21 @@ typedef enum {
     Serial_Baud115200 = QSerialPort::Baud115200,
     Serial_Baud230400 = 2*QSerialPort::Baud115200,
     Serial_Baud921600 = 8*QSerialPort::Baud115200,
-    Serial_Baud2000000 = 2000000
+    Serial_Baud2000000 = 2000000,
+    Serial_Baud3000000 = 3000000,
+    Serial_Baud4000000 = 4000000,
+    Serial_BaudMax = 20000000		//!< upper limit for custom baud rates
 }   Serial_BaudRate;
+
+/**
+ * @brief Enumeration of what to do when the serial read buffer is full
+ *
+ * The read buffer of the serial port is limited to a budget. When the
+ * backlog reaches it, QSerialPort stops reading from the driver, and the
+ * application is behind with displaying the received data.
+ */
+typedef enum {
+    Overflow_Throttle,		//!< keep the backlog in the driver, which throttles the sender with RTS/CTS
+    Overflow_CaptureOnly,	//!< write the backlog to the capture only and don't display it
+    Overflow_Discard		//!< discard the backlog and count it
+}   Overflow_Policy;
@@ -7,6 +7,7 @@
  * See the file LICENSE for the details of the BSD-3-Clause terms.
  *
  *****************************************************************************/
+#include <QApplication>
 #include <QFile>
 #include <QFileDialog>
 #include <QTemporaryFile>
@@ -15,6 +16,8 @@
 #include <QSerialPort>
 #include <QSerialPortInfo>
 #include <QSettings>
+#include <QDateTime>
+#include <QRegularExpression>
 #include <QCryptographicHash>
 #include <QScrollArea>
 #include <QSplitter>
@@ -24,21 +27,30 @@
 #include <QProgressBar>
 #include <QTextBrowser>
 #include <QHBoxLayout>
+#include <QInputDialog>
 #include <QVBoxLayout>
 #include <cinttypes>
 #include <fcntl.h>
 #include "util.h"
 #include "idstrings.h"
+#include "buildqueue.h"
+#include "capture.h"
+#include "depgraph.h"
 #include "propedit.h"
 #include "qflexprop.h"
 #include "propload.h"
 #include "aboutdlg.h"
+#include "fleetdlg.h"
+#include "latencyprobe.h"
+#include "replaydlg.h"
 #include "ui_qflexprop.h"
 #include "serterm.h"
 #include "flexspindlg.h"
 #include "serialportdlg.h"
+#include "serialtune.h"
 #include "settingsdlg.h"
 #include "textbrowserdlg.h"
+#include "mappedview.h"
 
 QFlexProp::QFlexProp(QWidget *parent)
     : QMainWindow(parent)
@@ -80,11 +92,15 @@ QFlexProp::QFlexProp(QWidget *parent)
     , m_stty_operation()
     , m_port_name()
     , m_baud_rate(Serial_Baud230400)
+    , m_baud_actual(0)
+    , m_low_latency(false)
     , m_data_bits(QSerialPort::Data8)
     , m_parity(QSerialPort::NoParity)
     , m_stop_bits(QSerialPort::OneStop)
     , m_flow_control(QSerialPort::NoFlowControl)
     , m_local_echo(false)
+    , m_read_buffer_kib(0)
+    , m_overflow_policy(Overflow_Throttle)
     , m_flexspin_executable()
     , m_flexspin_include_paths()
     , m_flexspin_quiet(true)
@@ -96,6 +112,26 @@ QFlexProp::QFlexProp(QWidget *parent)
     , m_flexspin_skip_coginit(false)
     , m_compile_verbose_upload(false)
     , m_compile_switch_to_term(true)
+    , m_build_queue(new BuildQueue(this))
+    , m_build_jobs()
+    , m_depgraph(new DepGraph(this))
+    , m_compile_background(false)
+    , m_bg_timer(new QTimer(this))
+    , m_bg_process(nullptr)
+    , m_bg_propedit()
+    , m_bg_dir()
+    , m_artefact_dir()
+    , m_capture(new Capture(this))
+    , m_capture_timer(new QTimer(this))
+    , m_probe(new LatencyProbe(this))
+    , m_read_buffer_timer(new QTimer(this))
+    , m_overflow(false)
+    , m_overflow_events(0)
+    , m_overflow_bytes(0)
+    , m_backlog_peak(0)
+    , m_triggers()
+    , m_triggers_enabled(false)
+    , m_checking_disk(false)
 {
     ui->setupUi(this);
 
@@ -302,6 +338,27 @@ void QFlexProp::setup_signals()
 	    this, &QFlexProp::tab_changed);
     connect(ui->tabWidget, &QTabWidget::tabCloseRequested,
 	    this, &QFlexProp::tab_close_requested);
+    connect(m_build_queue, &BuildQueue::job_started,
+	    this, &QFlexProp::build_job_started);
+    connect(m_build_queue, &BuildQueue::job_finished,
+	    this, &QFlexProp::build_job_finished);
+    connect(m_build_queue, &BuildQueue::all_finished,
+	    this, &QFlexProp::build_all_finished);
+    connect(m_depgraph, &DepGraph::invalidated,
+	    this, &QFlexProp::dependency_changed);
+    m_bg_timer->setSingleShot(true);
+    connect(m_bg_timer, &QTimer::timeout,
+	    this, &QFlexProp::background_compile);
+    connect(m_capture, &Capture::failed,
+	    this, &QFlexProp::capture_failed);
+    connect(m_capture_timer, &QTimer::timeout,
+	    this, &QFlexProp::capture_update);
+    connect(m_read_buffer_timer, &QTimer::timeout,
+	    this, &QFlexProp::read_buffer_update);
+    connect(m_probe, &LatencyProbe::progress,
+	    this, &QFlexProp::showProgress);
+    connect(m_probe, &LatencyProbe::finished,
+	    this, &QFlexProp::latency_probe_finished);
 }
 
 /**
@@ -312,10 +369,34 @@ void QFlexProp::dev_ready_read()
 
     qint64 available = m_dev->bytesAvailable();
     if (available > 0) {
+	const bool overflow = read_overflow(available);
 	QByteArray data = m_dev->read(available);
 	DBG_DATA("%s: recv %d bytes\n%s", __func__, data.length(),
 		 qPrintable(util.dump(__func__, data)));
-	ui->terminal->write(data);
+	if (overflow && Overflow_Discard == m_overflow_policy)
+	    return;
+	m_capture->append(data);
+	if (overflow) {
+	    // catch up by not displaying the backlog
+	    return;
+	}
+	if (m_probe->running()) {
+	    // the probe's data is not for the terminal
+	    m_probe->received(data);
+	    return;
+	}
+	const QVector<Triggers::Match> matches = m_triggers_enabled ? m_triggers.scan(data)
+								    : QVector<Triggers::Match>();
+	int pos = 0;
+	foreach(const Triggers::Match& match, matches) {
+	    // write the data up to the end of the match before acting on it
+	    if (match.end > pos)
+		ui->terminal->write(data.constData() + pos, static_cast<size_t>(match.end - pos));
+	    pos = qMax(pos, match.end);
+	    trigger_fired(match);
+	}
+	if (pos < data.size())
+	    ui->terminal->write(data.constData() + pos, static_cast<size_t>(data.size() - pos));
 	update_pinout(true);
     }
 }
@@ -329,6 +410,8 @@ void QFlexProp::dev_close()
     Q_ASSERT(st != nullptr);
     if (m_dev) {
 	qDebug("%s: deleting m_dev", __func__);
+	st->cancel_transfers();
+	m_probe->cancel();
 	m_dev->close();
 	m_dev->deleteLater();
 	m_dev = nullptr;
@@ -342,6 +425,10 @@ void QFlexProp::dev_close()
  */
 void QFlexProp::dev_write_data(const QByteArray& data)
 {
+    if (m_probe->running()) {
+	// drop keys and responses of the terminal to probe data
+	return;
+    }
     Q_ASSERT(m_dev);
     DBG_DATA("%s: xmit %d bytes\n%s", __func__, data.length(), qPrintable(util.dump(__func__, data)));
     m_dev->write(data);
@@ -405,12 +492,14 @@ void QFlexProp::load_settings()
     s.beginGroup(id_grp_serialport);
     m_port_name = s.value(id_port_name, QLatin1String("ttyUSB0")).toString();
     s.beginGroup(m_port_name);
-    m_baud_rate = static_cast<Serial_BaudRate>(s.value(id_baud_rate, Serial_Baud230400).toInt());
+    m_baud_rate = s.value(id_baud_rate, Serial_Baud230400).toInt();
     m_data_bits = static_cast<QSerialPort::DataBits>(s.value(id_data_bits, m_data_bits).toInt());
     m_parity = static_cast<QSerialPort::Parity>(s.value(id_parity, m_parity).toInt());
     m_stop_bits = static_cast<QSerialPort::StopBits>(s.value(id_stop_bits, m_stop_bits).toInt());
     m_flow_control = static_cast<QSerialPort::FlowControl>(s.value(id_flow_control, m_flow_control).toInt());
     m_local_echo = s.value(id_local_echo, false).toBool();
+    m_read_buffer_kib = s.value(id_read_buffer_size, 0).toInt();
+    m_overflow_policy = static_cast<Overflow_Policy>(s.value(id_overflow_policy, Overflow_Throttle).toInt());
     s.endGroup();
 
     s.beginGroup(id_grp_enabled);
@@ -444,10 +533,15 @@ void QFlexProp::load_settings()
     m_flexspin_skip_coginit = s.value(id_flexspin_skip_coginit, false).toBool();
     m_compile_verbose_upload = s.value(id_compile_verbose_upload, false).toBool();
     m_compile_switch_to_term = s.value(id_compile_switch_to_term, true).toBool();
+    m_compile_background = s.value(id_compile_background, false).toBool();
     s.endGroup();
+    m_depgraph->set_include_paths(m_flexspin_include_paths);
 
     ui->action_Verbose_upload->setChecked(m_compile_verbose_upload);
     ui->action_Switch_to_term->setChecked(m_compile_switch_to_term);
+    ui->action_Compile_in_background->setChecked(m_compile_background);
+
+    load_triggers();
 
     if (geometry.isEmpty()) {
         // First run: adjust the size of the main window
@@ -483,6 +577,8 @@ void QFlexProp::save_settings()
     s.setValue(id_stop_bits, m_stop_bits);
     s.setValue(id_flow_control, m_flow_control);
     s.setValue(id_local_echo, m_local_echo);
+    s.setValue(id_read_buffer_size, m_read_buffer_kib);
+    s.setValue(id_overflow_policy, m_overflow_policy);
     s.endGroup();
     s.beginGroup(id_grp_enabled);
     foreach(const QString& id, m_enabled_elements.keys()) {
@@ -505,9 +601,90 @@ void QFlexProp::save_settings()
     s.setValue(id_flexspin_skip_coginit, m_flexspin_skip_coginit);
     s.setValue(id_compile_verbose_upload, m_compile_verbose_upload);
     s.setValue(id_compile_switch_to_term, m_compile_switch_to_term);
+    s.setValue(id_compile_background, m_compile_background);
+    s.endGroup();
+
+    s.beginGroup(id_grp_triggers);
+    s.setValue(id_triggers_enabled, m_triggers_enabled);
     s.endGroup();
 }
 
+/**
+ * @brief Load the triggers on the received data
+ * The triggers are an array in the settings, which is edited in the
+ * settings file. If there is none, a few examples are written.
+ */
+void QFlexProp::load_triggers()
+{
+    QSettings s;
+    s.beginGroup(id_grp_triggers);
+    m_triggers_enabled = s.value(id_triggers_enabled, false).toBool();
+    m_triggers.clear();
+    const int size = s.beginReadArray(id_trigger);
+    for (int i = 0; i < size; i++) {
+	s.setArrayIndex(i);
+	Triggers::Trigger t;
+	t.name = s.value(id_trigger_name).toString();
+	t.pattern = s.value(id_trigger_pattern).toString();
+	t.regex = s.value(id_trigger_regex, false).toBool();
+	t.actions = Triggers::actions(s.value(id_trigger_actions).toStringList());
+	t.response = s.value(id_trigger_response).toString();
+	if (!m_triggers.add(t))
+	    log_error(m_triggers.error_string());
+    }
+    s.endArray();
+
+    if (0 == size) {
+	const Triggers::Trigger examples[] = {
+	    {QLatin1String("version"), QLatin1String("Prop_Ver"), false,
+	     Triggers::Act_Log, QString()},
+	    {QLatin1String("pass"), QLatin1String("PASS"), false,
+	     Triggers::Act_Highlight | Triggers::Act_Log, QString()},
+	    {QLatin1String("fail"), QLatin1String("FAIL"), false,
+	     Triggers::Act_Highlight | Triggers::Act_Bell | Triggers::Act_Log, QString()},
+	    {QLatin1String("panic"), QLatin1String("\\bpanic\\b.*"), true,
+	     Triggers::Act_Highlight | Triggers::Act_Bell | Triggers::Act_Log, QString()},
+	};
+	s.beginWriteArray(id_trigger);
+	for (size_t i = 0; i < sizeof(examples)/sizeof(examples[0]); i++) {
+	    const Triggers::Trigger& t = examples[i];
+	    s.setArrayIndex(static_cast<int>(i));
+	    s.setValue(id_trigger_name, t.name);
+	    s.setValue(id_trigger_pattern, t.pattern);
+	    s.setValue(id_trigger_regex, t.regex);
+	    s.setValue(id_trigger_actions, Triggers::action_names(t.actions));
+	    s.setValue(id_trigger_response, t.response);
+	    m_triggers.add(t);
+	}
+	s.endArray();
+    }
+    s.endGroup();
+    ui->action_Triggers->setChecked(m_triggers_enabled);
+}
+
+/**
+ * @brief Run the actions of a trigger which matched the received data
+ * @param match const reference to the Triggers::Match
+ */
+void QFlexProp::trigger_fired(const Triggers::Match& match)
+{
+    const Triggers::Trigger& t = m_triggers.trigger(match.trigger);
+    if (t.actions & Triggers::Act_Highlight) {
+	SerTerm* st = ui->tabWidget->findChild<SerTerm*>(id_terminal);
+	Q_ASSERT(st != nullptr);
+	st->vterm()->highlight(match.cells, match.skip);
+    }
+    if (t.actions & Triggers::Act_Bell) {
+	QApplication::beep();
+    }
+    if (t.actions & Triggers::Act_Log) {
+	log_message(tr("Trigger %1: %2").arg(t.name).arg(match.text));
+    }
+    if ((t.actions & Triggers::Act_Respond) && m_dev) {
+	dev_write_data(t.response.toUtf8());
+    }
+}
+
 /**
  * @brief Update the statusbar items and LEDs for the current signal states
  * @param redo if true, redo this update after 25 milliseconds
@@ -578,7 +755,7 @@ void QFlexProp::update_pinout(bool redo)
 void QFlexProp::tab_changed(int index)
 {
     Q_UNUSED(index)
-    const PropEdit* pe = current_propedit(index);
+    PropEdit* pe = current_propedit(index);
     const bool enable = pe != nullptr;
     const bool has_listing = pe && !pe->property(id_tab_lst).isNull();
     const bool has_intermediate = pe && !pe->property(id_tab_p2asm).isNull();
@@ -590,15 +767,69 @@ void QFlexProp::tab_changed(int index)
 
     ui->action_Verbose_upload->setEnabled(enable);
     ui->action_Switch_to_term->setEnabled(enable);
+    ui->action_Compile_in_background->setEnabled(enable);
     ui->action_Build->setEnabled(enable);
     ui->action_Upload->setEnabled(enable);
     ui->action_Run->setEnabled(enable);
+    if (enable && m_compile_background)
+	m_bg_timer->start(bg_compile_delay);
     if (index == ui->tabWidget->count() - 1) {
 	// Make sure that instead of the tab the terminal has the focus
 	ui->terminal->setFocus();
     }
 }
 
+/**
+ * @brief Check for changes on disk when the window is activated
+ * The check is deferred so that the prompt doesn't open while the
+ * window is still being activated.
+ * @param event pointer to the QEvent
+ */
+void QFlexProp::changeEvent(QEvent* event)
+{
+    QMainWindow::changeEvent(event);
+    if (QEvent::ActivationChange == event->type() && isActiveWindow())
+	QTimer::singleShot(0, this, SLOT(check_changed_on_disk()));
+}
+
+/**
+ * @brief Ask whether to reload the sources which were modified outside of the editor
+ * If a source also has unsaved changes in the editor, reloading would
+ * lose them, so the user is warned and the default is to keep them.
+ * Declined changes are not asked for again until the file changes again.
+ */
+void QFlexProp::check_changed_on_disk()
+{
+    if (m_checking_disk)
+	return;
+    m_checking_disk = true;
+    for (int index = 0; index < ui->tabWidget->count(); index++) {
+	PropEdit* pe = current_propedit(index);
+	if (!pe || !pe->changed_on_disk())
+	    continue;
+	ui->tabWidget->setCurrentIndex(index);
+	int res;
+	if (pe->changed()) {
+	    res = QMessageBox::warning(this,
+				       tr("File '%1' changed on disk!").arg(pe->filename()),
+				       tr("The file '%1' was modified outside of the editor, and it has unsaved changes in the editor. Do you want to reload it and lose these changes?").arg(pe->filename()),
+				       QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+	} else {
+	    res = QMessageBox::question(this,
+					tr("File '%1' changed on disk!").arg(pe->filename()),
+					tr("The file '%1' was modified outside of the editor. Do you want to reload it?").arg(pe->filename()),
+					QMessageBox::Yes, QMessageBox::No);
+	}
+	if (res == QMessageBox::Yes) {
+	    pe->load();
+	    update_tab_title(index);
+	} else {
+	    pe->changed_on_disk(true);
+	}
+    }
+    m_checking_disk = false;
+}
+
 void QFlexProp::tab_close_requested(int index)
 {
     PropEdit* pe = current_propedit(index);
@@ -688,6 +919,8 @@ void QFlexProp::update_baud_rate()
 	QLocale locale = QLocale::system();
 	QSerialPort::Directions directions = stty->AllDirections;
 	qint32 baud_rate = stty->baudRate(directions);
+	if (stty->isOpen() && m_baud_actual > 0)
+	    baud_rate = m_baud_actual;
 	QLabel* lbl_baud = m_labels[id_baud_rate];
 	QString baud = locale.toString(baud_rate);
 	QString dir = direction_str.value(directions);
@@ -695,6 +928,14 @@ void QFlexProp::update_baud_rate()
 	// FIXME: does it make a difference to check for changed text?
 	if (str != lbl_baud->text())
 	    lbl_baud->setText(str);
+	QString tooltip = tr("Currently selected baud rate (bits per second).");
+	if (baud_rate != m_baud_rate)
+	    tooltip += QLatin1Char('\n') + tr("Requested %1, the adapter achieved %2.")
+		       .arg(locale.toString(m_baud_rate))
+		       .arg(baud);
+	if (m_low_latency)
+	    tooltip += QLatin1Char('\n') + tr("Driver is in low latency mode.");
+	lbl_baud->setToolTip(tooltip);
     }
 }
 
@@ -890,6 +1131,24 @@ void QFlexProp::setup_statusbar()
     lbl_flow->setToolTip(tr("Type of flow control."));
     ui->statusbar->addPermanentWidget(lbl_flow);
 
+    delete m_labels.value(id_capture);
+    QLabel* lbl_capture = new QLabel;
+    m_labels.insert(id_capture, lbl_capture);
+    lbl_capture->setObjectName(id_capture);
+    lbl_capture->setFrameShape(shape);
+    lbl_capture->setFrameShadow(shadow);
+    lbl_capture->setVisible(false);
+    ui->statusbar->addPermanentWidget(lbl_capture);
+
+    delete m_labels.value(id_read_buffer);
+    QLabel* lbl_read_buffer = new QLabel;
+    m_labels.insert(id_read_buffer, lbl_read_buffer);
+    lbl_read_buffer->setObjectName(id_read_buffer);
+    lbl_read_buffer->setFrameShape(shape);
+    lbl_read_buffer->setFrameShadow(shadow);
+    lbl_read_buffer->setVisible(false);
+    ui->statusbar->addPermanentWidget(lbl_read_buffer);
+
     foreach(const QString& key, m_leds) {
 	delete m_labels.value(key);
 	QLabel* lbl = new QLabel;
@@ -1012,6 +1271,8 @@ void QFlexProp::setup_port()
 void QFlexProp::configure_port()
 {
     setup_port();
+    // matches do not continue across reopening the device
+    m_triggers.reset();
 
     QSerialPort* stty = qobject_cast<QSerialPort*>(m_dev);
     if (stty) {
@@ -1032,8 +1293,19 @@ void QFlexProp::configure_port()
 	m_stty_operation = tr("setFlowControl(%1)").arg(flow_control_str.value(m_flow_control));
 	stty->setFlowControl(m_flow_control);
 
+	m_stty_operation = tr("setReadBufferSize(%1)").arg(m_read_buffer_kib * 1024);
+	stty->setReadBufferSize(static_cast<qint64>(m_read_buffer_kib) * 1024);
+
 	m_stty_operation = tr("open(%1)").arg(QLatin1String("QIODevice::ReadWrite"));
 	if (stty->open(QIODevice::ReadWrite)) {
+	    tune_port(stty);
+
+	    if (m_read_buffer_kib > 0 && Overflow_Throttle == m_overflow_policy &&
+		m_flow_control != QSerialPort::HardwareControl) {
+		log_message(tr("Without RTS/CTS the data the driver of %1 can't hold while the read buffer is full is lost.")
+			    .arg(m_port_name));
+	    }
+
 	    m_stty_operation = tr("setDataTerminalReady(%1)").arg("true");
 	    stty->setDataTerminalReady(true);
 
@@ -1086,17 +1358,77 @@ void QFlexProp::configure_port()
     } while (0);
 #endif
 
+    m_overflow = false;
+    m_overflow_events = 0;
+    m_overflow_bytes = 0;
+    m_backlog_peak = 0;
+    QLabel* lbl_read_buffer = m_labels.value(id_read_buffer);
+    if (lbl_read_buffer)
+	lbl_read_buffer->setVisible(m_read_buffer_kib > 0);
+    if (m_read_buffer_kib > 0) {
+	read_buffer_update();
+	m_read_buffer_timer->start(1000);
+    } else {
+	m_read_buffer_timer->stop();
+    }
+
     setup_mainwindow();
     update_parity_data_stop();
     update_pinout();
 }
 
+/**
+ * @brief Set the exact baud rate and low latency mode of an open serial port
+ *
+ * QSerialPort maps the rate to the closest standard rate on some systems.
+ * On Linux the rate is set again with termios2, which accepts any value,
+ * and the rate the driver achieved is read back for the statusbar.
+ * @param stty pointer to the open QSerialPort
+ */
+void QFlexProp::tune_port(QSerialPort* stty)
+{
+    const int fd = static_cast<int>(stty->handle());
+    m_baud_actual = m_baud_rate;
+    m_low_latency = false;
+#if defined(Q_OS_LINUX)
+    m_stty_operation = tr("set_baud_rate(%1)").arg(m_baud_rate);
+    const qint32 actual = SerialTune::set_baud_rate(fd, m_baud_rate);
+    if (actual < 0) {
+	log_error(tr("Could not set baud rate %1 for %2: %3")
+		  .arg(m_baud_rate)
+		  .arg(m_port_name)
+		  .arg(strerror(errno)));
+    } else {
+	m_baud_actual = actual;
+    }
+
+    m_stty_operation = tr("set_low_latency(%1)").arg("true");
+    m_low_latency = SerialTune::set_low_latency(fd);
+
+    const int latency = SerialTune::latency_timer(m_port_name);
+    if (latency > SerialTune::ftdi_latency_ms &&
+	!SerialTune::set_latency_timer(m_port_name, SerialTune::ftdi_latency_ms)) {
+	log_message(tr("Latency timer of %1 is %2ms. Grant write access to lower it.")
+		    .arg(m_port_name)
+		    .arg(latency));
+    }
+#else
+    Q_UNUSED(fd)
+#endif
+    update_baud_rate();
+}
+
 /**
  * @brief Close the serial port
  */
 void QFlexProp::close_port()
 {
-    disconnect(m_dev);
+    SerTerm* st = ui->tabWidget->findChild<SerTerm*>(id_terminal);
+    Q_ASSERT(st != nullptr);
+    st->cancel_transfers();
+    m_probe->cancel();
+    // only drop our own connections
+    disconnect(m_dev, nullptr, this, nullptr);
     m_dev->close();
     setup_mainwindow();
     update_pinout();
@@ -1160,20 +1492,73 @@ int QFlexProp::insert_tab(const QString& filename)
 	    log_message(tr("Loaded file '%1' (%2 Bytes).")
 			.arg(info.fileName())
 			.arg(locale.toString(info.size())));
+	    // watch the source and its dependencies from now on
+	    m_depgraph->closure(info.absoluteFilePath());
 	    ui->tabWidget->setCurrentIndex(tabidx);
 	} else {
 	    log_message(tr("Could not load file '%1'.")
 			.arg(info.fileName()));
 	}
     }
-    QString title = QString("%1 [%2]")
-                    .arg(info.fileName())
-                    .arg(pe->filetype_name());
-    ui->tabWidget->setTabText(tabidx, title);
+    update_tab_title(tabidx);
+
+    connect(pe, &PropEdit::textChanged,
+	    this, &QFlexProp::background_edit);
+    connect(pe, &PropEdit::modificationChanged,
+	    this, &QFlexProp::modification_changed);
 
     return tabidx;
 }
 
+/**
+ * @brief Return the index of the tab containing the PropEdit @p pe
+ * @param pe pointer to the PropEdit
+ * @return zero based tab index, or -1 if not found
+ */
+int QFlexProp::tab_index(const PropEdit* pe) const
+{
+    for (int index = 0; index < ui->tabWidget->count(); index++) {
+	QWidget *wdg = ui->tabWidget->widget(index);
+	if (wdg && wdg->isAncestorOf(pe))
+	    return index;
+    }
+    return -1;
+}
+
+/**
+ * @brief Slot called when the modified state of a PropEdit's document changed
+ * @param changed true if modified
+ */
+void QFlexProp::modification_changed(bool changed)
+{
+    Q_UNUSED(changed)
+    PropEdit* pe = qobject_cast<PropEdit*>(sender());
+    if (!pe)
+	return;
+    update_tab_title(tab_index(pe));
+}
+
+/**
+ * @brief Update the title of a tab with its file name, type and an optional status
+ * @param index zero based tab index
+ * @param status optional status text (e.g. build state)
+ */
+void QFlexProp::update_tab_title(int index, const QString& status)
+{
+    const PropEdit* pe = current_propedit(index);
+    if (!pe)
+	return;
+    QFileInfo info(pe->filename());
+    QString title = QString("%1 [%2]")
+		    .arg(info.fileName())
+		    .arg(pe->filetype_name());
+    if (pe->changed())
+	title = QString("*%1").arg(title);
+    if (!status.isEmpty())
+	title = QString("%1 (%2)").arg(title).arg(status);
+    ui->tabWidget->setTabText(index, title);
+}
+
 /**
  * @brief File -> New action
  */
@@ -1226,6 +1611,8 @@ void QFlexProp::on_action_Save_triggered()
 	log_message(tr("Saved file '%1' (%2 Bytes).")
 		    .arg(info.absoluteFilePath())
 		    .arg(locale.toString(info.size())));
+	if (m_compile_background)
+	    m_bg_timer->start(0);
     } else {
 	log_message(tr("Could not save file '%1'.")
 		    .arg(info.absoluteFilePath()));
@@ -1422,6 +1809,47 @@ void QFlexProp::on_action_Goto_line_triggered()
     le->setFocus();
 }
 
+/**
+ * @brief Edit -> Goto hub address action
+ * Maps a hub address, e.g. one printed by the running program on the
+ * terminal, back to the source line which generated the code or data.
+ * The current tab is searched first, then the others.
+ */
+void QFlexProp::on_action_Goto_address_triggered()
+{
+    bool ok;
+    QString text = QInputDialog::getText(this, tr("Goto hub address"),
+					 tr("Hub address (hex):"), QLineEdit::Normal,
+					 QString(), &ok).trimmed();
+    if (!ok || text.isEmpty())
+	return;
+    if (text.startsWith(QChar('$')))
+	text.remove(0, 1);
+    else if (text.startsWith(QLatin1String("0x"), Qt::CaseInsensitive))
+	text.remove(0, 2);
+    const quint32 addr = text.toUInt(&ok, 16);
+    if (!ok) {
+	log_error(tr("Invalid hub address '%1'.").arg(text));
+	return;
+    }
+
+    const int count = ui->tabWidget->count();
+    const int current = ui->tabWidget->currentIndex();
+    for (int i = 0; i < count; i++) {
+	const int index = (current + i) % count;
+	PropEdit* pe = current_propedit(index);
+	if (!pe)
+	    continue;
+	const int lnum = pe->listing_index().line(addr);
+	if (lnum < 1)
+	    continue;
+	ui->tabWidget->setCurrentIndex(index);
+	pe->gotoLineNumber(lnum);
+	return;
+    }
+    log_status(tr("No source line for hub address $%1.").arg(addr, 5, 16, QChar('0')));
+}
+
 /**
  * @brief Preferences -> Settings action
  */
@@ -1460,6 +1888,8 @@ void QFlexProp::on_action_Configure_serialport_triggered()
     settings.stop_bits = m_stop_bits;
     settings.flow_control = m_flow_control;
     settings.local_echo = m_local_echo;
+    settings.read_buffer_kib = m_read_buffer_kib;
+    settings.overflow_policy = m_overflow_policy;
     dlg.set_settings(settings);
 
     if (QDialog::Accepted != dlg.exec())
@@ -1477,6 +1907,8 @@ void QFlexProp::on_action_Configure_serialport_triggered()
     m_stop_bits = settings.stop_bits;
     m_flow_control = settings.flow_control;
     m_local_echo = settings.local_echo;
+    m_read_buffer_kib = settings.read_buffer_kib;
+    m_overflow_policy = settings.overflow_policy;
     if (was_open) {
 	configure_port();
     } else {
@@ -1516,6 +1948,7 @@ void QFlexProp::on_action_Configure_flexspin_triggered()
     m_flexspin_errors = f.errors;
     m_flexspin_hub_address = f.hub_address;
     m_flexspin_skip_coginit = f.skip_coginit;
+    m_depgraph->set_include_paths(m_flexspin_include_paths);
 
     QSettings s;
     s.beginGroup(id_grp_flexspin);
@@ -1539,9 +1972,13 @@ void QFlexProp::on_action_Show_listing_triggered()
     PropEdit* pe = current_propedit();
     if (!pe)
 	return;
-    QString text = pe->property(id_tab_lst).toString();
     TextBrowserDlg dlg(this);
-    dlg.set_text(text);
+    if (!dlg.set_file(pe->property(id_tab_lst).toString()))
+	return;
+    // jump to the listing row of the current (or next) source line
+    const ListingIndex::Entry* e = pe->listing_index().next(pe->current_line());
+    if (e)
+	dlg.set_current_row(e->row);
     dlg.exec();
 }
 
@@ -1550,9 +1987,9 @@ void QFlexProp::on_action_Show_intermediate_triggered()
     PropEdit* pe = current_propedit();
     if (!pe)
 	return;
-    QString text = pe->property(id_tab_p2asm).toString();
     TextBrowserDlg dlg(this);
-    dlg.set_text(text);
+    if (!dlg.set_file(pe->property(id_tab_p2asm).toString()))
+	return;
     dlg.exec();
 }
 
@@ -1564,10 +2001,18 @@ void QFlexProp::on_action_Show_binary_triggered()
     PropEdit* pe = current_propedit();
     if (!pe)
 	return;
-    QByteArray data = pe->property(id_tab_binary).toByteArray();
-    QString dump = util.dump(QString(), data);
+    const QByteArray data = pe->property(id_tab_binary).toByteArray();
     TextBrowserDlg dlg(this);
-    dlg.set_text(dump);
+    dlg.set_binary(data);
+    // jump to the bytes of the current (or next) source line; the binary
+    // starts at the hub address it was compiled for
+    const ListingIndex::Entry* e = pe->listing_index().next(pe->current_line());
+    if (e && e->addr >= m_flexspin_hub_address) {
+	const quint32 offset = e->addr - m_flexspin_hub_address;
+	if (offset < static_cast<quint32>(data.size()))
+	    dlg.set_current_row(static_cast<int>(offset / MappedView::bytes_per_row));
+    }
+    // the view scrolls to the row when it is shown
     dlg.exec();
 }
 
@@ -1595,6 +2040,147 @@ void QFlexProp::on_action_Switch_to_term_triggered()
     m_compile_switch_to_term = ui->action_Switch_to_term->isChecked();
 }
 
+/**
+ * @brief Compile -> Compile in background action
+ */
+void QFlexProp::on_action_Compile_in_background_triggered()
+{
+    m_compile_background = ui->action_Compile_in_background->isChecked();
+    if (m_compile_background) {
+	m_bg_timer->start(bg_compile_delay);
+	return;
+    }
+    m_bg_timer->stop();
+    background_cancel();
+    for (int index = 0; index < ui->tabWidget->count(); index++) {
+	PropEdit* pe = current_propedit(index);
+	if (pe)
+	    pe->set_markers();
+    }
+}
+
+/**
+ * @brief Slot called when the text of a PropEdit changed
+ * Restarts the debounce timer and cancels a running background compile,
+ * because its result would be stale.
+ */
+void QFlexProp::background_edit()
+{
+    if (!m_compile_background)
+	return;
+    background_cancel();
+    m_bg_timer->start(bg_compile_delay);
+}
+
+/**
+ * @brief Kill a running background compile process
+ */
+void QFlexProp::background_cancel()
+{
+    if (!m_bg_process)
+	return;
+    m_bg_process->disconnect(this);
+    m_bg_process->kill();
+    m_bg_process->waitForFinished(100);
+    m_bg_process->deleteLater();
+    m_bg_process = nullptr;
+}
+
+/**
+ * @brief Compile the current buffer of the selected tab in the background
+ *
+ * The text is written to a scratch directory, so the source file and the
+ * results of a regular build are not touched. The directory of the source
+ * is added to the include paths to resolve OBJ and #include references.
+ */
+void QFlexProp::background_compile()
+{
+    PropEdit* pe = current_propedit();
+    if (!pe || !m_bg_dir.isValid())
+	return;
+    if (m_build_queue->busy()) {
+	// try again later
+	m_bg_timer->start(bg_compile_delay);
+	return;
+    }
+    background_cancel();
+
+    const QFileInfo info(pe->filename());
+    const QString scratch = m_bg_dir.filePath(info.fileName());
+    QFile file(scratch);
+    if (!file.open(QIODevice::WriteOnly))
+	return;
+    file.write(pe->text().toUtf8());
+    file.close();
+
+    QStringList args = flexspin_args(scratch);
+    args.insert(args.count() - 1, QString("-I %1").arg(quoted(info.absolutePath())));
+
+    m_bg_propedit = pe;
+    m_bg_process = new QProcess(this);
+    m_bg_process->setProgram(m_flexspin_executable);
+#if defined(Q_OS_WIN)
+    // Windows really sucks: not even argument passing to a process works as elsewhere
+    m_bg_process->setNativeArguments(args.join(QChar::Space));
+#else
+    m_bg_process->setArguments(args);
+#endif
+    m_bg_process->setWorkingDirectory(m_bg_dir.path());
+    m_bg_process->setProcessChannelMode(QProcess::MergedChannels);
+    connect(m_bg_process, QOverload<int,QProcess::ExitStatus>::of(&QProcess::finished),
+	    this, &QFlexProp::background_finished);
+    m_bg_process->start();
+}
+
+/**
+ * @brief Slot called when the background compile process finished
+ * Parses the diagnostics into the PropEdit's markers.
+ * @param exit_code flexspin exit code
+ * @param status exit status
+ */
+void QFlexProp::background_finished(int exit_code, QProcess::ExitStatus status)
+{
+    Q_UNUSED(exit_code)
+    QProcess* process = qobject_cast<QProcess*>(sender());
+    if (!process || process != m_bg_process)
+	return;
+    m_bg_process = nullptr;
+    process->deleteLater();
+
+    PropEdit* pe = m_bg_propedit;
+    if (!pe || QProcess::NormalExit != status)
+	return;
+
+    pe->set_markers(flexspin_diagnostics(pe, QString::fromUtf8(process->readAll())));
+}
+
+/**
+ * @brief Parse the "file:line: error: ..." and "file:line: warning: ..." diagnostics of flexspin
+ * @param pe pointer to the PropEdit whose source was compiled
+ * @param output flexspin output
+ * @return QVector of markers for lines of the PropEdit's file
+ */
+QVector<PropEdit::Marker> QFlexProp::flexspin_diagnostics(const PropEdit* pe, const QString& output) const
+{
+    static const QRegularExpression re(QStringLiteral("^(.+):(\\d+): (?:fatal )?(error|warning)"),
+				       QRegularExpression::CaseInsensitiveOption);
+    const QString basename = QFileInfo(pe->filename()).fileName();
+    QVector<PropEdit::Marker> markers;
+    foreach(const QString& line, output.split(QChar('\n'))) {
+	QRegularExpressionMatch match = re.match(line);
+	if (!match.hasMatch())
+	    continue;
+	if (QFileInfo(match.captured(1)).fileName() != basename)
+	    continue;
+	PropEdit::Marker m;
+	m.line = match.captured(2).toInt();
+	m.severity = match.captured(3).compare(QLatin1String("error"), Qt::CaseInsensitive)
+		     ? PropEdit::SEV_WARNING : PropEdit::SEV_ERROR;
+	markers += m;
+    }
+    return markers;
+}
+
 /**
  * @brief Return a quoted string if @p src contains a space
  * @param src const reference to the source string
@@ -1609,23 +2195,12 @@ QString QFlexProp::quoted(const QString& src, const QChar quote)
 }
 
 /**
- * @brief Run flexspin with the configured switches and return the results
- * @param p_binary pointer to a QByteArray for the binary result
- * @param p_p2asm pointer to a QString for the p2asm output
- * @param p_lst pointer to a QString for the listing
- * @return true on success, or false on error
+ * @brief Return the list of flexspin arguments for compiling @p filename
+ * @param filename full path of the source file
+ * @return QStringList with the arguments
  */
-bool QFlexProp::flexspin(QByteArray* p_binary, QString* p_p2asm, QString* p_lst)
+QStringList QFlexProp::flexspin_args(const QString& filename) const
 {
-    QTextBrowser *tb = current_textbrowser();
-    Q_ASSERT(tb);
-    PropEdit *pe = current_propedit();
-    if (!pe)
-	return false;
-
-    tb->clear();
-
-    QFile src(pe->filename());
     QStringList args;
 
     // compile for Prop2
@@ -1665,7 +2240,123 @@ bool QFlexProp::flexspin(QByteArray* p_binary, QString* p_p2asm, QString* p_lst)
     }
 
     // add source filename
-    args += src.fileName();
+    args += filename;
+
+    return args;
+}
+
+/**
+ * @brief Move a text file produced by flexspin into the artefact directory
+ * The file is kept there until it is replaced by the next build, so the
+ * viewer can map it instead of loading it into a QString.
+ * @param pe pointer to the PropEdit whose source was compiled
+ * @param filename name of the file produced by flexspin
+ * @return name of the moved file, or an empty string if there is none
+ */
+QString QFlexProp::flexspin_artefact(PropEdit* pe, const QString& filename)
+{
+    if (!QFile::exists(filename))
+	return QString();
+    if (!m_artefact_dir.isValid()) {
+	// nowhere to keep it
+	QFile::remove(filename);
+	return QString();
+    }
+
+    // prefix with the PropEdit's address to keep tabs with equal file names apart
+    const QString artefact = m_artefact_dir.filePath(QString("%1-%2")
+						     .arg(reinterpret_cast<quintptr>(pe), 0, 16)
+						     .arg(QFileInfo(filename).fileName()));
+    QFile::remove(artefact);
+    if (!QFile::rename(filename, artefact)) {
+	QFile::remove(filename);
+	return QString();
+    }
+    return artefact;
+}
+
+/**
+ * @brief Collect the files produced by flexspin for the source of @p pe
+ * @param pe pointer to the PropEdit whose source was compiled
+ * @param p_binary pointer to a QByteArray for the binary result
+ * @param p_p2asm pointer to a QString for the p2asm output
+ * @param p_lst pointer to a QString for the listing
+ */
+void QFlexProp::flexspin_results(PropEdit* pe, QByteArray* p_binary, QString* p_p2asm, QString* p_lst)
+{
+    QFileInfo info(pe->filename());
+
+    // check and move listing file
+    QString lst_filename = QString("%1/%2.lst")
+			     .arg(info.absoluteDir().path())
+			     .arg(info.baseName());
+    lst_filename = flexspin_artefact(pe, lst_filename);
+    ListingIndex index;
+    if (!lst_filename.isEmpty()) {
+	pe->setProperty(id_tab_lst, lst_filename);
+	index.load(lst_filename, pe->text());
+	if (p_lst) {
+	    // caller wants the listing
+	    QFile lst(lst_filename);
+	    if (lst.open(QIODevice::ReadOnly))
+		*p_lst = QString::fromUtf8(lst.readAll());
+	}
+    }
+    pe->set_listing_index(index);
+
+    // check and move intermediate p2asm file
+    QString p2asm_filename = QString("%1/%2.p2asm")
+			     .arg(info.absoluteDir().path())
+			     .arg(info.baseName());
+    p2asm_filename = flexspin_artefact(pe, p2asm_filename);
+    if (!p2asm_filename.isEmpty()) {
+	pe->setProperty(id_tab_p2asm, p2asm_filename);
+	if (p_p2asm) {
+	    // caller wants the output
+	    QFile p2asm(p2asm_filename);
+	    if (p2asm.open(QIODevice::ReadOnly))
+		*p_p2asm = QString::fromUtf8(p2asm.readAll());
+	}
+    }
+
+    // check, load, and remove resulting binary file
+    QString binary_filename = QString("%1/%2.binary")
+				.arg(info.absoluteDir().path())
+				.arg(info.baseName());
+    QFile binfile(binary_filename);
+    if (binfile.exists()) {
+	if (binfile.open(QIODevice::ReadOnly)) {
+	    QByteArray binary = binfile.readAll();
+	    pe->setProperty(id_tab_binary, binary);
+	    if (p_binary) {
+		// caller wants the binary
+		*p_binary = binary;
+	    }
+	    binfile.close();
+	}
+	binfile.remove();
+    }
+}
+
+/**
+ * @brief Run flexspin with the configured switches and return the results
+ * @param p_binary pointer to a QByteArray for the binary result
+ * @param p_p2asm pointer to a QString for the p2asm output
+ * @param p_lst pointer to a QString for the listing
+ * @return true on success, or false on error
+ */
+bool QFlexProp::flexspin(QByteArray* p_binary, QString* p_p2asm, QString* p_lst)
+{
+    QTextBrowser *tb = current_textbrowser();
+    Q_ASSERT(tb);
+    PropEdit *pe = current_propedit();
+    if (!pe)
+	return false;
+
+    tb->clear();
+    update_tab_title(ui->tabWidget->currentIndex());
+
+    QStringList args = flexspin_args(pe->filename());
 
     // print the command to be executed
     tb->setTextColor(Qt::blue);
@@ -1686,6 +2377,7 @@ bool QFlexProp::flexspin(QByteArray* p_binary, QString* p_p2asm, QString* p_lst)
 	    this, &QFlexProp::channelReadyRead);
 
     // run the command
+    pe->setProperty(id_tab_built, QDateTime::currentMSecsSinceEpoch());
     process.start();
     if (QProcess::Starting == process.state()) {
 	if (!process.waitForStarted()) {
@@ -1706,73 +2398,187 @@ bool QFlexProp::flexspin(QByteArray* p_binary, QString* p_p2asm, QString* p_lst)
 	}
     } while (QProcess::Running == process.state());
 
-    QFileInfo info(src.fileName());
+    if (QProcess::NormalExit != process.exitStatus() || 0 != process.exitCode()) {
+	// force a rebuild next time
+	pe->setProperty(id_tab_built, QVariant());
+    } else {
+	// watch the source and its dependencies to mark the tab stale
+	m_depgraph->closure(pe->filename());
+    }
+    flexspin_results(pe, p_binary, p_p2asm, p_lst);
 
-    // check, load, and remove listing file
-    QString lst_filename = QString("%1/%2.lst")
-			     .arg(info.absoluteDir().path())
-			     .arg(info.baseName());
-    QFile lst(lst_filename);
-    if (lst.exists()) {
-	if (lst.open(QIODevice::ReadOnly)) {
-	    QString listing = QString::fromUtf8(lst.readAll());
-	    pe->setProperty(id_tab_lst, listing);
-	    if (p_lst) {
-		// caller wants the listing
-		*p_lst = listing;
-	    }
-	    lst.close();
-	}
-	lst.remove();
+    tab_changed(ui->tabWidget->currentIndex());
+
+    return true;
+}
+
+/**
+ * @brief Compile -> Build action
+ */
+void QFlexProp::on_action_Build_triggered()
+{
+    flexspin();
+}
+
+/**
+ * @brief Compile -> Build all action
+ *
+ * Every tab with a PropEdit that was modified, that has no binary yet,
+ * or where the source or one of its OBJ / #include dependencies changed
+ * since the last build, is saved and compiled. The flexspin processes run concurrently through
+ * the BuildQueue, which is limited to QThread::idealThreadCount() jobs.
+ */
+void QFlexProp::on_action_Build_all_triggered()
+{
+    if (m_build_queue->busy()) {
+	log_status(tr("Build all is already running."));
+	return;
     }
 
-    // check, load, and remove intermediate p2asm file
-    QString p2asm_filename = QString("%1/%2.p2asm")
-			     .arg(info.absoluteDir().path())
-			     .arg(info.baseName());
-    QFile p2asm(p2asm_filename);
-    if (p2asm.exists()) {
-	if (p2asm.open(QIODevice::ReadOnly)) {
-	    QString output = QString::fromUtf8(p2asm.readAll());
-	    pe->setProperty(id_tab_p2asm, output);
-	    if (p_p2asm) {
-		// caller wants the output
-		*p_p2asm = output;
-	    }
-	    p2asm.close();
+    m_build_jobs.clear();
+    for (int index = 0; index < ui->tabWidget->count(); index++) {
+	PropEdit* pe = current_propedit(index);
+	if (!pe)
+	    continue;
+	const bool dirty = pe->changed();
+	const QVariant built = pe->property(id_tab_built);
+	if (!dirty && !pe->property(id_tab_binary).isNull() &&
+	    !m_depgraph->stale(pe->filename(), built.isValid() ? built.toLongLong() : -1))
+	    continue;
+	if (dirty && !pe->save(pe->filename())) {
+	    log_error(tr("Could not save file '%1'.").arg(pe->filename()));
+	    continue;
 	}
-	p2asm.remove();
-    }
 
-    // check, load, and remove resulting binary file
-    QString binary_filename = QString("%1/%2.binary")
-				.arg(info.absoluteDir().path())
-				.arg(info.baseName());
-    QFile binfile(binary_filename);
-    if (binfile.exists()) {
-	if (binfile.open(QIODevice::ReadOnly)) {
-	    QByteArray binary = binfile.readAll();
-	    pe->setProperty(id_tab_binary, binary);
-	    if (p_binary) {
-		// caller wants the binary
-		*p_binary = binary;
-	    }
-	    binfile.close();
+	QTextBrowser* tb = current_textbrowser(index);
+	QStringList args = flexspin_args(pe->filename());
+	if (tb) {
+	    tb->clear();
+	    tb->setTextColor(Qt::blue);
+	    tb->append(QString("%1 %2")
+		       .arg(m_flexspin_executable)
+		       .arg(args.join(QStringLiteral(" \\\n\t"))));
 	}
-	binfile.remove();
+
+	const QFileInfo info(pe->filename());
+	const int id = m_build_queue->enqueue(m_flexspin_executable, args,
+					      info.absoluteDir().path());
+	m_build_jobs.insert(id, pe);
+	update_tab_title(index, tr("queued"));
     }
 
-    tab_changed(ui->tabWidget->currentIndex());
+    if (m_build_jobs.isEmpty()) {
+	log_status(tr("Build all: nothing to do."));
+	return;
+    }
 
-    return true;
+    ui->action_Build_all->setEnabled(false);
+    log_status(tr("Build all: %1 job(s), up to %2 in parallel.")
+	       .arg(m_build_jobs.count())
+	       .arg(m_build_queue->max_jobs()));
+    m_build_queue->start();
 }
 
 /**
- * @brief Compile -> Build action
+ * @brief Slot called when the BuildQueue started a job
+ * @param id job identifier
  */
-void QFlexProp::on_action_Build_triggered()
+void QFlexProp::build_job_started(int id)
 {
-    flexspin();
+    PropEdit* pe = m_build_jobs.value(id);
+    if (!pe)
+	return;
+    pe->setProperty(id_tab_built, QDateTime::currentMSecsSinceEpoch());
+    update_tab_title(tab_index(pe), tr("building"));
+}
+
+/**
+ * @brief Slot called when the BuildQueue finished a job
+ * @param id job identifier
+ * @param ok true if flexspin succeeded
+ * @param exit_code exit code of flexspin
+ * @param output text flexspin printed to stdout
+ * @param errors text flexspin printed to stderr
+ */
+void QFlexProp::build_job_finished(int id, bool ok, int exit_code, const QString& output, const QString& errors)
+{
+    PropEdit* pe = m_build_jobs.value(id);
+    if (!pe) {
+	// tab was closed while the job was running
+	return;
+    }
+
+    const int index = tab_index(pe);
+    QTextBrowser* tb = current_textbrowser(index);
+    if (tb) {
+	if (!output.isEmpty()) {
+	    tb->setTextColor(Qt::black);
+	    tb->append(output);
+	}
+	if (!errors.isEmpty()) {
+	    tb->setTextColor(Qt::red);
+	    tb->append(errors);
+	}
+	if (!ok) {
+	    tb->setTextColor(Qt::red);
+	    tb->append(tr("Result code %1.").arg(exit_code));
+	}
+    }
+
+    flexspin_results(pe);
+    pe->set_markers(flexspin_diagnostics(pe, QString("%1\n%2").arg(output).arg(errors)));
+    update_tab_title(index, ok ? tr("ok") : tr("failed"));
+    if (!ok) {
+	// force a rebuild next time
+	pe->setProperty(id_tab_built, QVariant());
+	const QFileInfo info(pe->filename());
+	log_error(tr("Build of '%1' failed: %2")
+		  .arg(info.fileName())
+		  .arg(errors.trimmed().section(QChar('\n'), 0, 0)));
+    } else {
+	m_depgraph->closure(pe->filename());
+    }
+    if (index == ui->tabWidget->currentIndex())
+	tab_changed(index);
+}
+
+/**
+ * @brief Slot called when the BuildQueue has no more pending or running jobs
+ * @param succeeded number of successful jobs
+ * @param failed number of failed jobs
+ */
+void QFlexProp::build_all_finished(int succeeded, int failed)
+{
+    QLocale locale = QLocale::system();
+    m_build_jobs.clear();
+    ui->action_Build_all->setEnabled(true);
+    const QString message = tr("Build all: %1 succeeded, %2 failed in %3 ms.")
+			    .arg(succeeded)
+			    .arg(failed)
+			    .arg(locale.toString(m_build_queue->elapsed()));
+    if (failed > 0) {
+	log_error(message);
+    } else {
+	log_status(message);
+    }
+}
+
+/**
+ * @brief Slot called when a source, or a file it depends on, changed on disk
+ * @param filename absolute path of the affected source
+ */
+void QFlexProp::dependency_changed(const QString& filename)
+{
+    for (int index = 0; index < ui->tabWidget->count(); index++) {
+	PropEdit* pe = current_propedit(index);
+	if (!pe || pe->property(id_tab_built).isNull())
+	    continue;
+	if (QFileInfo(pe->filename()).absoluteFilePath() != filename)
+	    continue;
+	if (m_build_jobs.values().contains(pe))
+	    continue;
+	update_tab_title(index, tr("stale"));
+    }
 }
 
 /**
@@ -1846,6 +2652,296 @@ void QFlexProp::on_action_Run_triggered()
     }
 }
 
+/**
+ * @brief Compile -> Fleet upload action
+ * Compiles the current tab and opens the fleet upload dialog with the
+ * binary. The port used by the terminal is left out of the fleet.
+ */
+void QFlexProp::on_action_Fleet_upload_triggered()
+{
+    PropEdit* pe = current_propedit();
+    if (!pe)
+	return;
+
+    QByteArray binary;
+    if (!flexspin(&binary))
+	return;
+    if (binary.isEmpty())
+	return;
+
+    FleetDlg dlg(this);
+    dlg.set_binary(binary, pe->filename());
+    dlg.set_port(m_baud_rate, m_data_bits, m_parity, m_stop_bits);
+    dlg.set_exclude(m_port_name);
+    dlg.exec();
+}
+
+/**
+ * @brief Terminal -> Capture to disk action
+ * Asks for the base name of the capture files when capturing is started.
+ * The segment size in MiB and block compression of finished segments
+ * are read from the capture settings.
+ */
+void QFlexProp::on_action_Capture_triggered()
+{
+    QLabel* lbl_capture = m_labels.value(id_capture);
+    if (!ui->action_Capture->isChecked()) {
+	m_capture->stop();
+	m_capture_timer->stop();
+	capture_update();
+	log_status(tr("Stopped capture to %1.").arg(m_capture->basename()));
+	if (lbl_capture)
+	    lbl_capture->setVisible(false);
+	return;
+    }
+
+    QSettings s;
+    s.beginGroup(id_grp_capture);
+    const QString dflt = QString("%1/capture-%2")
+			 .arg(QDir::homePath())
+			 .arg(QDateTime::currentDateTime().toString(QLatin1String("yyyyMMdd-hhmmss")));
+    const QString path = s.value(id_capture_path, QDir::homePath()).toString();
+    const qint64 segment_size = s.value(id_capture_segment_size,
+					Capture::default_segment_size / 1024 / 1024).toLongLong() * 1024 * 1024;
+    const bool compress = s.value(id_capture_compress, false).toBool();
+
+    QFileDialog dlg(this);
+    dlg.setWindowTitle(tr("Capture to disk"));
+    dlg.setAcceptMode(QFileDialog::AcceptSave);
+    dlg.setDirectory(path);
+    dlg.setFileMode(QFileDialog::AnyFile);
+    dlg.setOption(QFileDialog::DontUseNativeDialog, true);
+    dlg.setViewMode(QFileDialog::Detail);
+    dlg.selectFile(QFileInfo(dflt).fileName());
+    if (QFileDialog::Accepted != dlg.exec() || dlg.selectedFiles().isEmpty()) {
+	ui->action_Capture->setChecked(false);
+	return;
+    }
+    const QString basename = dlg.selectedFiles().first();
+    s.setValue(id_capture_path, QFileInfo(basename).dir().absolutePath());
+    s.setValue(id_capture_segment_size, segment_size / 1024 / 1024);
+    s.setValue(id_capture_compress, compress);
+    s.endGroup();
+
+    if (!m_capture->start(basename, segment_size, compress)) {
+	ui->action_Capture->setChecked(false);
+	return;
+    }
+    log_status(tr("Capturing to %1.").arg(Capture::segment_name(basename, 0)));
+    if (lbl_capture)
+	lbl_capture->setVisible(true);
+    capture_update();
+    m_capture_timer->start(1000);
+}
+
+/**
+ * @brief Update the capture counters in the statusbar
+ */
+void QFlexProp::capture_update()
+{
+    QLabel* lbl_capture = m_labels.value(id_capture);
+    if (!lbl_capture)
+	return;
+    QLocale locale = QLocale::system();
+    const quint64 written = m_capture->bytes_written();
+    const quint64 dropped = m_capture->bytes_dropped();
+    QString str = tr("REC %1").arg(locale.formattedDataSize(static_cast<qint64>(written)));
+    if (dropped > 0)
+	str += tr(" (%1 dropped)").arg(locale.formattedDataSize(static_cast<qint64>(dropped)));
+    if (str != lbl_capture->text())
+	lbl_capture->setText(str);
+    lbl_capture->setToolTip(tr("Capturing to %1.\n%2 bytes written, %3 bytes dropped in %4 segment(s).")
+			    .arg(m_capture->basename())
+			    .arg(locale.toString(written))
+			    .arg(locale.toString(dropped))
+			    .arg(m_capture->segments()));
+}
+
+/**
+ * @brief Update the read buffer counters in the statusbar
+ */
+void QFlexProp::read_buffer_update()
+{
+    QLabel* lbl_read_buffer = m_labels.value(id_read_buffer);
+    if (!lbl_read_buffer)
+	return;
+    QLocale locale = QLocale::system();
+    const qint64 budget = static_cast<qint64>(m_read_buffer_kib) * 1024;
+    const qint64 backlog = m_dev && m_dev->isOpen() ? m_dev->bytesAvailable() : 0;
+    QString str = tr("BUF %1").arg(locale.formattedDataSize(m_backlog_peak));
+    if (m_overflow_events > 0)
+	str += tr(" (%1x full)").arg(m_overflow_events);
+    if (str != lbl_read_buffer->text())
+	lbl_read_buffer->setText(str);
+    lbl_read_buffer->setToolTip(tr("Read buffer of %1, policy when full: %2.\n"
+				   "Backlog %3 bytes now, %4 bytes at most.\n"
+				   "Full %5 time(s), %6 bytes captured only or discarded.")
+				.arg(locale.formattedDataSize(budget))
+				.arg(tr(overflow_policy_str.value(m_overflow_policy)))
+				.arg(locale.toString(backlog))
+				.arg(locale.toString(m_backlog_peak))
+				.arg(locale.toString(m_overflow_events))
+				.arg(locale.toString(m_overflow_bytes)));
+}
+
+/**
+ * @brief Check the backlog of the serial port against the read buffer budget
+ *
+ * When the backlog reaches the budget, QSerialPort has stopped reading
+ * from the driver, and the data is not displayed until the backlog is
+ * below a quarter of the budget again. With @ref Overflow_Throttle
+ * the data is always displayed and only the events are counted.
+ * Data is never left out while the latency probe or a transfer runs.
+ * When the backlog was caught up, the terminal's decoder and the
+ * triggers start over, since the data left out may have ended in the
+ * middle of an escape sequence or a match.
+ * @param available number of bytes waiting in the read buffer
+ * @return true if the data is to be captured only or discarded
+ */
+bool QFlexProp::read_overflow(qint64 available)
+{
+    const qint64 budget = static_cast<qint64>(m_read_buffer_kib) * 1024;
+    if (available > m_backlog_peak)
+	m_backlog_peak = available;
+    if (budget <= 0)
+	return false;
+    if (!m_overflow && available >= budget) {
+	m_overflow = true;
+	m_overflow_events++;
+    } else if (m_overflow && available < budget / 4) {
+	m_overflow = false;
+	if (Overflow_Throttle != m_overflow_policy) {
+	    // the data left out may have ended inside a sequence or a match
+	    ui->terminal->reset_decoder();
+	    m_triggers.reset();
+	}
+    }
+    if (!m_overflow || Overflow_Throttle == m_overflow_policy)
+	return false;
+    if (m_probe->running() || ui->terminal->transfer_running()) {
+	// these wait for every byte
+	return false;
+    }
+    m_overflow_bytes += static_cast<quint64>(available);
+    return true;
+}
+
+/**
+ * @brief Report a capture error and uncheck the capture action
+ * @param message error message
+ */
+void QFlexProp::capture_failed(const QString& message)
+{
+    log_error(message);
+    ui->action_Capture->setChecked(false);
+    on_action_Capture_triggered();
+}
+
+/**
+ * @brief Terminal -> Triggers action
+ * Enables or disables matching the triggers against the received data.
+ */
+void QFlexProp::on_action_Triggers_triggered()
+{
+    m_triggers_enabled = ui->action_Triggers->isChecked();
+    m_triggers.reset();
+    log_status(m_triggers_enabled ? tr("Enabled %1 trigger(s).").arg(m_triggers.count())
+				  : tr("Disabled triggers."));
+}
+
+/**
+ * @brief Terminal -> Replay capture action
+ * The capture is replayed in the dialog's own terminal, so the live
+ * terminal keeps displaying the serial port meanwhile.
+ */
+void QFlexProp::on_action_Replay_triggered()
+{
+    SerTerm* st = ui->tabWidget->findChild<SerTerm*>(id_terminal);
+    Q_ASSERT(st != nullptr);
+    QSettings s;
+    s.beginGroup(id_grp_capture);
+    const QString path = s.value(id_capture_path, QDir::homePath()).toString();
+
+    QFileDialog dlg(this);
+    dlg.setWindowTitle(tr("Replay capture"));
+    dlg.setAcceptMode(QFileDialog::AcceptOpen);
+    dlg.setDirectory(path);
+    dlg.setFileMode(QFileDialog::ExistingFile);
+    dlg.setNameFilters({tr("Capture files (*.cap *.cap.z *.idx)"), tr("All files (*)")});
+    dlg.setOption(QFileDialog::DontUseNativeDialog, true);
+    dlg.setViewMode(QFileDialog::Detail);
+    if (QFileDialog::Accepted != dlg.exec() || dlg.selectedFiles().isEmpty())
+	return;
+    const QString filename = dlg.selectedFiles().first();
+    s.setValue(id_capture_path, QFileInfo(filename).dir().absolutePath());
+    s.endGroup();
+
+    ReplayDlg replay(st->vterm(), this);
+    if (replay.open(filename)) {
+	replay.exec();
+    } else {
+	log_error(replay.error_string());
+    }
+}
+
+/**
+ * @brief Terminal -> Latency probe action
+ * Starts measuring the round trip latency, the throughput and the jitter
+ * of the readyRead() deliveries against examples/latency_echo.spin2,
+ * which must be running on the P2. Triggering the action again while
+ * the probe is running cancels it.
+ */
+void QFlexProp::on_action_Latency_probe_triggered()
+{
+    if (m_probe->running()) {
+	m_probe->cancel();
+	return;
+    }
+    if (!m_dev || !m_dev->isOpen()) {
+	log_error(tr("The serial port is not open."));
+	return;
+    }
+    // discard what the terminal did not read yet
+    m_dev->readAll();
+    if (!m_probe->start(m_dev, m_baud_actual > 0 ? m_baud_actual : m_baud_rate)) {
+	log_error(m_probe->error_string());
+	return;
+    }
+    log_status(tr("Probing %1 with %2 bursts of %3 pings.")
+	       .arg(m_port_name)
+	       .arg(LatencyProbe::bursts)
+	       .arg(LatencyProbe::burst_size));
+}
+
+/**
+ * @brief Show the results of the latency probe
+ * @param ok true if all phases of the probe were completed
+ */
+void QFlexProp::latency_probe_finished(bool ok)
+{
+    if (!ok) {
+	log_error(m_probe->error_string());
+	return;
+    }
+    log_status(tr("Latency probe on %1 finished.").arg(m_port_name));
+
+    QStringList lines;
+    lines += tr("Port %1 at %2 baud, driver low latency mode %3.")
+	     .arg(m_port_name)
+	     .arg(m_baud_actual > 0 ? m_baud_actual : m_baud_rate)
+	     .arg(m_low_latency ? tr("on") : tr("off"));
+    const int latency = SerialTune::latency_timer(m_port_name);
+    if (latency >= 0)
+	lines += tr("FTDI latency timer %1 ms.").arg(latency);
+    lines += QString();
+    lines += m_probe->report();
+
+    TextBrowserDlg dlg(this);
+    dlg.setWindowTitle(tr("Latency probe"));
+    dlg.set_text(lines.join(QChar('\n')));
+    dlg.exec();
+}
+
 /**
  * @brief Help -> About action
  */
@@ -19,13 +19,20 @@
 #include <QFont>
 #include <QMutex>
 #include <QProcess>
+#include <QPointer>
+#include <QTemporaryDir>
 #include "proptypes.h"
+#include "propedit.h"
+#include "triggers.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class QFlexProp; }
 QT_END_NAMESPACE
 
-class PropEdit;
+class BuildQueue;
+class Capture;
+class DepGraph;
+class LatencyProbe;
 
 class QFlexProp : public QMainWindow
 {
@@ -35,6 +42,8 @@ public:
     QFlexProp(QWidget *parent = nullptr);
     ~QFlexProp();
 
+protected:
+    void changeEvent(QEvent* event) override;
 
 private slots:
     void log_message(const QString& message);
@@ -59,14 +68,18 @@ private slots:
     void update_pinout(bool redo = false);
     void tab_changed(int index);
     void tab_close_requested(int index);
+    void check_changed_on_disk();
 
     void load_settings();
     void save_settings();
+    void load_triggers();
+    void trigger_fired(const Triggers::Match& match);
     void setup_mainwindow();
     void setup_signals();
     void setup_statusbar();
     void setup_port();
     void configure_port();
+    void tune_port(QSerialPort* stty);
     void close_port();
 
     void on_action_New_triggered();
@@ -85,6 +98,7 @@ private slots:
     void on_action_Find_Replace_triggered();
     void line_number_finished();
     void on_action_Goto_line_triggered();
+    void on_action_Goto_address_triggered();
 
     void on_action_Settings_triggered();
     void on_action_Configure_serialport_triggered();
@@ -97,9 +111,21 @@ private slots:
 
     void on_action_Verbose_upload_triggered();
     void on_action_Switch_to_term_triggered();
+    void on_action_Compile_in_background_triggered();
     void on_action_Build_triggered();
+    void on_action_Build_all_triggered();
     void on_action_Upload_triggered();
     void on_action_Run_triggered();
+    void on_action_Fleet_upload_triggered();
+
+    void on_action_Capture_triggered();
+    void capture_update();
+    void capture_failed(const QString& message);
+    void read_buffer_update();
+    void on_action_Replay_triggered();
+    void on_action_Latency_probe_triggered();
+    void latency_probe_finished(bool ok);
+    void on_action_Triggers_triggered();
 
     void on_action_About_triggered();
     void on_action_About_Qt5_triggered();
@@ -110,7 +136,19 @@ private slots:
 
     void showProgress(qint64 value, qint64 total);
 
+    void build_job_started(int id);
+    void build_job_finished(int id, bool ok, int exit_code, const QString& output, const QString& errors);
+    void build_all_finished(int succeeded, int failed);
+    void dependency_changed(const QString& filename);
+    void modification_changed(bool changed);
+
+    void background_edit();
+    void background_cancel();
+    void background_compile();
+    void background_finished(int exit_code, QProcess::ExitStatus status);
+
 private:
+    static constexpr int bg_compile_delay = 750;	//!< debounce delay for background compile in ms
     Ui::QFlexProp *ui;
     QIODevice* m_dev;				//!< serial port (or tty)
     QFont m_fixedfont;
@@ -119,12 +157,16 @@ private:
     QHash<QString,QLabel*> m_labels;		//!< labels for LEDs
     QString m_stty_operation;			//!< serial port most recent operation
     QString m_port_name;			//!< serial port device name
-    Serial_BaudRate m_baud_rate;		//!< serial port baud rate
+    qint32 m_baud_rate;				//!< serial port baud rate
+    qint32 m_baud_actual;			//!< serial port baud rate achieved by the driver
+    bool m_low_latency;				//!< serial port driver is in low latency mode
     QSerialPort::DataBits m_data_bits;		//!< serial port data bits
     QSerialPort::Parity m_parity;		//!< serial port parity type
     QSerialPort::StopBits m_stop_bits;		//!< serial port stop bits
     QSerialPort::FlowControl m_flow_control;	//!< serial port flow control
     bool m_local_echo;				//!< Local echo flag
+    int m_read_buffer_kib;			//!< serial port read buffer budget in KiB, or 0 for unlimited
+    Overflow_Policy m_overflow_policy;		//!< what to do when the read buffer is full
 
     QString m_flexspin_executable;
     QStringList m_flexspin_include_paths;
@@ -137,13 +179,43 @@ private:
     bool m_flexspin_skip_coginit;
     bool m_compile_verbose_upload;
     bool m_compile_switch_to_term;
-
+    BuildQueue* m_build_queue;			//!< bounded scheduler for Build all
+    QHash<int,QPointer<PropEdit>> m_build_jobs;	//!< Build all job id to PropEdit
+    DepGraph* m_depgraph;			//!< OBJ and #include dependencies of the sources
+    bool m_compile_background;			//!< compile the current tab in the background after edits
+    QTimer* m_bg_timer;				//!< debounce timer for background compile
+    QProcess* m_bg_process;			//!< running background compile (or nullptr)
+    QPointer<PropEdit> m_bg_propedit;		//!< PropEdit being compiled in the background
+    QTemporaryDir m_bg_dir;			//!< scratch directory for background compile
+    QTemporaryDir m_artefact_dir;		//!< listings and p2asm files of the tabs
+    Capture* m_capture;				//!< capture of received data to disk
+    QTimer* m_capture_timer;			//!< updates the capture counters in the statusbar
+    LatencyProbe* m_probe;			//!< serial latency probe; owns the port while running
+    QTimer* m_read_buffer_timer;		//!< updates the read buffer counters in the statusbar
+    bool m_overflow;				//!< the read buffer was full and the backlog is not displayed
+    quint64 m_overflow_events;			//!< number of times the read buffer was full
+    quint64 m_overflow_bytes;			//!< bytes captured only or discarded
+    qint64 m_backlog_peak;			//!< largest backlog seen by dev_ready_read()
+    Triggers m_triggers;			//!< patterns matched against the received data
+    bool m_triggers_enabled;			//!< scan the received data for triggers
+    bool m_checking_disk;			//!< a "changed on disk" prompt is open
+
+    bool read_overflow(qint64 available);
     int insert_tab(const QString& filename);
+    int tab_index(const PropEdit* pe) const;
+    void update_tab_title(int index, const QString& status = QString());
     PropEdit* current_propedit(int index = -1) const;
     QTextBrowser* current_textbrowser(int index = -1) const;
     QString load_file(const QString& title);
     QString save_file(const QString& filename, const QString& title);
 
+    QStringList flexspin_args(const QString& filename) const;
+    QString flexspin_artefact(PropEdit* pe, const QString& filename);
+    QVector<PropEdit::Marker> flexspin_diagnostics(const PropEdit* pe, const QString& output) const;
+    void flexspin_results(PropEdit* pe,
+			  QByteArray* p_binary = nullptr,
+			  QString* p_p2asm = nullptr,
+			  QString* p_lst = nullptr);
     bool flexspin(QByteArray* p_binary = nullptr,
 		  QString* p_p2asm = nullptr,
 		  QString* p_lst = nullptr);
@@ -1,4 +1,4 @@
-QT      += core gui widgets serialport
+QT      += core gui widgets serialport concurrent
 CONFIG  += c++14
 VERSION_MAJOR = 0
 VERSION_MINOR = 2
@@ -15,14 +15,30 @@ DEFINES += VERSION_PATCH=$${VERSION_PATCH}
 
 SOURCES += \
     $$PWD/main.cpp \
+    $$PWD/blockxfer.cpp \
+    $$PWD/buildqueue.cpp \
+    $$PWD/capture.cpp \
+    $$PWD/capturefile.cpp \
+    $$PWD/depgraph.cpp \
+    $$PWD/fleetupload.cpp \
+    $$PWD/headless.cpp \
     $$PWD/propconst.cpp \
     $$PWD/idstrings.cpp \
+    $$PWD/latencyprobe.cpp \
+    $$PWD/listingindex.cpp \
     $$PWD/propload.cpp \
+    $$PWD/replay.cpp \
+    $$PWD/sendfile.cpp \
+    $$PWD/serialtune.cpp \
     $$PWD/serterm.cpp \
+    $$PWD/triggers.cpp \
     $$PWD/qflexprop.cpp \
     $$PWD/util.cpp \
+    $$PWD/widgets/mappedview.cpp \
     $$PWD/widgets/propedit.cpp \
+    $$PWD/dialogs/fleetdlg.cpp \
     $$PWD/dialogs/flexspindlg.cpp \
+    $$PWD/dialogs/replaydlg.cpp \
     $$PWD/dialogs/serialportdlg.cpp \
     $$PWD/term/vt220.cpp \
     $$PWD/term/vtattr.cpp \
@@ -30,22 +46,37 @@ SOURCES += \
     $$PWD/term/vtglyphidx.cpp \
     $$PWD/term/vtglyphs.cpp \
     $$PWD/term/vtline.cpp \
-    $$PWD/term/vtscrollarea.cpp \
     dialogs/aboutdlg.cpp \
     dialogs/settingsdlg.cpp \
     dialogs/textbrowserdlg.cpp \
     loadelf.cpp
 
 HEADERS += \
+    $$PWD/blockxfer.h \
+    $$PWD/buildqueue.h \
+    $$PWD/capture.h \
+    $$PWD/capturefile.h \
+    $$PWD/depgraph.h \
+    $$PWD/fleetupload.h \
+    $$PWD/headless.h \
     $$PWD/propconst.h \
     $$PWD/idstrings.h \
+    $$PWD/latencyprobe.h \
+    $$PWD/listingindex.h \
+    $$PWD/sendfile.h \
+    $$PWD/serialtune.h \
     $$PWD/serterm.h \
+    $$PWD/triggers.h \
     $$PWD/qflexprop.h \
     $$PWD/propload.h \
     $$PWD/proptypes.h \
+    $$PWD/replay.h \
     $$PWD/util.h \
+    $$PWD/widgets/mappedview.h \
     $$PWD/widgets/propedit.h \
+    $$PWD/dialogs/fleetdlg.h \
     $$PWD/dialogs/flexspindlg.h \
+    $$PWD/dialogs/replaydlg.h \
     $$PWD/dialogs/serialportdlg.h \
     $$PWD/term/vt220.h \
     $$PWD/term/vtattr.h \
@@ -54,7 +85,6 @@ HEADERS += \
     $$PWD/term/vtglyphidx.h \
     $$PWD/term/vtglyphs.h \
     $$PWD/term/vtline.h \
-    $$PWD/term/vtscrollarea.h \
     dialogs/aboutdlg.h \
     dialogs/settingsdlg.h \
     dialogs/textbrowserdlg.h \
@@ -62,7 +92,9 @@ HEADERS += \
 
 FORMS += \
     $$PWD/qflexprop.ui \
+    $$PWD/dialogs/fleetdlg.ui \
     $$PWD/dialogs/flexspindlg.ui \
+    $$PWD/dialogs/replaydlg.ui \
     $$PWD/dialogs/serialportdlg.ui \
     $$PWD/serterm.ui \
     dialogs/aboutdlg.ui \
@@ -0,0 +1,250 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial capture replay
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include "replay.h"
+
+#define	DEBUG_REPLAY	0
+
+#if defined(DEBUG_REPLAY) && (DEBUG_REPLAY != 0)
+#define	DBG_REPLAY(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_REPLAY(X,...) /* X */
+#endif
+
+Replay::Replay(vt220* term, QObject* parent)
+    : QObject(parent)
+    , m_term(term)
+    , m_file()
+    , m_timer()
+    , m_clock()
+    , m_play_ns(0)
+    , m_ns(0)
+    , m_offset(0)
+    , m_speed(1.0)
+    , m_snapshots()
+    , m_parsed(0)
+    , m_parse_ns(0)
+{
+    m_timer.setInterval(tick_interval);
+    bool ok = connect(&m_timer, SIGNAL(timeout()), SLOT(tick()));
+    Q_ASSERT(ok);
+}
+
+/**
+ * @brief Open a capture and reset the terminal to its start
+ * @param filename name of one of the capture's files, or its base name
+ * @return true on success
+ */
+bool Replay::open(const QString& filename)
+{
+    pause();
+    m_snapshots.clear();
+    m_parsed = 0;
+    m_parse_ns = 0;
+    if (!m_file.open(filename))
+	return false;
+    m_term->clear();
+    m_snapshots.insert(0, m_term->snapshot());
+    m_offset = 0;
+    m_ns = 0;
+    emit position_changed(m_ns, m_offset);
+    return true;
+}
+
+/**
+ * @brief Return the capture being replayed
+ * @return const reference to the CaptureFile
+ */
+const CaptureFile& Replay::capture() const
+{
+    return m_file;
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString Replay::error_string() const
+{
+    return m_file.error_string();
+}
+
+/**
+ * @brief Return true while the replay is running
+ * @return true if playing
+ */
+bool Replay::playing() const
+{
+    return m_timer.isActive();
+}
+
+/**
+ * @brief Return the speed factor
+ * @return factor, or 0 for as fast as possible
+ */
+double Replay::speed() const
+{
+    return m_speed;
+}
+
+/**
+ * @brief Return the current capture time
+ * @return time in ns since the start of the capture
+ */
+qint64 Replay::position() const
+{
+    return m_ns;
+}
+
+/**
+ * @brief Return the stream offset of the next byte to parse
+ * @return offset
+ */
+qint64 Replay::offset() const
+{
+    return m_offset;
+}
+
+/**
+ * @brief Return the duration of the capture
+ * @return time in ns
+ */
+qint64 Replay::duration() const
+{
+    return m_file.duration();
+}
+
+/**
+ * @brief Return the number of bytes parsed so far
+ * @return number of bytes
+ */
+qint64 Replay::parsed_bytes() const
+{
+    return m_parsed;
+}
+
+/**
+ * @brief Return the throughput of the terminal parser
+ * @return number of bytes per second spent in vt220::write()
+ */
+qint64 Replay::bytes_per_second() const
+{
+    if (m_parse_ns <= 0)
+	return 0;
+    return static_cast<qint64>(static_cast<double>(m_parsed) * 1e9 / m_parse_ns);
+}
+
+/**
+ * @brief Return the number of snapshots taken
+ * @return number of snapshots
+ */
+int Replay::snapshots() const
+{
+    return m_snapshots.count();
+}
+
+/**
+ * @brief Start or continue the replay at the current position
+ */
+void Replay::play()
+{
+    if (m_offset >= m_file.size())
+	return;
+    m_play_ns = m_ns;
+    m_clock.start();
+    m_timer.start();
+}
+
+/**
+ * @brief Stop the replay at the current position
+ */
+void Replay::pause()
+{
+    m_timer.stop();
+}
+
+/**
+ * @brief Set the speed factor
+ * @param speed factor, or 0 for as fast as possible
+ */
+void Replay::set_speed(double speed)
+{
+    m_speed = qMax(0.0, speed);
+    m_play_ns = m_ns;
+    m_clock.restart();
+}
+
+/**
+ * @brief Move the replay to a capture time
+ * The nearest snapshot at or before the target is restored, unless
+ * parsing on from the current position is shorter.
+ * @param ns time in ns since the start of the capture
+ */
+void Replay::seek(qint64 ns)
+{
+    ns = qBound<qint64>(0, ns, m_file.duration());
+    const qint64 target = m_file.offset(ns);
+    QMap<qint64,vt220::Snapshot>::const_iterator it = m_snapshots.upperBound(target);
+    if (it != m_snapshots.constBegin()) {
+	--it;
+	if (target < m_offset || it.key() > m_offset) {
+	    m_term->restore(it.value());
+	    m_offset = it.key();
+	}
+    }
+    DBG_REPLAY("%s: %lld ns -> offset %lld, parsing from %lld", __func__, ns, target, m_offset);
+    feed(target);
+    m_ns = ns;
+    m_play_ns = m_ns;
+    m_clock.restart();
+    emit position_changed(m_ns, m_offset);
+}
+
+/**
+ * @brief Feed the data which is due to the terminal
+ */
+void Replay::tick()
+{
+    if (m_speed <= 0.0) {
+	feed(qMin(m_file.size(), m_offset + max_chunk));
+	m_ns = m_file.time(m_offset);
+    } else {
+	m_ns = m_play_ns + static_cast<qint64>(m_clock.nsecsElapsed() * m_speed);
+	feed(m_file.offset(m_ns));
+    }
+    emit position_changed(m_ns, m_offset);
+
+    if (m_offset >= m_file.size()) {
+	pause();
+	emit finished();
+    }
+}
+
+/**
+ * @brief Parse the data up to a stream offset and take snapshots on the way
+ * @param end stream offset to stop at
+ */
+void Replay::feed(qint64 end)
+{
+    QElapsedTimer timer;
+    while (m_offset < end) {
+	const qint64 boundary = (m_offset / snapshot_interval + 1) * snapshot_interval;
+	const qint64 stop = qMin(end, boundary);
+	const QByteArray data = m_file.read(m_offset, stop - m_offset);
+	if (data.isEmpty())
+	    break;
+	timer.start();
+	m_term->write(data);
+	m_parse_ns += timer.nsecsElapsed();
+	m_parsed += data.size();
+	m_offset += data.size();
+	if (m_offset == boundary && !m_snapshots.contains(boundary))
+	    m_snapshots.insert(boundary, m_term->snapshot());
+    }
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial capture replay
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QMap>
+#include "capturefile.h"
+#include "vt220.h"
+
+/**
+ * @brief The Replay class feeds a captured serial session through a @ref vt220.
+ *
+ * The capture is replayed at its original speed, at a multiple of it, or
+ * as fast as possible. While the data is parsed, a snapshot of the
+ * emulation state is taken every @ref snapshot_interval bytes. Seeking
+ * restores the nearest snapshot before the target and only parses the
+ * data from there, so a seek never has to start over at the beginning.
+ *
+ * The time spent in vt220::write() is measured, which makes replaying
+ * as fast as possible a throughput test of the parser.
+ */
+class Replay : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr int tick_interval = 10;			//!< timer interval in ms
+    static constexpr qint64 max_chunk = 256 * 1024;		//!< bytes per tick when replaying as fast as possible
+    static constexpr qint64 snapshot_interval = 1024 * 1024;	//!< bytes between snapshots
+
+    explicit Replay(vt220* term, QObject* parent = nullptr);
+
+    bool open(const QString& filename);
+    const CaptureFile& capture() const;
+    QString error_string() const;
+
+    bool playing() const;
+    double speed() const;
+    qint64 position() const;
+    qint64 offset() const;
+    qint64 duration() const;
+    qint64 parsed_bytes() const;
+    qint64 bytes_per_second() const;
+    int snapshots() const;
+
+signals:
+    void position_changed(qint64 ns, qint64 offset);
+    void finished();
+
+public slots:
+    void play();
+    void pause();
+    void set_speed(double speed);
+    void seek(qint64 ns);
+
+private slots:
+    void tick();
+
+private:
+    vt220* m_term;			    //!< terminal to feed
+    CaptureFile m_file;			    //!< the capture being replayed
+    QTimer m_timer;			    //!< drives the replay
+    QElapsedTimer m_clock;		    //!< real time since m_play_ns
+    qint64 m_play_ns;			    //!< capture time when m_clock was started
+    qint64 m_ns;			    //!< current capture time
+    qint64 m_offset;			    //!< stream offset of the next byte to parse
+    double m_speed;			    //!< speed factor, or 0 for as fast as possible
+    QMap<qint64,vt220::Snapshot> m_snapshots; //!< snapshots by stream offset
+    qint64 m_parsed;			    //!< number of bytes parsed
+    qint64 m_parse_ns;			    //!< time spent parsing in ns
+
+    void feed(qint64 end);
+};
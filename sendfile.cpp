@@ -0,0 +1,358 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 asynchronous file sender
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QSerialPort>
+#include <cstring>
+#include "sendfile.h"
+
+#define	DEBUG_SENDFILE	0
+
+#if defined(DEBUG_SENDFILE) && (DEBUG_SENDFILE != 0)
+#define	DBG_SENDFILE(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_SENDFILE(X,...) /* X */
+#endif
+
+static constexpr char XON = 0x11;
+static constexpr char XOFF = 0x13;
+
+SendFile::SendFile(QObject* parent)
+    : QObject(parent)
+    , m_dev(nullptr)
+    , m_file()
+    , m_data(nullptr)
+    , m_size(0)
+    , m_pos(0)
+    , m_line_delay(0)
+    , m_echo_wait(false)
+    , m_waiting(false)
+    , m_xoff(false)
+    , m_poll()
+    , m_wait()
+    , m_clock()
+    , m_update()
+    , m_error()
+{
+    m_poll.setSingleShot(true);
+    m_wait.setSingleShot(true);
+    bool ok = connect(&m_poll, SIGNAL(timeout()), SLOT(pump()));
+    Q_ASSERT(ok);
+    ok = connect(&m_wait, SIGNAL(timeout()), SLOT(wait_done()));
+    Q_ASSERT(ok);
+}
+
+SendFile::~SendFile()
+{
+    cancel();
+}
+
+/**
+ * @brief Start sending a file
+ * @param dev pointer to the device to write to
+ * @param filename name of the file to send
+ * @return true if sending was started
+ */
+bool SendFile::start(QIODevice* dev, const QString& filename)
+{
+    cancel();
+    m_error.clear();
+    if (!dev || !dev->isOpen()) {
+	m_error = tr("The device is not open.");
+	return false;
+    }
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+	m_error = tr("Could not open %1: %2")
+		  .arg(filename)
+		  .arg(m_file.errorString());
+	return false;
+    }
+    m_size = m_file.size();
+    if (m_size > 0) {
+	m_data = reinterpret_cast<const char*>(m_file.map(0, m_size));
+	if (!m_data) {
+	    m_error = tr("Could not map %1: %2")
+		      .arg(filename)
+		      .arg(m_file.errorString());
+	    m_file.close();
+	    return false;
+	}
+    }
+    m_dev = dev;
+    m_pos = 0;
+    m_waiting = false;
+    m_xoff = false;
+    bool ok = connect(m_dev, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()),
+		      Qt::UniqueConnection);
+    Q_ASSERT(ok);
+    ok = connect(m_dev, SIGNAL(aboutToClose()), this, SLOT(device_closing()),
+		 Qt::UniqueConnection);
+    Q_ASSERT(ok);
+    m_clock.start();
+    m_update.start();
+    emit progress(0, m_size);
+    DBG_SENDFILE("%s: %s, %lld bytes", __func__, qPrintable(filename), m_size);
+    m_poll.start(0);
+    return true;
+}
+
+/**
+ * @brief Stop sending
+ * Data which was already handed to the device is still sent.
+ */
+void SendFile::cancel()
+{
+    if (!m_dev)
+	return;
+    m_error = tr("Cancelled after %1 of %2 bytes.").arg(m_pos).arg(m_size);
+    finish(false);
+}
+
+/**
+ * @brief Return true while a file is being sent
+ * @return true if running
+ */
+bool SendFile::running() const
+{
+    return !m_dev.isNull();
+}
+
+/**
+ * @brief Return the name of the file being sent
+ * @return file name
+ */
+QString SendFile::filename() const
+{
+    return m_file.fileName();
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString SendFile::error_string() const
+{
+    return m_error;
+}
+
+/**
+ * @brief Return the number of bytes sent
+ * @return number of bytes
+ */
+qint64 SendFile::sent() const
+{
+    return m_pos;
+}
+
+/**
+ * @brief Return the size of the file
+ * @return number of bytes
+ */
+qint64 SendFile::size() const
+{
+    return m_size;
+}
+
+/**
+ * @brief Return the average throughput since the start
+ * @return bytes per second
+ */
+qint64 SendFile::bytes_per_second() const
+{
+    const qint64 ms = m_clock.isValid() ? m_clock.elapsed() : 0;
+    return ms > 0 ? m_pos * 1000 / ms : 0;
+}
+
+/**
+ * @brief Return the estimated time until the file is sent
+ * @return time in ms, or -1 if unknown
+ */
+qint64 SendFile::eta_ms() const
+{
+    const qint64 bps = bytes_per_second();
+    return bps > 0 ? (m_size - m_pos) * 1000 / bps : -1;
+}
+
+/**
+ * @brief Return the delay after each line
+ * @return delay in ms
+ */
+int SendFile::line_delay() const
+{
+    return m_line_delay;
+}
+
+/**
+ * @brief Return true if an echo is awaited after each line
+ * @return true if waiting for echoes
+ */
+bool SendFile::echo_wait() const
+{
+    return m_echo_wait;
+}
+
+/**
+ * @brief Set the delay after each line
+ * @param ms delay in ms, or 0 for none
+ */
+void SendFile::set_line_delay(int ms)
+{
+    m_line_delay = qMax(0, ms);
+}
+
+/**
+ * @brief Set waiting for an echoed line end after each line
+ * @param on if true, wait for echoes
+ */
+void SendFile::set_echo_wait(bool on)
+{
+    m_echo_wait = on;
+}
+
+/**
+ * @brief Look at received data for XON/XOFF and echoes
+ * @param data const reference to the received data
+ */
+void SendFile::received(const QByteArray& data)
+{
+    if (!m_dev)
+	return;
+    const QSerialPort* stty = qobject_cast<const QSerialPort*>(m_dev.data());
+    if (!stty || QSerialPort::SoftwareControl == stty->flowControl()) {
+	// the last of XON or XOFF wins
+	const int on = data.lastIndexOf(XON);
+	const int off = data.lastIndexOf(XOFF);
+	if (on != off)
+	    m_xoff = off > on;
+    }
+    if (m_waiting && m_echo_wait && (data.contains('\n') || data.contains('\r'))) {
+	m_wait.stop();
+	wait_done();
+    }
+}
+
+/**
+ * @brief Write chunks while the device has room for them
+ */
+void SendFile::pump()
+{
+    if (!m_dev || m_waiting)
+	return;
+
+    QElapsedTimer slice;
+    slice.start();
+    const bool lines = m_line_delay > 0 || m_echo_wait;
+    while (m_pos < m_size) {
+	if (flow_stopped()) {
+	    m_poll.start(poll_interval);
+	    return;
+	}
+	if (m_dev->bytesToWrite() >= high_water) {
+	    // continued by bytesWritten()
+	    return;
+	}
+	if (slice.elapsed() >= slice_ms) {
+	    m_poll.start(0);
+	    return;
+	}
+
+	qint64 len = qMin(chunk_size, m_size - m_pos);
+	bool eol = false;
+	if (lines) {
+	    const char* nl = reinterpret_cast<const char*>(memchr(m_data + m_pos, '\n', static_cast<size_t>(len)));
+	    if (nl) {
+		len = nl - (m_data + m_pos) + 1;
+		eol = true;
+	    }
+	}
+	const QByteArray chunk(m_data + m_pos, static_cast<int>(len));
+	const qint64 written = m_dev->write(chunk);
+	if (written < 0) {
+	    m_error = tr("Write error after %1 bytes: %2")
+		      .arg(m_pos)
+		      .arg(m_dev->errorString());
+	    finish(false);
+	    return;
+	}
+	emit data_sent(chunk.left(static_cast<int>(written)));
+	m_pos += written;
+
+	if (m_update.elapsed() >= progress_interval) {
+	    m_update.restart();
+	    emit progress(m_pos, m_size);
+	}
+
+	if (eol && written == len) {
+	    m_waiting = true;
+	    m_wait.start(m_echo_wait ? echo_timeout : m_line_delay);
+	    return;
+	}
+    }
+
+    if (m_dev->bytesToWrite() > 0) {
+	// finish when the rest was written
+	return;
+    }
+    finish(true);
+}
+
+/**
+ * @brief Continue after the line delay, an echo, or the echo timeout
+ */
+void SendFile::wait_done()
+{
+    m_waiting = false;
+    pump();
+}
+
+/**
+ * @brief Stop sending because the device is about to be closed
+ */
+void SendFile::device_closing()
+{
+    m_error = tr("The device was closed after %1 of %2 bytes.").arg(m_pos).arg(m_size);
+    finish(false);
+}
+
+/**
+ * @brief Return true if the receiver asked to pause
+ * @return true if CTS is inactive or XOFF was received
+ */
+bool SendFile::flow_stopped() const
+{
+    if (m_xoff)
+	return true;
+    const QSerialPort* stty = qobject_cast<const QSerialPort*>(m_dev.data());
+    if (stty && QSerialPort::HardwareControl == stty->flowControl())
+	return !(stty->pinoutSignals() & QSerialPort::ClearToSendSignal);
+    return false;
+}
+
+/**
+ * @brief Stop sending, unmap the file, and report the result
+ * @param ok true if the file was sent completely
+ */
+void SendFile::finish(bool ok)
+{
+    m_poll.stop();
+    m_wait.stop();
+    if (m_dev) {
+	disconnect(m_dev, SIGNAL(bytesWritten(qint64)), this, SLOT(pump()));
+	disconnect(m_dev, SIGNAL(aboutToClose()), this, SLOT(device_closing()));
+    }
+    m_dev = nullptr;
+    m_waiting = false;
+    if (m_data)
+	m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_data)));
+    m_data = nullptr;
+    m_file.close();
+    emit progress(m_pos, m_size);
+    DBG_SENDFILE("%s: %s after %lld of %lld bytes", __func__, ok ? "done" : "failed", m_pos, m_size);
+    emit finished(ok);
+}
@@ -0,0 +1,95 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 asynchronous file sender
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QObject>
+#include <QFile>
+#include <QPointer>
+#include <QTimer>
+#include <QElapsedTimer>
+
+/**
+ * @brief The SendFile class sends a file to the serial port without blocking the GUI.
+ *
+ * The file is memory mapped and written in small chunks. A new chunk is
+ * only written when less than @ref high_water bytes are waiting in the
+ * device, so the sender runs at the speed of the port and never piles
+ * up data in front of a slow receiver. Sending pauses while CTS is
+ * inactive with hardware flow control, and between XOFF and XON with
+ * software flow control.
+ *
+ * For receivers which can't keep up even then, e.g. TAQOZ compiling
+ * source, each line can be followed by a delay, or by waiting until the
+ * receiver echoes a line end. The received data must be passed to
+ * @ref received for this.
+ *
+ * Sending is cancelled when the device is about to be closed.
+ */
+class SendFile : public QObject
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 chunk_size = 256;		//!< maximum bytes per write
+    static constexpr qint64 high_water = 512;		//!< maximum bytes waiting in the device
+    static constexpr int poll_interval = 10;		//!< ms between checks while paused by flow control
+    static constexpr int echo_timeout = 2000;		//!< ms to wait for an echo
+    static constexpr int slice_ms = 20;			//!< ms to write before returning to the event loop
+    static constexpr int progress_interval = 250;	//!< ms between progress signals
+
+    explicit SendFile(QObject* parent = nullptr);
+    ~SendFile();
+
+    bool start(QIODevice* dev, const QString& filename);
+    void cancel();
+
+    bool running() const;
+    QString filename() const;
+    QString error_string() const;
+    qint64 sent() const;
+    qint64 size() const;
+    qint64 bytes_per_second() const;
+    qint64 eta_ms() const;
+
+    int line_delay() const;
+    bool echo_wait() const;
+
+signals:
+    void progress(qint64 sent, qint64 total);
+    void data_sent(const QByteArray& data);
+    void finished(bool ok);
+
+public slots:
+    void set_line_delay(int ms);
+    void set_echo_wait(bool on);
+    void received(const QByteArray& data);
+
+private slots:
+    void pump();
+    void wait_done();
+    void device_closing();
+
+private:
+    QPointer<QIODevice> m_dev;		    //!< device to write to
+    QFile m_file;			    //!< file being sent
+    const char* m_data;			    //!< mapped file contents
+    qint64 m_size;			    //!< file size
+    qint64 m_pos;			    //!< offset of the next byte to send
+    int m_line_delay;			    //!< ms to wait after each line
+    bool m_echo_wait;			    //!< wait for an echoed line end after each line
+    bool m_waiting;			    //!< waiting for the line delay or an echo
+    bool m_xoff;			    //!< XOFF was received
+    QTimer m_poll;			    //!< restarts pump() after a pause
+    QTimer m_wait;			    //!< line delay or echo timeout
+    QElapsedTimer m_clock;		    //!< time since the start
+    QElapsedTimer m_update;		    //!< time since the last progress signal
+    QString m_error;			    //!< most recent error message
+
+    bool flow_stopped() const;
+    void finish(bool ok);
+};
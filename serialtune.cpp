@@ -0,0 +1,142 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial port tuning
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QFile>
+#include <QFileInfo>
+#include "serialtune.h"
+
+#if defined(Q_OS_LINUX)
+// <asm/termbits.h> defines struct termios2, but conflicts with <termios.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#endif
+
+#define	DEBUG_SERIALTUNE	0
+
+#if defined(DEBUG_SERIALTUNE) && (DEBUG_SERIALTUNE != 0)
+#define	DBG_SERIALTUNE(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_SERIALTUNE(X,...) /* X */
+#endif
+
+/**
+ * @brief Set an arbitrary baud rate for both directions
+ * @param fd file descriptor of the open serial port
+ * @param baud_rate baud rate in bits per second
+ * @return the baud rate achieved by the driver, or -1 on error (see errno)
+ */
+qint32 SerialTune::set_baud_rate(int fd, qint32 baud_rate)
+{
+#if defined(Q_OS_LINUX)
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) < 0)
+	return -1;
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = static_cast<speed_t>(baud_rate);
+    tio.c_ospeed = static_cast<speed_t>(baud_rate);
+    if (ioctl(fd, TCSETS2, &tio) < 0)
+	return -1;
+    const qint32 actual = SerialTune::baud_rate(fd);
+    DBG_SERIALTUNE("%s: requested %d, actual %d", __func__, baud_rate, actual);
+    return actual;
+#else
+    Q_UNUSED(fd)
+    Q_UNUSED(baud_rate)
+    return -1;
+#endif
+}
+
+/**
+ * @brief Return the output baud rate of a serial port
+ * The driver updates the rate to what it was able to program,
+ * so this can differ from the rate which was set.
+ * @param fd file descriptor of the open serial port
+ * @return baud rate in bits per second, or -1 on error (see errno)
+ */
+qint32 SerialTune::baud_rate(int fd)
+{
+#if defined(Q_OS_LINUX)
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) < 0)
+	return -1;
+    return static_cast<qint32>(tio.c_ospeed);
+#else
+    Q_UNUSED(fd)
+    return -1;
+#endif
+}
+
+/**
+ * @brief Turn the driver's low latency mode on or off
+ * @param fd file descriptor of the open serial port
+ * @param on if true, set ASYNC_LOW_LATENCY, otherwise clear it
+ * @return true on success, or false if the driver doesn't support it (see errno)
+ */
+bool SerialTune::set_low_latency(int fd, bool on)
+{
+#if defined(Q_OS_LINUX)
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) < 0)
+	return false;
+    if (on) {
+	ss.flags |= ASYNC_LOW_LATENCY;
+    } else {
+	ss.flags &= ~ASYNC_LOW_LATENCY;
+    }
+    return ioctl(fd, TIOCSSERIAL, &ss) >= 0;
+#else
+    Q_UNUSED(fd)
+    Q_UNUSED(on)
+    return false;
+#endif
+}
+
+/**
+ * @brief Return the sysfs path of the latency timer of an USB serial adapter
+ * @param port_name name or path of the port, e.g. ttyUSB0
+ * @return path name
+ */
+static QString latency_timer_path(const QString& port_name)
+{
+    return QString("/sys/bus/usb-serial/devices/%1/latency_timer")
+	    .arg(QFileInfo(port_name).fileName());
+}
+
+/**
+ * @brief Return the latency timer of an USB serial adapter (FTDI)
+ * @param port_name name or path of the port, e.g. ttyUSB0
+ * @return latency in ms, or -1 if the adapter has no latency timer
+ */
+int SerialTune::latency_timer(const QString& port_name)
+{
+    QFile file(latency_timer_path(port_name));
+    if (!file.open(QIODevice::ReadOnly))
+	return -1;
+    bool ok;
+    const int ms = file.readAll().trimmed().toInt(&ok);
+    return ok ? ms : -1;
+}
+
+/**
+ * @brief Set the latency timer of an USB serial adapter (FTDI)
+ * Writing to sysfs usually requires a udev rule granting access.
+ * @param port_name name or path of the port, e.g. ttyUSB0
+ * @param ms latency in ms (1 … 255)
+ * @return true on success, or false if the file can't be written
+ */
+bool SerialTune::set_latency_timer(const QString& port_name, int ms)
+{
+    QFile file(latency_timer_path(port_name));
+    if (!file.open(QIODevice::WriteOnly))
+	return false;
+    const QByteArray value = QByteArray::number(qBound(1, ms, 255));
+    return file.write(value) == value.size();
+}
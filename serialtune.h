@@ -0,0 +1,33 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 serial port tuning
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QString>
+
+/**
+ * @brief The SerialTune class sets up a serial port beyond what QSerialPort offers.
+ *
+ * On Linux arbitrary baud rates are set with termios2 and BOTHER, and the
+ * rate the driver actually achieved is read back. The driver can be put
+ * into low latency mode (ASYNC_LOW_LATENCY), and the latency timer of FTDI
+ * adapters, which defaults to 16ms, can be lowered through sysfs.
+ *
+ * On other systems the functions do nothing and return failure.
+ */
+class SerialTune
+{
+public:
+    static constexpr int ftdi_latency_ms = 1;	//!< FTDI latency timer to use in ms
+
+    static qint32 set_baud_rate(int fd, qint32 baud_rate);
+    static qint32 baud_rate(int fd);
+    static bool set_low_latency(int fd, bool on = true);
+    static int latency_timer(const QString& port_name);
+    static bool set_latency_timer(const QString& port_name, int ms);
+};
@@ -11,14 +11,18 @@
 #include <QSerialPortInfo>
 #include <QLocale>
 #include <QFileDialog>
-#include <QTextStream>
 #include <QStandardPaths>
 #include <QTimer>
+#include <QInputDialog>
+#include <QLabel>
+#include <QMenu>
+#include <QToolButton>
 #include "serterm.h"
-#include "vtscrollarea.h"
 #include "ui_serterm.h"
 #include "idstrings.h"
 #include "util.h"
+#include "blockxfer.h"
+#include "sendfile.h"
 
 SerTerm::SerTerm(QWidget *parent)
     : QWidget(parent)
@@ -31,6 +35,12 @@ SerTerm::SerTerm(QWidget *parent)
     , m_num_lock(false)
     , m_scroll_lock(false)
     , m_local_echo(false)
+    , m_sendfile(new SendFile(this))
+    , m_act_sendfile(nullptr)
+    , m_blockxfer(new BlockXfer(this))
+    , m_act_sendbinary(nullptr)
+    , m_act_sendfile_status(nullptr)
+    , m_lbl_sendfile(nullptr)
 {
     ui->setupUi(this);
     load_config();
@@ -44,11 +54,43 @@ SerTerm::~SerTerm()
     delete ui;
 }
 
+vt220* SerTerm::vterm() const
+{
+    return ui->vterm;
+}
+
 void SerTerm::set_device(QIODevice* dev)
 {
     m_dev = dev;
 }
 
+/**
+ * @brief Return true while a file or binary transfer is in progress
+ * @return true if SendFile or BlockXfer is running
+ */
+bool SerTerm::transfer_running() const
+{
+    return m_sendfile->running() || m_blockxfer->running();
+}
+
+/**
+ * @brief Forget a partial escape sequence after data was left out
+ */
+void SerTerm::reset_decoder()
+{
+    ui->vterm->reset_decoder();
+}
+
+/**
+ * @brief Cancel a file or binary transfer in progress
+ * This must be called before the device is closed or replaced.
+ */
+void SerTerm::cancel_transfers()
+{
+    m_sendfile->cancel();
+    m_blockxfer->cancel();
+}
+
 void SerTerm::term_set_size(int width, int height)
 {
     ui->vterm->term_set_size(width, height);
@@ -76,11 +118,24 @@ void SerTerm::putch(uchar ch)
 
 int SerTerm::write(const QByteArray& data)
 {
+    if (m_blockxfer->running()) {
+	// the receiver's replies are not for the terminal
+	m_blockxfer->received(data);
+	return data.size();
+    }
+    if (m_sendfile->running())
+	m_sendfile->received(data);
     return ui->vterm->write(data);
 }
 
 int SerTerm::write(const char* data, size_t len)
 {
+    if (m_blockxfer->running()) {
+	m_blockxfer->received(QByteArray(data, static_cast<int>(len)));
+	return static_cast<int>(len);
+    }
+    if (m_sendfile->running())
+	m_sendfile->received(QByteArray::fromRawData(data, static_cast<int>(len)));
     return ui->vterm->write(data, len);
 }
 
@@ -127,7 +182,7 @@ void SerTerm::geometry_changed()
 
 void SerTerm::term_fit_best()
 {
-    ui->scrollArea->updateGeometry();
+    ui->vterm->updateGeometry();
 }
 
 void SerTerm::zoom_original()
@@ -157,16 +212,6 @@ void SerTerm::setup_terminal()
 {
     bool ok;
 
-    ok = connect(ui->vterm, &vt220::UpdateSize,
-	    ui->scrollArea, &vtScrollArea::UpdateSize,
-	    Qt::UniqueConnection);
-    Q_ASSERT(ok);
-
-    ok = connect(ui->vterm, &vt220::UpdateCursor,
-	    ui->scrollArea, &vtScrollArea::UpdateCursor,
-	    Qt::UniqueConnection);
-    Q_ASSERT(ok);
-
     ui->toolbar->setIconSize(QSize(20, 20));
     ui->toolbar->setToolButtonStyle(Qt::ToolButtonIconOnly);
 
@@ -194,11 +239,54 @@ void SerTerm::setup_terminal()
     Q_ASSERT(ok);
     ui->toolbar->addAction(act_taqoz);
 
-    QAction* act_sendfile = new QAction(QIcon(":/images/sendfile.png"), tr("Send file"));
-    ok = connect(act_sendfile, &QAction::triggered,
+    m_act_sendfile = new QAction(QIcon(":/images/sendfile.png"), tr("Send file"));
+    m_act_sendfile->setCheckable(true);
+    ok = connect(m_act_sendfile, &QAction::triggered,
 	    this, &SerTerm::sendfile_triggered);
     Q_ASSERT(ok);
-    ui->toolbar->addAction(act_sendfile);
+    QMenu* menu_sendfile = new QMenu(this);
+    QAction* act_echo_wait = menu_sendfile->addAction(tr("Wait for echo after each line"));
+    act_echo_wait->setCheckable(true);
+    act_echo_wait->setChecked(m_sendfile->echo_wait());
+    ok = connect(act_echo_wait, &QAction::triggered,
+	    this, &SerTerm::sendfile_echo_wait_triggered);
+    Q_ASSERT(ok);
+    QAction* act_line_delay = menu_sendfile->addAction(tr("Delay after each line..."));
+    ok = connect(act_line_delay, &QAction::triggered,
+	    this, &SerTerm::sendfile_line_delay_triggered);
+    Q_ASSERT(ok);
+    m_act_sendfile->setMenu(menu_sendfile);
+    ui->toolbar->addAction(m_act_sendfile);
+    QToolButton* tb_sendfile = qobject_cast<QToolButton*>(ui->toolbar->widgetForAction(m_act_sendfile));
+    if (tb_sendfile)
+	tb_sendfile->setPopupMode(QToolButton::MenuButtonPopup);
+
+    m_act_sendbinary = new QAction(QIcon(":/images/upload.png"), tr("Send binary file to the P2 receiver"));
+    m_act_sendbinary->setCheckable(true);
+    ok = connect(m_act_sendbinary, &QAction::triggered,
+	    this, &SerTerm::sendbinary_triggered);
+    Q_ASSERT(ok);
+    ui->toolbar->addAction(m_act_sendbinary);
+
+    m_lbl_sendfile = new QLabel(this);
+    m_act_sendfile_status = ui->toolbar->addWidget(m_lbl_sendfile);
+    m_act_sendfile_status->setVisible(false);
+
+    ok = connect(m_sendfile, &SendFile::progress,
+	    this, &SerTerm::sendfile_progress);
+    Q_ASSERT(ok);
+    ok = connect(m_sendfile, &SendFile::data_sent,
+	    this, &SerTerm::sendfile_echo);
+    Q_ASSERT(ok);
+    ok = connect(m_sendfile, &SendFile::finished,
+	    this, &SerTerm::sendfile_finished);
+    Q_ASSERT(ok);
+    ok = connect(m_blockxfer, &BlockXfer::progress,
+	    this, &SerTerm::sendbinary_progress);
+    Q_ASSERT(ok);
+    ok = connect(m_blockxfer, &BlockXfer::finished,
+	    this, &SerTerm::sendbinary_finished);
+    Q_ASSERT(ok);
 
     ui->toolbar->addSeparator();
 
@@ -264,6 +352,11 @@ void SerTerm::load_config()
 	download_paths += QString("%1/Downloads").arg(QDir::homePath());
     }
     m_download_path = s.value(id_download_path, download_paths.first()).toString();
+
+    s.beginGroup(id_grp_serterm);
+    m_sendfile->set_line_delay(s.value(id_sendfile_line_delay, 0).toInt());
+    m_sendfile->set_echo_wait(s.value(id_sendfile_echo_wait, false).toBool());
+    s.endGroup();
 }
 
 /**
@@ -372,28 +465,110 @@ void SerTerm::taqoz_triggered(bool checked)
     }
 }
 
+/**
+ * @brief Start sending a file, or cancel sending it
+ * @param checked true to start, false to cancel
+ */
 void SerTerm::sendfile_triggered(bool checked)
 {
-    Q_UNUSED(checked);
-    QEventLoop loop(this);
-    QString filename = load_file(tr("Select file to send"));
-    if (filename.isEmpty())
+    if (!checked) {
+	m_sendfile->cancel();
+	return;
+    }
+    if (m_blockxfer->running()) {
+	m_act_sendfile->setChecked(false);
 	return;
-    QFile file(filename);
-    if (file.open(QIODevice::ReadOnly)) {
-	QTextStream str(&file);
-	str.setCodec("UTF-8");
-
-	while (!str.atEnd()) {
-	    QString line = str.readLine();
-	    QByteArray utf8 =  line.toUtf8() + '\n';
-	    emit term_response(utf8);
-	    if (m_local_echo) {
-		ui->vterm->write(utf8);
-	    }
-	    loop.processEvents();
+    }
+    QString filename = load_file(tr("Select file to send"));
+    if (filename.isEmpty() || !m_sendfile->start(m_dev, filename)) {
+	m_act_sendfile->setChecked(false);
+	if (!filename.isEmpty()) {
+	    m_lbl_sendfile->setText(m_sendfile->error_string());
+	    m_act_sendfile_status->setVisible(true);
 	}
-	file.close();
+	return;
+    }
+    m_act_sendfile->setToolTip(tr("Cancel sending %1").arg(QFileInfo(filename).fileName()));
+    m_act_sendfile_status->setVisible(true);
+}
+
+/**
+ * @brief Toggle waiting for an echoed line end after each line sent
+ * @param checked true to wait for echoes
+ */
+void SerTerm::sendfile_echo_wait_triggered(bool checked)
+{
+    m_sendfile->set_echo_wait(checked);
+    QSettings s;
+    s.beginGroup(id_grp_serterm);
+    s.setValue(id_sendfile_echo_wait, checked);
+    s.endGroup();
+}
+
+/**
+ * @brief Ask for the delay after each line sent
+ */
+void SerTerm::sendfile_line_delay_triggered(bool checked)
+{
+    Q_UNUSED(checked);
+    bool ok;
+    const int ms = QInputDialog::getInt(this, tr("Send file"), tr("Delay after each line in ms:"),
+					m_sendfile->line_delay(), 0, 10000, 1, &ok);
+    if (!ok)
+	return;
+    m_sendfile->set_line_delay(ms);
+    QSettings s;
+    s.beginGroup(id_grp_serterm);
+    s.setValue(id_sendfile_line_delay, ms);
+    s.endGroup();
+}
+
+/**
+ * @brief Show the progress, throughput, and estimated time left
+ * @param sent number of bytes sent
+ * @param total size of the file
+ */
+void SerTerm::sendfile_progress(qint64 sent, qint64 total)
+{
+    QLocale locale = QLocale::system();
+    const qint64 eta = m_sendfile->eta_ms() / 1000;
+    QString str = tr("%1% %2/s")
+		  .arg(total > 0 ? sent * 100 / total : 100)
+		  .arg(locale.formattedDataSize(m_sendfile->bytes_per_second()));
+    if (eta >= 0)
+	str += tr(" ETA %1:%2").arg(eta / 60).arg(eta % 60, 2, 10, QChar('0'));
+    m_lbl_sendfile->setText(str);
+    m_lbl_sendfile->setToolTip(tr("%1\n%2 of %3 bytes sent.")
+			       .arg(m_sendfile->filename())
+			       .arg(locale.toString(sent))
+			       .arg(locale.toString(total)));
+}
+
+/**
+ * @brief Echo the data sent to the terminal if local echo is on
+ * @param data const reference to the data sent
+ */
+void SerTerm::sendfile_echo(const QByteArray& data)
+{
+    if (m_local_echo)
+	ui->vterm->write(data);
+}
+
+/**
+ * @brief Report the end of sending a file
+ * @param ok true if the file was sent completely
+ */
+void SerTerm::sendfile_finished(bool ok)
+{
+    m_act_sendfile->setChecked(false);
+    m_act_sendfile->setToolTip(tr("Send file"));
+    if (ok) {
+	QLocale locale = QLocale::system();
+	m_lbl_sendfile->setText(tr("Sent %1 at %2/s")
+				.arg(locale.formattedDataSize(m_sendfile->size()))
+				.arg(locale.formattedDataSize(m_sendfile->bytes_per_second())));
+    } else {
+	m_lbl_sendfile->setText(m_sendfile->error_string());
     }
 }
 
@@ -1438,3 +1613,73 @@ void SerTerm::keyPressEvent(QKeyEvent* event)
 	}
     }
 }
+
+/**
+ * @brief Start a windowed binary transfer, or cancel it
+ * The P2 must run a receiver like examples/blockxfer_rx.spin2.
+ * @param checked true to start, false to cancel
+ */
+void SerTerm::sendbinary_triggered(bool checked)
+{
+    if (!checked) {
+	m_blockxfer->cancel();
+	return;
+    }
+    if (m_sendfile->running()) {
+	m_act_sendbinary->setChecked(false);
+	return;
+    }
+    QString filename = load_file(tr("Select binary file to send"));
+    if (filename.isEmpty() || !m_blockxfer->start(m_dev, filename)) {
+	m_act_sendbinary->setChecked(false);
+	if (!filename.isEmpty()) {
+	    m_lbl_sendfile->setText(m_blockxfer->error_string());
+	    m_act_sendfile_status->setVisible(true);
+	}
+	return;
+    }
+    m_act_sendfile->setEnabled(false);
+    m_act_sendbinary->setToolTip(tr("Cancel sending %1").arg(QFileInfo(filename).fileName()));
+    m_act_sendfile_status->setVisible(true);
+}
+
+/**
+ * @brief Show the progress, throughput, and estimated time left of a binary transfer
+ * @param acknowledged number of bytes acknowledged by the receiver
+ * @param total size of the file
+ */
+void SerTerm::sendbinary_progress(qint64 acknowledged, qint64 total)
+{
+    QLocale locale = QLocale::system();
+    const qint64 eta = m_blockxfer->eta_ms() / 1000;
+    QString str = tr("%1% %2/s")
+		  .arg(total > 0 ? acknowledged * 100 / total : 100)
+		  .arg(locale.formattedDataSize(m_blockxfer->bytes_per_second()));
+    if (eta >= 0)
+	str += tr(" ETA %1:%2").arg(eta / 60).arg(eta % 60, 2, 10, QChar('0'));
+    m_lbl_sendfile->setText(str);
+    m_lbl_sendfile->setToolTip(tr("%1\n%2 of %3 bytes acknowledged, %4 resend(s).")
+			       .arg(m_blockxfer->filename())
+			       .arg(locale.toString(acknowledged))
+			       .arg(locale.toString(total))
+			       .arg(m_blockxfer->resends()));
+}
+
+/**
+ * @brief Report the end of a binary transfer
+ * @param ok true if the receiver confirmed the data
+ */
+void SerTerm::sendbinary_finished(bool ok)
+{
+    m_act_sendbinary->setChecked(false);
+    m_act_sendbinary->setToolTip(tr("Send binary file to the P2 receiver"));
+    m_act_sendfile->setEnabled(true);
+    if (ok) {
+	QLocale locale = QLocale::system();
+	m_lbl_sendfile->setText(tr("Transferred %1 at %2/s")
+				.arg(locale.formattedDataSize(m_blockxfer->size()))
+				.arg(locale.formattedDataSize(m_blockxfer->bytes_per_second())));
+    } else {
+	m_lbl_sendfile->setText(m_blockxfer->error_string());
+    }
+}
@@ -14,6 +14,11 @@ QT_BEGIN_NAMESPACE
 namespace Ui { class SerTerm; }
 QT_END_NAMESPACE
 
+class QLabel;
+class BlockXfer;
+class SendFile;
+class vt220;
+
 class SerTerm : public QWidget
 {
     Q_OBJECT
@@ -22,12 +27,17 @@ public:
     SerTerm(QWidget *parent = nullptr);
     ~SerTerm();
 
+    vt220* vterm() const;
+
 signals:
     void update_pinout(bool redo);
     void term_response(QByteArray response);
 
 public slots:
     void set_device(QIODevice* dev);
+    void cancel_transfers();
+    bool transfer_running() const;
+    void reset_decoder();
     void term_set_size(int width, int height);
     void term_set_width(int width);
     void term_set_height(int height);
@@ -58,6 +68,14 @@ private slots:
     void monitor_triggered(bool checked = false);
     void taqoz_triggered(bool checked = false);
     void sendfile_triggered(bool checked = false);
+    void sendfile_echo_wait_triggered(bool checked);
+    void sendfile_line_delay_triggered(bool checked = false);
+    void sendfile_progress(qint64 sent, qint64 total);
+    void sendfile_echo(const QByteArray& data);
+    void sendfile_finished(bool ok);
+    void sendbinary_triggered(bool checked = false);
+    void sendbinary_progress(qint64 acknowledged, qint64 total);
+    void sendbinary_finished(bool ok);
 
 protected:
     void keyPressEvent(QKeyEvent* event) override;
@@ -72,6 +90,12 @@ private:
     bool m_num_lock;				//!< Keyboard NUM lock flag
     bool m_scroll_lock;				//!< Keyboard SCROLL lock flag
     bool m_local_echo;				//!< Local echo if true
+    SendFile* m_sendfile;			//!< asynchronous file sender
+    QAction* m_act_sendfile;			//!< Send file action
+    BlockXfer* m_blockxfer;			//!< windowed binary transfer
+    QAction* m_act_sendbinary;			//!< Send binary action
+    QAction* m_act_sendfile_status;		//!< toolbar action of m_lbl_sendfile
+    QLabel* m_lbl_sendfile;			//!< Send file throughput and ETA
 
     QString load_file(const QString& title);
     void reset_prop();
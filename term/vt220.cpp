@@ -8,7 +8,8 @@
  *****************************************************************************/
 #include <QFocusEvent>
 #include <QFontDatabase>
-#include "vtscrollarea.h"
+#include <QScrollBar>
+#include <QtConcurrent>
 #include "vt220.h"
 
 #define	DEBUG_FONTINFO	0
@@ -32,7 +33,7 @@
 #endif
 
 vt220::vt220(QWidget* parent)
-    : QWidget(parent)
+    : QAbstractScrollArea(parent)
     , m_terminal(VT200)
     , m_font_family(QLatin1String("Fixedsys"))
     , m_backlog_max(10000)
@@ -41,6 +42,9 @@ vt220::vt220(QWidget* parent)
     , m_blink_timer(-1)
     , m_screen_time(-1)
     , m_blink_phase(false)
+    , m_blink_dirty(true)
+    , m_blink_rect()
+    , m_blink_region()
     , m_conceal_off(false)
     , m_zoom(100)
     , m_font_w(font_w)
@@ -53,6 +57,7 @@ vt220::vt220(QWidget* parent)
     , m_palsize(256)
     , m_pal(m_palsize)
     , m_glyphs()
+    , m_glyphs_watcher()
     , m_def()
     , m_att()
     , m_att_saved()
@@ -95,13 +100,34 @@ vt220::vt220(QWidget* parent)
 {
     // qDebug("%s: %08x", "CTRL_ACTION", CTRL_ACTION);
     // qDebug("%s: %08x", "CTRL_ALWAYS", CTRL_ALWAYS);
-    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
-    set_font(font_w, font_h, font_d);
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+    setSizeAdjustPolicy(QAbstractScrollArea::AdjustToContents);
+    bool ok = connect(&m_glyphs_watcher, SIGNAL(finished()),
+		      SLOT(glyphs_prerendered()));
+    Q_ASSERT(ok);
+    // reset first, so that the character maps are set up for set_font()
     term_reset(m_terminal, m_width, m_height);
+    set_font(font_w, font_h, font_d);
     m_blink_timer = startTimer(250);
 
 }
 
+/**
+ * @brief Forget a partial escape sequence or UTF-8 character
+ * This is needed when data was left out of the stream, so that the next
+ * byte is decoded as the start of a character.
+ */
+void vt220::reset_decoder()
+{
+    m_state = ESnormal;
+    m_csi_args.clear();
+    m_ques = false;
+    m_string.clear();
+    m_utf_more = 0;
+    m_utf_code = 0;
+}
+
 /**
  * @brief Clear the terminal
  * Clear the backlog
@@ -113,13 +139,6 @@ void vt220::clear()
     term_reset(VT200, m_width, m_height);
 }
 
-QSize vt220::sizeHint() const
-{
-    QFontMetrics fm = fontMetrics();
-    return QSize(m_font_w * m_width,
-		 m_font_h * m_height);
-}
-
 QString vt220::font_family() const
 {
     return m_font_family;
@@ -139,6 +158,30 @@ int vt220::zoom() const
     return m_zoom;
 }
 
+/**
+ * @brief Return the maximum number of lines kept in the backlog
+ * @return number of lines
+ */
+int vt220::backlog_max() const
+{
+    return m_backlog_max;
+}
+
+/**
+ * @brief Set the maximum number of lines kept in the backlog
+ * @param lines number of lines
+ */
+void vt220::set_backlog_max(int lines)
+{
+    m_backlog_max = qMax(0, lines);
+    if (m_backlog.count() <= m_backlog_max)
+	return;
+    while (m_backlog.count() > m_backlog_max)
+	m_backlog.removeFirst();
+    m_blink_dirty = true;
+    update_view();
+}
+
 void vt220::set_zoom(int percent)
 {
     m_zoom = percent;
@@ -146,15 +189,34 @@ void vt220::set_zoom(int percent)
     term_set_size(m_width, m_height);
 }
 
+/**
+ * @brief Follow the output: scroll to the screen and make the cursor visible
+ * The view scrolls to the bottom of the screen if the cursor row is visible
+ * there, otherwise just far enough to show the cursor row.
+ */
 void vt220::cursor_slot()
 {
     const vtLine& pl = m_screen[m_cursor.y];
-    const int bh = m_backlog.size();
-    const int x = m_cursor.newx * m_font_w;
-    const int y = (bh + m_cursor.y) * m_font_h;
-    const int w = m_font_w * pl.decdwl();
-    const int h = m_font_h * pl.decdhl();
-    emit UpdateCursor(QRect(x, y, w, h));
+    QScrollBar* vsb = verticalScrollBar();
+    const int rows = visible_rows();
+    const int y0 = m_backlog.size() + m_cursor.y;
+    const int y1 = y0 + pl.decdhl();
+    if (y0 >= vsb->maximum() && y1 <= vsb->maximum() + rows) {
+	vsb->setValue(vsb->maximum());
+    } else if (y0 < vsb->value()) {
+	vsb->setValue(y0);
+    } else if (y1 > vsb->value() + rows) {
+	vsb->setValue(y1 - rows);
+    }
+
+    const int x0 = m_cursor.newx * pl.decdwl() * m_font_w;
+    const int x1 = x0 + pl.decdwl() * m_font_w;
+    QScrollBar* hsb = horizontalScrollBar();
+    if (x0 < hsb->value()) {
+	hsb->setValue(x0);
+    } else if (x1 > hsb->value() + viewport()->width()) {
+	hsb->setValue(x1 - viewport()->width());
+    }
 }
 
 QSize vt220::term_geometry() const
@@ -166,7 +228,7 @@ QSize vt220::term_geometry() const
 bool vt220::event(QEvent* event)
 {
     if (event->type() != QEvent::KeyPress) {
-	return QWidget::event(event);
+	return QAbstractScrollArea::event(event);
     }
     QKeyEvent *ke = static_cast<QKeyEvent *>(event);
     if (ke->key() == Qt::Key_Tab) {
@@ -174,22 +236,108 @@ bool vt220::event(QEvent* event)
 	keyPressEvent(ke);
 	return true;
     }
-    return QWidget::event(event);
+    return QAbstractScrollArea::event(event);
+}
+
+/**
+ * @brief Return the size of the screen in pixels as the preferred viewport size
+ * @return QSize with the width and height
+ */
+QSize vt220::viewportSizeHint() const
+{
+    return QSize(m_font_w * m_width,
+		 m_font_h * m_height);
+}
+
+void vt220::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    update_scrollbars();
+}
+
+/**
+ * @brief Return the viewport rectangle of a range of screen cells
+ * @param x column
+ * @param y row on the screen; negative values are rows of the backlog
+ * @param w number of columns
+ * @param h number of rows
+ * @return QRect in viewport coordinates
+ */
+QRect vt220::cell_rect(int x, int y, int w, int h) const
+{
+    const int row = m_backlog.size() + y - verticalScrollBar()->value();
+    return QRect(x * m_font_w - horizontalScrollBar()->value(), row * m_font_h,
+		 w * m_font_w, h * m_font_h);
+}
+
+/**
+ * @brief Update the scroll bars and geometry after the screen or backlog size changed
+ */
+void vt220::update_view()
+{
+    update_scrollbars();
+    updateGeometry();
+    viewport()->update();
+}
+
+/**
+ * @brief Return the number of rows which fit into the viewport
+ * @return number of rows, at least 1
+ */
+int vt220::visible_rows() const
+{
+    return qMax(1, viewport()->height() / qMax(1, m_font_h));
+}
+
+/**
+ * @brief Return the maximum of the vertical scroll bar
+ * @return first row of backlog plus screen when the bottom of the screen is shown
+ */
+int vt220::scroll_max() const
+{
+    return m_backlog.size() + qMax(0, m_height - visible_rows());
+}
+
+/**
+ * @brief Set the scroll bar ranges
+ * The vertical scroll bar's value is the first row of backlog plus screen
+ * which is displayed; its maximum shows the bottom of the screen, even
+ * if the viewport is shorter than the screen.
+ */
+void vt220::update_scrollbars()
+{
+    QScrollBar* vsb = verticalScrollBar();
+    const bool bottom = vsb->value() >= vsb->maximum();
+    vsb->setSingleStep(1);
+    vsb->setPageStep(visible_rows());
+    vsb->setRange(0, scroll_max());
+    if (bottom)
+	vsb->setValue(vsb->maximum());
+
+    QScrollBar* hsb = horizontalScrollBar();
+    hsb->setSingleStep(m_font_w);
+    hsb->setPageStep(viewport()->width());
+    hsb->setRange(0, qMax(0, m_width * m_font_w - viewport()->width()));
 }
 
 void vt220::paintEvent(QPaintEvent* event)
 {
-    QPainter painter(this);
+    QPainter painter(viewport());
     const int fw = m_font_w;
     const int fh = m_font_h;
     const int bh = m_backlog.size();
-    const QRect rect = event->rect();
+    const int first = verticalScrollBar()->value();
+    const int dx = horizontalScrollBar()->value();
+    // rect in coordinates of the visible rows
+    const QRect rect = event->rect().translated(dx, 0);
     painter.setBackgroundMode(Qt::TransparentMode);
+    painter.translate(-dx, 0);
     painter.setClipRect(rect);
+    painter.fillRect(rect, palette().color(QPalette::Window));
 
     // iterate over rows from rect.top() to rect.bottom()
     for (int sy = (rect.top() / fh) * fh; sy <= rect.bottom(); sy += fh) {
-	const int y = sy / fh;	// cell y
+	const int y = first + sy / fh;	// cell y in backlog plus screen
 
 	if ((y - bh) >= m_height)
 	    break;
@@ -234,11 +382,9 @@ void vt220::paintEvent(QPaintEvent* event)
 		fg = bg;
 	    }
 	    const QRgb fgcolor = m_pal.value(fg);
-	    vtGlyph glyph = m_glyphs.glyph(pa, fgcolor);
-
 	    painter.fillRect(cellrc, QBrush(m_pal.value(bg)));
 	    painter.setPen(fgcolor);
-	    painter.drawImage(cellrc, glyph.img);
+	    painter.drawImage(cellrc, m_glyphs->glyph(pa, fgcolor));
 
 	    // draw an underline?
 	    if (pa.underline() && fg != bg) {
@@ -278,8 +424,7 @@ void vt220::paintEvent(QPaintEvent* event)
 		    // cur.set_code(0x2595);   // RIGHT ONE EIGHT BLOCK
 		    cur.set_code(0x2588);   // FULL BLOCK
 		    cur.set_mark(0);
-		    vtGlyph block = m_glyphs.glyph(cur, color);
-		    painter.drawImage(cellrc, block.img);
+		    painter.drawImage(cellrc, m_glyphs->glyph(cur, color));
 		}
 	    }
 	}
@@ -294,19 +439,73 @@ void vt220::timerEvent(QTimerEvent* event)
     m_cursor.phase = (m_cursor.phase + 1) % 4;
     set_cursor((m_cursor.phase & 2) ? true : false);
     m_blink_phase = !m_blink_phase;
-    update();
+
+    // repaint only the visible cells which blink; set_cursor() took care of the cursor
+    const int dx = horizontalScrollBar()->value();
+    const int dy = verticalScrollBar()->value() * m_font_h;
+    const QRect visible = viewport()->rect().translated(dx, dy);
+    if (m_blink_dirty || visible != m_blink_rect) {
+	m_blink_region = blink_region(visible);
+	m_blink_rect = visible;
+	m_blink_dirty = false;
+    }
+    if (!m_blink_region.isEmpty())
+	viewport()->update(m_blink_region.translated(-dx, -dy));
+}
+
+/**
+ * @brief Collect the cells with the blink attribute inside a rectangle
+ * Adjacent blinking cells of a line are merged into one rectangle.
+ * @param rect rectangle in pixel coordinates of backlog plus screen
+ * @return QRegion covering the blinking cells
+ */
+QRegion vt220::blink_region(const QRect& rect) const
+{
+    QRegion region;
+    if (rect.isEmpty())
+	return region;
+
+    const int fw = m_font_w;
+    const int fh = m_font_h;
+    const int bh = m_backlog.size();
+    const int y0 = qMax(0, rect.top() / fh);
+    const int y1 = qMin(bh + m_height - 1, rect.bottom() / fh);
+    for (int y = y0; y <= y1; y++) {
+	const vtLine& pl = y < bh ? m_backlog[y] : m_screen[y - bh];
+	if (pl.bottom())
+	    continue;
+	const int fwl = pl.decdwl() * fw;
+	const int fhl = pl.decdhl() * fh;
+	const int width = qMin(m_width, pl.size());
+	int x = 0;
+	while (x < width) {
+	    if (!pl[x].blink()) {
+		x++;
+		continue;
+	    }
+	    const int start = x;
+	    while (x < width && pl[x].blink())
+		x++;
+	    region += QRect(start * fwl, y * fh, (x - start) * fwl, fhl);
+	}
+    }
+    return region;
 }
 
 void vt220::add_backlog(const vtLine& line)
 {
+    m_blink_dirty = true;
+    QScrollBar* vsb = verticalScrollBar();
+    const bool bottom = vsb->value() >= vsb->maximum();
+    int first = vsb->value();
     m_backlog.append(line);
     if (m_backlog.count() > m_backlog_max) {
 	m_backlog.removeFirst();
+	first--;
     }
-    const int bh = m_backlog.size();
-    const int sw = m_width * m_font_w;
-    const int sh = (bh + m_height) * m_font_h;
-    resize(sw, sh);
+    // stay at the screen, or keep the displayed backlog rows in place
+    vsb->setRange(0, scroll_max());
+    vsb->setValue(bottom ? vsb->maximum() : qMax(0, first));
 }
 
 /**
@@ -323,13 +522,9 @@ void vt220::outch(int x, int y, const vtAttr& pa)
     if (y < 0 || y >= m_height)
 	return;
     m_screen[y][x] = pa;
+    m_blink_dirty = true;
     const vtLine& pl = m_screen[y];
-    const int bh = m_backlog.size();
-    const int fw = m_font_w * pl.decdwl() * pa.width();
-    const int fh = m_font_h * pl.decdhl();
-    const int x0 = x * m_font_w;
-    const int y0 = (bh + y) * m_font_h;
-    update(x0, y0, fw, fh);
+    viewport()->update(cell_rect(x * pl.decdwl(), y, pl.decdwl() * pa.width(), pl.decdhl()));
 }
 
 /**
@@ -342,23 +537,21 @@ void vt220::outch(int x, int y, const vtAttr& pa)
  */
 void vt220::zap(int x0, int y0, int x1, int y1, quint32 code)
 {
-    const int fw = m_font_w;
-    const int fh = m_font_h;
-    const int bh = m_backlog.size();
     vtAttr space = m_att;
     space.set_code(code);
     space.set_mark(0);
 
-    QRect upd;
+    const QRect upd = y0 == y1 ? cell_rect(x0, y0, x1 - x0 + 1, 1)
+			       : cell_rect(0, y0, m_width, y1 - y0 + 1);
+    m_blink_dirty = true;
     for (int y = y0; y <= y1; y++) {
 	for (int x = x0; x <= x1; x++) {
-	    upd = upd.united(QRect(x*fw, (bh+y)*fh, fw, fh));
 	    m_screen[y][x] = space;
 	}
 	x0 = 0;
 	x1 = m_width - 1;
     }
-    update(upd);
+    viewport()->update(upd);
 }
 
 /**
@@ -390,12 +583,7 @@ void vt220::set_cursor(bool on)
     // update cursor in terminal
     m_cursor.on = on;
     const vtLine& pl = m_screen[m_cursor.y];
-    const int bh = m_backlog.size();
-    const int x = m_cursor.newx * m_font_w;
-    const int y = (bh + m_cursor.y) * m_font_h;
-    const int w = m_font_w * pl.decdwl();
-    const int h = m_font_h * pl.decdhl();
-    update(x, y, w, h);
+    viewport()->update(cell_rect(m_cursor.newx * pl.decdwl(), m_cursor.y, pl.decdwl(), pl.decdhl()));
 }
 
 /**
@@ -434,21 +622,16 @@ void vt220::vt_scroll_dn()
     vtAttr space = m_att;
     space.set_code(32);
     space.set_mark(0);
-    const int fw = m_font_w;
-    const int fh = m_font_h;
-    const int x0 = 0;
-    const int y0 = m_top * fh;
-    const int w0 = m_width * fw;
-    const int h0 = (m_bottom - m_top) * fh;
 
     // scroll down the region
+    m_blink_dirty = true;
     for (int y = m_bottom - 1; y > m_top; y--)
 	m_screen[y] = m_screen[y-1];
     vtLine& pl = m_screen[m_top];
     pl.set_decshl();
     pl.set_decswl();
     pl.fill(space, m_width);
-    update(x0, y0, w0, h0);
+    viewport()->update(cell_rect(0, m_top, m_width, m_bottom - m_top));
 }
 
 /**
@@ -457,17 +640,12 @@ void vt220::vt_scroll_dn()
 void vt220::vt_scroll_up()
 {
     FUN("vt_scroll_up");
-    const int fw = m_font_w;
-    const int fh = m_font_h;
-    const int x0 = 0;
-    const int y0 = m_top * fh;
-    const int w0 = m_width * fw;
-    const int h0 = (m_bottom - m_top) * fh;
 
     if (0 == m_top && m_height == m_bottom) {
 	// scroll up the entire screen
 	add_backlog(m_screen[0]);
     }
+    m_blink_dirty = true;
     for (int y = m_top; y < m_bottom - 1; y++)
 	m_screen[y] = m_screen[y+1];
     vtLine& pl = m_screen[m_bottom - 1];
@@ -477,7 +655,7 @@ void vt220::vt_scroll_up()
     space.set_code(32);
     space.set_mark(0);
     pl.fill(space, m_width);
-    update(x0, y0, w0, h0);
+    viewport()->update(cell_rect(0, m_top, m_width, m_bottom - m_top));
 }
 
 /**
@@ -1648,11 +1826,97 @@ void vt220::set_font(int width, int height, int descend)
     qDebug("%s:     stretch     : %d", __func__, font.stretch());
 #endif
     setFont(font);
-    m_glyphs = vtGlyphs(font, m_font_w, m_font_h);
-    resize(m_width * m_font_w, m_height * m_font_h);
+#if DEBUG_FONTINFO
+    if (m_glyphs) {
+	qDebug("%s: glyph cache     : %d glyphs, %d of %d bytes, %llu hits, %llu misses", __func__,
+	       m_glyphs->count(), m_glyphs->cost(), m_glyphs->budget(),
+	       m_glyphs->hits(), m_glyphs->misses());
+    }
+#endif
+    if (!m_glyphs) {
+	// nothing to show until the worker is done: render on demand
+	m_glyphs.reset(new vtGlyphs(font, m_font_w, m_font_h));
+    }
+    prerender_glyphs(font);
+    update_view();
     emit UpdateSize();
 }
 
+/**
+ * @brief Render the glyphs of a set of codes into a new cache
+ * This runs in a worker thread. Glyphs are rendered into QImage,
+ * which, unlike QPixmap, can be used outside of the GUI thread.
+ * @param font font to use
+ * @param fw width of a glyph cell
+ * @param fh height of a glyph cell
+ * @param codes list of Unicode values to render in normal and bold style
+ * @return shared pointer to the new vtGlyphs
+ */
+static QSharedPointer<vtGlyphs> prerender_worker(const QFont& font, int fw, int fh, const QVector<uint>& codes)
+{
+    QSharedPointer<vtGlyphs> glyphs(new vtGlyphs(font, fw, fh));
+    foreach(const uint code, codes) {
+	vtAttr attr(code);
+	glyphs->prerender(attr);
+	attr.set_bold(true);
+	glyphs->prerender(attr);
+    }
+    return glyphs;
+}
+
+/**
+ * @brief Start pre-rendering the glyphs for @p font in a worker thread
+ *
+ * ASCII, box-drawing and block elements, and the DEC special graphics
+ * and IBM PC character maps are rendered. Until the worker is done, the
+ * previous cache stays in use and its glyphs are scaled to the new cell
+ * size, so changing the font or zoom factor does not stall painting.
+ *
+ * If the platform can't render fonts outside of the GUI thread, a new
+ * cache is used right away and the glyphs are rendered on demand.
+ * @param font font to use
+ */
+void vt220::prerender_glyphs(const QFont& font)
+{
+    if (!QFontDatabase::supportsThreadedFontRendering()) {
+	m_glyphs.reset(new vtGlyphs(font, m_font_w, m_font_h));
+	return;
+    }
+
+    QVector<uint> codes;
+    QSet<uint> seen;
+    for (uint code = 0x20; code < 0x7f; code++)
+	seen.insert(code);
+    for (uint code = 0x2500; code < 0x25a0; code++)
+	seen.insert(code);
+    foreach(const uint code, m_charmaps[MAP_DECGR].values())
+	seen.insert(code);
+    foreach(const uint code, m_charmaps[MAP_IBMPC].values())
+	seen.insert(code);
+    foreach(const uint code, seen) {
+	if (code >= 0x20 && code != DEL)
+	    codes += code;
+    }
+
+    // a running worker can't be stopped; its result is just dropped
+    m_glyphs_watcher.setFuture(QtConcurrent::run(prerender_worker, font, m_font_w, m_font_h, codes));
+}
+
+/**
+ * @brief Swap in the glyphs pre-rendered by the worker thread
+ */
+void vt220::glyphs_prerendered()
+{
+    QSharedPointer<vtGlyphs> glyphs = m_glyphs_watcher.result();
+    if (!glyphs || glyphs->fw() != m_font_w || glyphs->fh() != m_font_h)
+	return;
+#if DEBUG_FONTINFO
+    qDebug("%s: %d glyphs, %d bytes", __func__, glyphs->count(), glyphs->cost());
+#endif
+    m_glyphs = glyphs;
+    viewport()->update();
+}
+
 /**
  * @brief Response with the terminal identifier
  *
@@ -2054,8 +2318,9 @@ void vt220::term_reset(Terminal term, int width, int height)
     m_cursor.newx = 0;
     m_cursor.phase = 0;
     m_cursor.on = false;
+    m_blink_dirty = true;
 
-    resize(m_width * m_font_w, m_height * m_font_h);
+    update_view();
     emit UpdateSize();
 }
 
@@ -2107,7 +2372,8 @@ void vt220::term_set_size(int width, int height)
     m_height = height;
     m_top = 0;
     m_bottom = height;
-    resize(m_width * m_font_w, m_height * m_font_h);
+    m_blink_dirty = true;
+    update_view();
     emit UpdateSize();
 }
 
@@ -2144,7 +2410,8 @@ void vt220::term_set_columns(int width)
     m_width = width;
     m_top = 0;
     m_bottom = m_height;
-    resize(m_width * m_font_w, m_height * m_font_h);
+    m_blink_dirty = true;
+    update_view();
     emit UpdateSize();
 }
 
@@ -2167,7 +2434,8 @@ void vt220::term_set_rows(int height)
     m_height = height;
     m_top = 0;
     m_bottom = height;
-    resize(m_width * m_font_w, m_height * m_font_h);
+    m_blink_dirty = true;
+    update_view();
     emit UpdateSize();
 }
 
@@ -3036,15 +3304,19 @@ void vt220::putch(uchar ch)
 	switch (ch) {
 	case '3':   // ESC # 3  DEC double-height line, top half (DECDHL), VT100.
 	    m_screen[m_cursor.y].set_decdhl(false);
+	    m_blink_dirty = true;
 	    break;
 	case '4':   // ESC # 4  DEC double-height line, bottom half (DECDHL), VT100.
 	    m_screen[m_cursor.y].set_decdhl(true);
+	    m_blink_dirty = true;
 	    break;
 	case '5':   // ESC # 5  DEC single-width line (DECSWL), VT100.
 	    m_screen[m_cursor.y].set_decswl();
+	    m_blink_dirty = true;
 	    break;
 	case '6':   // ESC # 6  DEC double-width line (DECDWL), VT100.
 	    m_screen[m_cursor.y].set_decdwl();
+	    m_blink_dirty = true;
 	    break;
 	case '8':   // ESC # 8	DEC screen alignment test
 	    break;
@@ -3057,6 +3329,154 @@ void vt220::putch(uchar ch)
     }
 }
 
+/**
+ * @brief Take a snapshot of the emulation state
+ * @return Snapshot with copies of the backlog, screen, cursor, attributes, and modes
+ */
+vt220::Snapshot vt220::snapshot() const
+{
+    Snapshot snap;
+    snap.terminal = m_terminal;
+    snap.backlog = m_backlog;
+    snap.screen = m_screen;
+    snap.width = m_width;
+    snap.height = m_height;
+    snap.top = m_top;
+    snap.bottom = m_bottom;
+    snap.conceal_off = m_conceal_off;
+    snap.palsize = m_palsize;
+    snap.pal = m_pal;
+    snap.def = m_def;
+    snap.att = m_att;
+    snap.att_saved = m_att_saved;
+    snap.cursor = m_cursor;
+    snap.cursor_saved = m_cursor_saved;
+    snap.cc_mask = m_cc_mask;
+    snap.cc_save = m_cc_save;
+    snap.cursor_type = m_cursor_type;
+    snap.string = m_string;
+    snap.csi_args = m_csi_args;
+    snap.tabstop = m_tabstop;
+    snap.state = m_state;
+    snap.deccolm = m_deccolm;
+    snap.ques = m_ques;
+    snap.decscnm = m_decscnm;
+    snap.togmeta = m_togmeta;
+    snap.deccm = m_deccm;
+    snap.decim = m_decim;
+    snap.decom = m_decom;
+    snap.deccr = m_deccr;
+    snap.decckm = m_decckm;
+    snap.decawm = m_decawm;
+    snap.decarm = m_decarm;
+    snap.repmouse = m_repmouse;
+    snap.dspctrl = m_dspctrl;
+    snap.s8c1t = m_s8c1t;
+    snap.ansi = m_ansi;
+    snap.uc = m_uc;
+    snap.hc = m_hc;
+    snap.bell_pitch = m_bell_pitch;
+    snap.bell_duration = m_bell_duration;
+    snap.blank_time = m_blank_time;
+    snap.vesa_time = m_vesa_time;
+    snap.gmaps = m_gmaps;
+    snap.trans = m_trans;
+    snap.shift = m_shift;
+    snap.utf_mode = m_utf_mode;
+    snap.utf_more = m_utf_more;
+    snap.utf_code = m_utf_code;
+    snap.utf_code_min = m_utf_code_min;
+    return snap;
+}
+
+/**
+ * @brief Restore the emulation state from a snapshot
+ * @param snap const reference to the Snapshot
+ */
+void vt220::restore(const Snapshot& snap)
+{
+    const bool resized = snap.width != m_width || snap.height != m_height;
+    m_terminal = snap.terminal;
+    m_backlog = snap.backlog;
+    m_screen = snap.screen;
+    m_width = snap.width;
+    m_height = snap.height;
+    m_top = snap.top;
+    m_bottom = snap.bottom;
+    m_conceal_off = snap.conceal_off;
+    m_palsize = snap.palsize;
+    m_pal = snap.pal;
+    m_def = snap.def;
+    m_att = snap.att;
+    m_att_saved = snap.att_saved;
+    m_cursor = snap.cursor;
+    m_cursor_saved = snap.cursor_saved;
+    m_cc_mask = snap.cc_mask;
+    m_cc_save = snap.cc_save;
+    m_cursor_type = snap.cursor_type;
+    m_string = snap.string;
+    m_csi_args = snap.csi_args;
+    m_tabstop = snap.tabstop;
+    m_state = snap.state;
+    m_deccolm = snap.deccolm;
+    m_ques = snap.ques;
+    m_decscnm = snap.decscnm;
+    m_togmeta = snap.togmeta;
+    m_deccm = snap.deccm;
+    m_decim = snap.decim;
+    m_decom = snap.decom;
+    m_deccr = snap.deccr;
+    m_decckm = snap.decckm;
+    m_decawm = snap.decawm;
+    m_decarm = snap.decarm;
+    m_repmouse = snap.repmouse;
+    m_dspctrl = snap.dspctrl;
+    m_s8c1t = snap.s8c1t;
+    m_ansi = snap.ansi;
+    m_uc = snap.uc;
+    m_hc = snap.hc;
+    m_bell_pitch = snap.bell_pitch;
+    m_bell_duration = snap.bell_duration;
+    m_blank_time = snap.blank_time;
+    m_vesa_time = snap.vesa_time;
+    m_gmaps = snap.gmaps;
+    m_trans = snap.trans;
+    m_shift = snap.shift;
+    m_utf_mode = snap.utf_mode;
+    m_utf_more = snap.utf_more;
+    m_utf_code = snap.utf_code;
+    m_utf_code_min = snap.utf_code_min;
+    m_blink_dirty = true;
+    update_view();
+    if (resized)
+	emit UpdateSize();
+}
+
+/**
+ * @brief Toggle inverse video of cells written before the cursor
+ * The cells are counted backwards from the cursor, wrapping to the
+ * previous rows, so this marks text which was just written.
+ * @param cells number of cells to toggle
+ * @param skip number of cells before the cursor to leave alone
+ */
+void vt220::highlight(int cells, int skip)
+{
+    int x = qMin(m_cursor.newx, m_width);
+    int y = m_cursor.y;
+    for (int i = 0; i < skip + cells; i++) {
+	if (--x < 0) {
+	    if (--y < 0)
+		return;
+	    x = m_width - 1;
+	}
+	if (i < skip || y >= m_height)
+	    continue;
+	vtAttr pa = m_screen[y][x];
+	pa.set_inverse(!pa.inverse());
+	outch(x, y, pa);
+    }
+}
+
 int vt220::write(const QByteArray& data)
 {
     FUN("write(QByteArray)");
@@ -9,13 +9,17 @@
 #pragma once
 #include <QObject>
 #include <QWidget>
+#include <QAbstractScrollArea>
 #include <QBitArray>
 #include <QBitmap>
+#include <QRegion>
 #include <QPainter>
 #include <QEvent>
 #include <QPaintEvent>
 #include <QTimerEvent>
 #include <QKeyEvent>
+#include <QSharedPointer>
+#include <QFutureWatcher>
 
 #include "vtchar.h"
 #include "vtline.h"
@@ -24,7 +28,15 @@
 
 typedef QHash<uchar,uint> cmapHash;
 
-class vt220 : public QWidget
+/**
+ * @brief The vt220 class emulates a VT220 (and variants) terminal.
+ *
+ * The view is a QAbstractScrollArea with a viewport the size of the screen.
+ * The vertical scroll bar selects the first row of backlog plus screen
+ * which is displayed, so the depth of the backlog is limited only by
+ * memory and scrolling costs the same for any depth.
+ */
+class vt220 : public QAbstractScrollArea
 {
     Q_OBJECT
 public:
@@ -56,22 +68,83 @@ public:
 	bool on;
     };
 
+    /**
+     * @brief The state of the emulation: backlog and screen contents, cursor,
+     * attributes, modes, and the decoder state.
+     * The pages are implicitly shared, so taking a snapshot is cheap.
+     */
+    struct Snapshot {
+	Terminal terminal;
+	vtPage backlog;
+	vtPage screen;
+	int width;
+	int height;
+	int top;
+	int bottom;
+	bool conceal_off;
+	qint32 palsize;
+	QVector<QRgb> pal;
+	vtAttr def;
+	vtAttr att;
+	vtAttr att_saved;
+	Cursor cursor;
+	Cursor cursor_saved;
+	qint32 cc_mask;
+	qint32 cc_save;
+	quint32 cursor_type;
+	QString string;
+	QVector<int> csi_args;
+	QBitArray tabstop;
+	qint32 state;
+	qint32 deccolm;
+	bool ques;
+	bool decscnm;
+	bool togmeta;
+	bool deccm;
+	bool decim;
+	bool decom;
+	bool deccr;
+	bool decckm;
+	bool decawm;
+	bool decarm;
+	bool repmouse;
+	bool dspctrl;
+	bool s8c1t;
+	qint32 ansi;
+	qint32 uc;
+	qint32 hc;
+	qint32 bell_pitch;
+	qint32 bell_duration;
+	qint32 blank_time;
+	qint32 vesa_time;
+	QVector<cmapHash> gmaps;
+	cmapHash trans;
+	int shift;
+	bool utf_mode;
+	int utf_more;
+	uint utf_code;
+	uint utf_code_min;
+    };
+
     explicit vt220(QWidget* parent = nullptr);
 
-    QSize sizeHint() const override;
     QString font_family() const;
     QSize term_geometry() const;
     int zoom() const;
+    int backlog_max() const;
+    Snapshot snapshot() const;
+    void restore(const Snapshot& snap);
+    void highlight(int cells, int skip = 0);
     int vprintf(const char *fmt, va_list ap);
     int printf(const char *fmt, ...);
 
 signals:
     void term_response(QByteArray response);
-    void UpdateCursor(const QRect& rect);
     void UpdateSize();
 
 public slots:
     void clear();
+    void reset_decoder();
     void set_font(int width, int height, int descend);
     void term_reset(Terminal term = VT200, int width = 80, int height = 25);
     void term_set_size(int width = -1, int height = -1);
@@ -85,12 +158,18 @@ public slots:
     void display_maps();
     void set_font_family(const QString& family);
     void set_zoom(int percent);
+    void set_backlog_max(int lines);
     void cursor_slot();
 
+private slots:
+    void glyphs_prerendered();
+
 protected:
     bool event(QEvent* event) override;
     void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
     void timerEvent(QTimerEvent* event) override;
+    QSize viewportSizeHint() const override;
 
 private:
     static constexpr int font_w = 9;
@@ -182,6 +261,9 @@ private:
     int m_blink_timer;					//!< blink timer id
     qint64 m_screen_time;				//!< screen off seconds since epoch
     bool m_blink_phase;					//!< blink on/off phase
+    bool m_blink_dirty;					//!< cells changed since m_blink_region was collected
+    QRect m_blink_rect;					//!< visible rectangle (backlog plus screen) m_blink_region was collected for
+    QRegion m_blink_region;				//!< visible cells with the blink attribute (backlog plus screen)
     bool m_conceal_off;					//!< concealed display off
     int m_zoom;						//!< Zoom factor in percent
     int m_font_w;					//!< Width of a glyph cell in pixels
@@ -193,7 +275,8 @@ private:
     int m_bottom;					//!< Scroll range bottom line (zero based)
     qint32 m_palsize;					//!< Size of palette
     QVector<QRgb> m_pal;				//!< Palette colors
-    vtGlyphs m_glyphs;					//!< QHash of glyphs, i.e. rendered QImages of the font
+    QSharedPointer<vtGlyphs> m_glyphs;			//!< QCache of glyphs, i.e. rendered alpha masks of the font
+    QFutureWatcher<QSharedPointer<vtGlyphs>> m_glyphs_watcher;	//!< Watcher for the glyphs being pre-rendered
     vtAttr m_def;					//!< Default attributes
     vtAttr m_att;					//!< Current attributes
     vtAttr m_att_saved;					//!< Saved attributes
@@ -238,6 +321,13 @@ private:
     uint m_utf_code_min;				//!< Unicode UTF-8 minimum code for given # of encoded bytes
 
     void add_backlog(const vtLine& line);
+    QRegion blink_region(const QRect& rect) const;
+    QRect cell_rect(int x, int y, int w = 1, int h = 1) const;
+    void update_view();
+    void prerender_glyphs(const QFont& font);
+    int visible_rows() const;
+    int scroll_max() const;
+    void update_scrollbars();
     void update_cell(int x, int y);
     void outch(int x, int y, const vtAttr& pa);
     void zap(int x0, int y0, int x1, int y1, quint32 code);
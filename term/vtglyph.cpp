@@ -9,7 +9,7 @@
 #include <QPainter>
 #include "vtglyph.h"
 
-vtGlyph::vtGlyph(const vtAttr& _attr, const QFont& font, const int fw, const int fh, QRgb fg)
+vtGlyph::vtGlyph(const vtAttr& _attr, const QFont& font, const int fw, const int fh)
     : attr(_attr)
     , bbx()
     , img()
@@ -24,21 +24,20 @@ vtGlyph::vtGlyph(const vtAttr& _attr, const QFont& font, const int fw, const int
 	width = 1;
     }
     bbx = QRect(0, 0, width*fw, fh);
-    render(font, fg);
+    render(font);
 }
 
 /**
- * @brief Render the glyph using the specified @p font and foreground color @p fg
+ * @brief Render the glyph as an alpha mask using the specified @p font
  * @param font font to use
- * @param fg QRgb of the foreground color
  */
-void vtGlyph::render(const QFont& font, QRgb fg)
+void vtGlyph::render(const QFont& font)
 {
-    QImage buff(bbx.size(), QImage::Format_ARGB32);
+    QImage buff(bbx.size(), QImage::Format_ARGB32_Premultiplied);
     buff.fill(Qt::transparent);
     QPainter painter(&buff);
     painter.setBackgroundMode(Qt::TransparentMode);
-    painter.setPen(QColor(fg));
+    painter.setPen(QColor(Qt::white));
     painter.setFont(font);
     const int pw = painter.pen().width();
     painter.drawText(bbx.adjusted(0,0,pw,pw), Qt::AlignLeft | Qt::AlignTop, attr.code());
@@ -46,5 +45,5 @@ void vtGlyph::render(const QFont& font, QRgb fg)
 	painter.drawText(bbx.adjusted(0,0,pw,pw), Qt::AlignLeft | Qt::AlignTop, attr.mark());
     }
     painter.end();
-    img = buff.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    img = buff.convertToFormat(QImage::Format_Alpha8);
 }
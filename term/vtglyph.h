@@ -15,11 +15,14 @@
 /**
  * @brief The vtGlyph class contains a QImage with the rendered glyph for a Unicode value.
  *
+ * The image is an 8 bit alpha mask (QImage::Format_Alpha8), so the same
+ * glyph can be drawn in any color.
+ *
  * <ul>
  * <li>QChar with the Unicode character code in @ref code.</li>
  * <li>QChar with the Unicode mark code in @ref mark.</li>
  * <li>Bounding box QRect in @ref bbx..</li>
- * <li>Rendered QImage in @ref img..</li>
+ * <li>Rendered alpha mask QImage in @ref img..</li>
  * <li>Width in cells in @ref width (1 or 2)..</li>
  * </ul>
  */
@@ -29,8 +32,7 @@ public:
     explicit vtGlyph(const vtAttr& _attr = vtAttr(),
 		     const QFont& font = QFont(),
 		     const int fw = 8,
-		     const int fh = 16,
-		     QRgb fg = Qt::white);
+		     const int fh = 16);
     vtAttr attr;
     QChar mark;
     QRect bbx;
@@ -38,5 +40,5 @@ public:
     int width;
 
 private:
-    void render(const QFont& font, QRgb fg);
+    void render(const QFont& font);
 };
@@ -10,22 +10,32 @@
 
 /**
  * @brief vtGlyphIdx constructor
- * @param uc Unicode value
- * @param fg foreground color
  * @param attr glyph attributes
  */
-vtGlyphIdx::vtGlyphIdx(const vtAttr& attr, QRgb fg)
-    : m_attr(attr)
-    , m_fg(fg)
+vtGlyphIdx::vtGlyphIdx(const vtAttr& attr)
+    : m_code(attr.code().unicode())
+    , m_mark(attr.mark().unicode())
+    , m_style((attr.bold() ? 1 : 0) | (attr.italic() ? 2 : 0))
+    , m_width(attr.width())
 {
 }
 
-QRgb vtGlyphIdx::fg() const
+ushort vtGlyphIdx::code() const
 {
-    return m_fg;
+    return m_code;
 }
 
-vtAttr vtGlyphIdx::attr() const
+ushort vtGlyphIdx::mark() const
 {
-    return m_attr;
+    return m_mark;
+}
+
+uchar vtGlyphIdx::style() const
+{
+    return m_style;
+}
+
+uchar vtGlyphIdx::width() const
+{
+    return m_width;
 }
@@ -11,28 +11,41 @@
 #include "vtattr.h"
 
 /**
- * @brief The vtGlyphIdx class creates an index from a Unicode value @ref m_uc,
- * a foreground color QRgb @ref m_fg, and a set of VT attributes @ref m_attr.
+ * @brief The vtGlyphIdx class creates an index from the attributes
+ * which change the shape of a glyph: Unicode value @ref m_code, mark
+ * @ref m_mark, bold and italic in @ref m_style, and cell width @ref m_width.
  *
- * The index is used to lookup rendered glyphs in the cache @ref vtGlyps.
+ * Colors are not part of the index, because glyphs are cached as
+ * alpha masks and tinted when drawn.
+ * The index is used to lookup rendered glyphs in the cache @ref vtGlyphs.
  */
 class vtGlyphIdx
 {
 public:
-    vtGlyphIdx(const vtAttr& attr = vtAttr(), QRgb fg = Qt::white);
-    vtAttr attr() const;
-    QRgb fg() const;
+    vtGlyphIdx(const vtAttr& attr = vtAttr());
+    ushort code() const;
+    ushort mark() const;
+    uchar style() const;
+    uchar width() const;
 private:
-    vtAttr m_attr;
-    QRgb m_fg;
+    ushort m_code;
+    ushort m_mark;
+    uchar m_style;
+    uchar m_width;
 };
 
 inline bool operator==(const vtGlyphIdx& i1, const vtGlyphIdx& i2)
 {
-    return i1.attr() == i2.attr() && i1.fg() == i2.fg();
+    return i1.code() == i2.code() &&
+	    i1.mark() == i2.mark() &&
+	    i1.style() == i2.style() &&
+	    i1.width() == i2.width();
 }
 
 inline uint qHash(const vtGlyphIdx &key, uint seed)
 {
-    return qHash(key.attr(), seed) ^ qHash(key.fg());
+    return qHash((static_cast<quint64>(key.code()) << 32) |
+		 (static_cast<quint64>(key.mark()) << 16) |
+		 (static_cast<quint64>(key.style()) << 8) |
+		 key.width(), seed);
 }
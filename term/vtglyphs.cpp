@@ -1,6 +1,6 @@
 /*****************************************************************************
  *
- *  VT - Virtual Terminal glyph hash
+ *  VT - Virtual Terminal glyph cache
  * Copyright © 2013-2021 Jürgen Buchmüller <pullmoll@t-online.de>
  *
  * See the file LICENSE for the details of the BSD-3-Clause terms.
@@ -8,28 +8,211 @@
  *****************************************************************************/
 #include "vtglyphs.h"
 
-vtGlyphs::vtGlyphs(const QFont& font, int fw, int fh)
-    : m_glyphs()
+vtGlyphs::vtGlyphs(const QFont& font, int fw, int fh, int budget)
+    : m_glyphs(budget)
+    , m_tinted(tinted_budget)
+    , m_uncached()
+    , m_tint_fg(0)
+    , m_tint()
+    , m_hits(0)
+    , m_misses(0)
     , m_font(font)
     , m_fw(fw)
     , m_fh(fh)
 {
+    // force a rebuild of the lookup table on first use
+    m_tint_fg = ~qRgba(0, 0, 0, 0);
 }
 
 void vtGlyphs::clear()
 {
     m_glyphs.clear();
+    m_tinted.clear();
 }
 
-const vtGlyph& vtGlyphs::glyph(const vtAttr& attr, QRgb fg) const
+/**
+ * @brief Return the glyph for @p attr tinted with the foreground color @p fg
+ * The tinted glyph is taken from the cache, or tinted once and cached.
+ * The returned image is valid until the next call.
+ * @param attr const reference to the vtAttr with code, mark, and style
+ * @param fg QRgb of the foreground color
+ * @return const reference to a QImage in Format_ARGB32_Premultiplied
+ */
+const QImage& vtGlyphs::glyph(const vtAttr& attr, QRgb fg) const
 {
-    vtGlyphIdx idx(attr, fg);
-    if (!m_glyphs.contains(idx)) {
-	QFont font(m_font);
-	font.setBold(attr.bold());
-	font.setItalic(attr.italic());
-	vtGlyph glyph(attr, font, m_fw, m_fh, fg);
-	m_glyphs.insert(idx, glyph);
+    const vtGlyphIdx idx(attr);
+    const vtTintIdx tidx(idx, fg);
+    const QImage* tinted = m_tinted.object(tidx);
+    if (tinted) {
+	m_hits++;
+	return *tinted;
     }
-    return m_glyphs[idx];
+
+    QImage* img = nullptr;
+    const vtGlyph* cached = m_glyphs.object(idx);
+    if (cached) {
+	m_hits++;
+	img = new QImage(tint(cached->img, fg));
+    } else {
+	m_misses++;
+	vtGlyph* glyph = render(attr);
+	const int cost = static_cast<int>(glyph->img.sizeInBytes());
+	img = new QImage(tint(glyph->img, fg));
+	if (cost > m_glyphs.maxCost()) {
+	    // larger than the budget: QCache::insert() would delete it
+	    delete glyph;
+	} else {
+	    m_glyphs.insert(idx, glyph, cost);
+	}
+    }
+
+    const int cost = static_cast<int>(img->sizeInBytes());
+    if (cost > m_tinted.maxCost()) {
+	m_uncached = *img;
+	delete img;
+	return m_uncached;
+    }
+    m_tinted.insert(tidx, img, cost);
+    return *img;
+}
+
+/**
+ * @brief Render the glyph for @p attr into the cache, unless it is cached already
+ * This does not count as a hit or miss and can be used from a worker thread.
+ * @param attr const reference to the vtAttr with code, mark, and style
+ */
+void vtGlyphs::prerender(const vtAttr& attr)
+{
+    const vtGlyphIdx idx(attr);
+    if (m_glyphs.contains(idx))
+	return;
+    vtGlyph* glyph = render(attr);
+    const int cost = static_cast<int>(glyph->img.sizeInBytes());
+    if (cost > m_glyphs.maxCost()) {
+	delete glyph;
+    } else {
+	m_glyphs.insert(idx, glyph, cost);
+    }
+}
+
+/**
+ * @brief Return the font used to render the glyphs
+ * @return QFont
+ */
+QFont vtGlyphs::font() const
+{
+    return m_font;
+}
+
+/**
+ * @brief Return the width of a glyph cell
+ * @return width in pixels
+ */
+int vtGlyphs::fw() const
+{
+    return m_fw;
+}
+
+/**
+ * @brief Return the height of a glyph cell
+ * @return height in pixels
+ */
+int vtGlyphs::fh() const
+{
+    return m_fh;
+}
+
+/**
+ * @brief Return the budget of the cache in bytes
+ * @return maximum size of all cached masks
+ */
+int vtGlyphs::budget() const
+{
+    return m_glyphs.maxCost();
+}
+
+/**
+ * @brief Set the budget of the cache in bytes
+ * Least recently used glyphs are evicted if the cache is larger.
+ * @param budget maximum size of all cached masks
+ */
+void vtGlyphs::set_budget(int budget)
+{
+    m_glyphs.setMaxCost(budget);
+}
+
+/**
+ * @brief Return the size of all cached masks in bytes
+ * @return total cost
+ */
+int vtGlyphs::cost() const
+{
+    return m_glyphs.totalCost();
+}
+
+/**
+ * @brief Return the number of cached glyphs
+ * @return number of glyphs
+ */
+int vtGlyphs::count() const
+{
+    return m_glyphs.count();
+}
+
+/**
+ * @brief Return the number of glyph() calls which found the glyph in the cache
+ * @return number of hits
+ */
+quint64 vtGlyphs::hits() const
+{
+    return m_hits;
+}
+
+/**
+ * @brief Return the number of glyph() calls which had to render the glyph
+ * @return number of misses
+ */
+quint64 vtGlyphs::misses() const
+{
+    return m_misses;
+}
+
+/**
+ * @brief Render a new glyph for @p attr with the bold and italic variant of the font
+ * @param attr const reference to the vtAttr with code, mark, and style
+ * @return pointer to a new vtGlyph
+ */
+vtGlyph* vtGlyphs::render(const vtAttr& attr) const
+{
+    QFont font(m_font);
+    font.setBold(attr.bold());
+    font.setItalic(attr.italic());
+    return new vtGlyph(attr, font, m_fw, m_fh);
+}
+
+/**
+ * @brief Tint an alpha mask with a color
+ * A table of premultiplied colors for all alpha values is kept for the
+ * last color, so consecutive glyphs with the same color cost one lookup
+ * per pixel.
+ * @param mask const reference to the QImage in Format_Alpha8
+ * @param fg QRgb of the foreground color
+ * @return QImage in Format_ARGB32_Premultiplied
+ */
+QImage vtGlyphs::tint(const QImage& mask, QRgb fg) const
+{
+    if (fg != m_tint_fg) {
+	for (int a = 0; a < 256; a++)
+	    m_tint[a] = qPremultiply(qRgba(qRed(fg), qGreen(fg), qBlue(fg), a));
+	m_tint_fg = fg;
+    }
+    QImage tinted(mask.size(), QImage::Format_ARGB32_Premultiplied);
+    const int w = mask.width();
+    for (int y = 0; y < mask.height(); y++) {
+	const uchar* src = mask.constScanLine(y);
+	QRgb* dst = reinterpret_cast<QRgb*>(tinted.scanLine(y));
+	for (int x = 0; x < w; x++)
+	    dst[x] = m_tint[src[x]];
+    }
+    return tinted;
 }
@@ -1,30 +1,72 @@
 /*****************************************************************************
  *
- *  VT - Virtual Terminal glyph hash
+ *  VT - Virtual Terminal glyph cache
  * Copyright © 2013-2021 Jürgen Buchmüller <pullmoll@t-online.de>
  *
  * See the file LICENSE for the details of the BSD-3-Clause terms.
  *
  *****************************************************************************/
 #pragma once
+#include <QCache>
+#include <QPair>
 #include "vtglyph.h"
 #include "vtglyphidx.h"
 
 /**
- * @brief The vtGlyphs class implements a QHash of @ref vtGlyph by their @ref vtGlypIdx.
+ * @brief Index of a tinted glyph: the glyph's index and the foreground color
+ */
+typedef QPair<vtGlyphIdx,QRgb> vtTintIdx;
+
+/**
+ * @brief The vtGlyphs class implements a cache of @ref vtGlyph by their @ref vtGlyphIdx.
  *
  * The class is used to avoid repeated rendering of glyphs using the
- * same Unicode value, font, foreground color
+ * same Unicode value, mark, style, and width. Glyphs are cached as alpha
+ * masks, and the masks tinted with a foreground color are kept in a
+ * second cache, so a glyph is tinted only once for each color it is
+ * drawn with. Both caches have a budget in bytes and evict the least
+ * recently used images when the budget is exceeded.
+ *
+ * An instance can be filled with @ref prerender in a worker thread, because
+ * the glyphs are rendered into QImage, and then be handed over to the GUI
+ * thread. Only one thread may use an instance at any time.
  */
 class vtGlyphs
 {
 public:
-    explicit vtGlyphs(const QFont& font = QFont(), int fw = 8, int fh = 12);
+    static constexpr int default_budget = 4 * 1024 * 1024;
+    static constexpr int tinted_budget = 8 * 1024 * 1024;
+
+    explicit vtGlyphs(const QFont& font = QFont(), int fw = 8, int fh = 12,
+		      int budget = default_budget);
     void clear();
-    const vtGlyph& glyph(const vtAttr& attr = vtAttr(), QRgb fg = Qt::white) const;
+    const QImage& glyph(const vtAttr& attr = vtAttr(), QRgb fg = Qt::white) const;
+    void prerender(const vtAttr& attr);
+
+    QFont font() const;
+    int fw() const;
+    int fh() const;
+
+    int budget() const;
+    void set_budget(int budget);
+    int cost() const;
+    int count() const;
+    quint64 hits() const;
+    quint64 misses() const;
+
 private:
-    mutable QHash<vtGlyphIdx,vtGlyph> m_glyphs;
+    Q_DISABLE_COPY(vtGlyphs)
+    mutable QCache<vtGlyphIdx,vtGlyph> m_glyphs;	//!< alpha masks; cost is their size in bytes
+    mutable QCache<vtTintIdx,QImage> m_tinted;	//!< tinted glyphs; cost is their size in bytes
+    mutable QImage m_uncached;			//!< the last tinted glyph which was too large to be cached
+    mutable QRgb m_tint_fg;			//!< color of the tint lookup table
+    mutable QRgb m_tint[256];			//!< premultiplied color for each alpha value
+    mutable quint64 m_hits;			//!< number of glyphs found in the cache
+    mutable quint64 m_misses;			//!< number of glyphs which had to be rendered
     QFont m_font;
     int m_fw;
     int m_fh;
+
+    vtGlyph* render(const vtAttr& attr) const;
+    QImage tint(const QImage& mask, QRgb fg) const;
 };
@@ -0,0 +1,307 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 triggers on the received serial data
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#include <QObject>
+#include <QQueue>
+#include "triggers.h"
+
+#define	DEBUG_TRIGGERS	0
+
+#if defined(DEBUG_TRIGGERS) && (DEBUG_TRIGGERS != 0)
+#define	DBG_TRIGGERS(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_TRIGGERS(X,...) /* X */
+#endif
+
+Triggers::Triggers()
+    : m_triggers()
+    , m_literals()
+    , m_regexes()
+    , m_error()
+    , m_dirty(true)
+    , m_delta()
+    , m_output()
+    , m_dict()
+    , m_fire()
+    , m_state(0)
+    , m_line()
+{
+}
+
+/**
+ * @brief Remove all triggers
+ */
+void Triggers::clear()
+{
+    m_triggers.clear();
+    m_literals.clear();
+    m_regexes.clear();
+    m_error.clear();
+    m_dirty = true;
+    reset();
+}
+
+/**
+ * @brief Add a trigger
+ * @param trigger const reference to the Trigger
+ * @return true on success, or false if the pattern is empty, invalid, or a duplicate literal
+ */
+bool Triggers::add(const Trigger& trigger)
+{
+    if (trigger.pattern.isEmpty()) {
+	m_error = QObject::tr("Trigger '%1' has an empty pattern.").arg(trigger.name);
+	return false;
+    }
+    const int index = m_triggers.count();
+    if (trigger.regex) {
+	QRegularExpression re(trigger.pattern);
+	if (!re.isValid()) {
+	    m_error = QObject::tr("Trigger '%1' has an invalid regular expression: %2")
+		      .arg(trigger.name)
+		      .arg(re.errorString());
+	    return false;
+	}
+	re.optimize();
+	m_regexes += qMakePair(index, re);
+    } else {
+	// a state of the automaton reports only one trigger
+	foreach(int other, m_literals) {
+	    if (m_triggers[other].pattern == trigger.pattern) {
+		m_error = QObject::tr("Trigger '%1' has the same pattern as trigger '%2'.")
+			  .arg(trigger.name)
+			  .arg(m_triggers[other].name);
+		return false;
+	    }
+	}
+	m_literals += index;
+	m_dirty = true;
+    }
+    m_triggers += trigger;
+    return true;
+}
+
+/**
+ * @brief Return true if there are no triggers
+ * @return true if empty
+ */
+bool Triggers::isEmpty() const
+{
+    return m_triggers.isEmpty();
+}
+
+/**
+ * @brief Return the number of triggers
+ * @return number of triggers
+ */
+int Triggers::count() const
+{
+    return m_triggers.count();
+}
+
+/**
+ * @brief Return a trigger
+ * @param index index of the trigger
+ * @return const reference to the Trigger
+ */
+const Triggers::Trigger& Triggers::trigger(int index) const
+{
+    return m_triggers[index];
+}
+
+/**
+ * @brief Return the most recent error message
+ * @return error message
+ */
+QString Triggers::error_string() const
+{
+    return m_error;
+}
+
+/**
+ * @brief Forget partial matches, e.g. after the device was reopened
+ */
+void Triggers::reset()
+{
+    m_state = 0;
+    m_line.clear();
+}
+
+/**
+ * @brief Scan a chunk of received data
+ * @param data const reference to the chunk
+ * @return QVector of matches ordered by their end
+ */
+QVector<Triggers::Match> Triggers::scan(const QByteArray& data)
+{
+    QVector<Match> matches;
+    if (m_dirty)
+	build();
+
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData());
+    const int size = data.size();
+    const qint32* delta = m_delta.constData();
+    const char* fire = m_fire.constData();
+    const bool lines = !m_regexes.isEmpty();
+    qint32 state = m_state;
+    int start = 0;
+    for (int i = 0; i < size; i++) {
+	const uchar b = p[i];
+	state = delta[(state << 8) | b];
+	if (lines && (b == '\n' || b == '\r')) {
+	    // the line's matches end before the terminator
+	    m_line.append(reinterpret_cast<const char*>(p + start), qMin(i - start, max_line - m_line.size()));
+	    match_line(i, matches);
+	    start = i + 1;
+	}
+	if (fire[state]) {
+	    for (qint32 s = m_output[state] >= 0 ? state : m_dict[state]; s >= 0; s = m_dict[s]) {
+		const Trigger& t = m_triggers[m_output[s]];
+		Match m;
+		m.trigger = m_output[s];
+		m.end = i + 1;
+		m.cells = t.pattern.length();
+		m.skip = 0;
+		m.text = t.pattern;
+		DBG_TRIGGERS("%s: literal '%s' at %d", __func__, qPrintable(t.name), m.end);
+		matches += m;
+	    }
+	}
+    }
+    if (lines && start < size)
+	m_line.append(reinterpret_cast<const char*>(p + start), qMin(size - start, max_line - m_line.size()));
+    m_state = state;
+    return matches;
+}
+
+static const QList<QPair<int,QLatin1String>> action_ids = {
+    {Triggers::Act_Highlight,	QLatin1String("highlight")},
+    {Triggers::Act_Bell,	QLatin1String("bell")},
+    {Triggers::Act_Log,		QLatin1String("log")},
+    {Triggers::Act_Respond,	QLatin1String("respond")},
+};
+
+/**
+ * @brief Convert a list of action names to a bit mask
+ * @param names const reference to a QStringList like "highlight", "log"
+ * @return bit mask of Action values; unknown names are ignored
+ */
+int Triggers::actions(const QStringList& names)
+{
+    int result = Act_None;
+    foreach(const QString& name, names) {
+	for (int i = 0; i < action_ids.count(); i++) {
+	    if (0 == name.trimmed().compare(action_ids[i].second, Qt::CaseInsensitive))
+		result |= action_ids[i].first;
+	}
+    }
+    return result;
+}
+
+/**
+ * @brief Convert a bit mask of actions to a list of names
+ * @param actions bit mask of Action values
+ * @return QStringList with the names
+ */
+QStringList Triggers::action_names(int actions)
+{
+    QStringList result;
+    for (int i = 0; i < action_ids.count(); i++) {
+	if (actions & action_ids[i].first)
+	    result += action_ids[i].second;
+    }
+    return result;
+}
+
+/**
+ * @brief Build the Aho-Corasick automaton of the literal triggers
+ *
+ * The goto function of the trie is completed with the fail transitions,
+ * so the automaton is a DFA and scanning never follows fail links.
+ */
+void Triggers::build()
+{
+    m_delta.fill(0, 256);
+    m_output.fill(-1, 1);
+    m_dict.fill(-1, 1);
+
+    // build the trie; state 0 is the root and no state moves back to it
+    foreach(int index, m_literals) {
+	const QByteArray pattern = m_triggers[index].pattern.toUtf8();
+	qint32 state = 0;
+	foreach(char ch, pattern) {
+	    const int pos = (state << 8) | static_cast<uchar>(ch);
+	    if (!m_delta[pos]) {
+		m_delta[pos] = m_output.count();
+		m_delta.resize(m_delta.count() + 256);
+		m_output += -1;
+		m_dict += -1;
+	    }
+	    state = m_delta[pos];
+	}
+	// add() refuses duplicate literals
+	Q_ASSERT(m_output[state] < 0);
+	m_output[state] = index;
+    }
+
+    // breadth first: fail states, dictionary links, and missing transitions
+    QVector<qint32> fail(m_output.count(), 0);
+    QQueue<qint32> queue;
+    for (int b = 0; b < 256; b++) {
+	if (m_delta[b])
+	    queue.enqueue(m_delta[b]);
+    }
+    while (!queue.isEmpty()) {
+	const qint32 state = queue.dequeue();
+	for (int b = 0; b < 256; b++) {
+	    const int pos = (state << 8) | b;
+	    const qint32 next = m_delta[pos];
+	    const qint32 alt = m_delta[(fail[state] << 8) | b];
+	    if (next) {
+		fail[next] = alt;
+		m_dict[next] = m_output[alt] >= 0 ? alt : m_dict[alt];
+		queue.enqueue(next);
+	    } else {
+		m_delta[pos] = alt;
+	    }
+	}
+    }
+
+    m_fire.fill(0, m_output.count());
+    for (int state = 0; state < m_output.count(); state++)
+	m_fire[state] = m_output[state] >= 0 || m_dict[state] >= 0;
+    m_state = 0;
+    m_dirty = false;
+    DBG_TRIGGERS("%s: %d literals, %d states", __func__, m_literals.count(), m_output.count());
+}
+
+/**
+ * @brief Match the regular expressions against the current line
+ * @param end offset of the line end in the chunk
+ * @param matches reference to the QVector of matches to append to
+ */
+void Triggers::match_line(int end, QVector<Match>& matches)
+{
+    if (m_line.isEmpty())
+	return;
+    const QString line = QString::fromUtf8(m_line);
+    m_line.clear();
+    for (int i = 0; i < m_regexes.count(); i++) {
+	const QRegularExpressionMatch rm = m_regexes[i].second.match(line);
+	if (!rm.hasMatch())
+	    continue;
+	Match m;
+	m.trigger = m_regexes[i].first;
+	m.end = end;
+	m.cells = rm.capturedLength();
+	m.skip = line.length() - rm.capturedEnd();
+	m.text = rm.captured();
+	DBG_TRIGGERS("%s: regex '%s' at %d", __func__, qPrintable(m_triggers[m.trigger].name), m.end);
+	matches += m;
+    }
+}
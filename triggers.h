@@ -0,0 +1,92 @@
+/*****************************************************************************
+ *
+ * Qt5 Propeller 2 triggers on the received serial data
+ *
+ * Copyright © 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ *****************************************************************************/
+#pragma once
+#include <QByteArray>
+#include <QPair>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief The Triggers class matches patterns against the received byte stream.
+ *
+ * Literal patterns are compiled into one Aho-Corasick automaton with a
+ * dense transition table, so scanning costs one table lookup per byte
+ * no matter how many literals there are. The automaton's state is kept
+ * between calls to @ref scan, which finds matches spanning read chunks.
+ *
+ * Regular expressions are matched against complete lines. The bytes of
+ * the current line are collected up to @ref max_line, and the patterns
+ * are tried when a CR or LF arrives.
+ *
+ * Matches are reported with the offset of their end in the chunk, so the
+ * caller can act on them at the right point in the stream.
+ */
+class Triggers
+{
+public:
+    enum Action {
+	Act_None	= 0,
+	Act_Highlight	= (1 << 0),	//!< show the match in inverse video
+	Act_Bell	= (1 << 1),	//!< ring the bell
+	Act_Log		= (1 << 2),	//!< log a message
+	Act_Respond	= (1 << 3),	//!< send a response to the device
+    };
+
+    struct Trigger {
+	QString name;		    //!< name used in log messages
+	QString pattern;	    //!< literal string or regular expression
+	bool regex;		    //!< true if @ref pattern is a regular expression
+	int actions;		    //!< bit mask of Action values
+	QString response;	    //!< data sent for Act_Respond
+    };
+
+    struct Match {
+	int trigger;		    //!< index of the trigger
+	int end;		    //!< offset in the chunk after the match
+	int cells;		    //!< number of characters matched
+	int skip;		    //!< number of characters between match and @ref end
+	QString text;		    //!< matched text
+    };
+
+    static constexpr int max_line = 4096;	//!< maximum length of a line for regular expressions
+
+    Triggers();
+
+    void clear();
+    bool add(const Trigger& trigger);
+    bool isEmpty() const;
+    int count() const;
+    const Trigger& trigger(int index) const;
+    QString error_string() const;
+
+    void reset();
+    QVector<Match> scan(const QByteArray& data);
+
+    static int actions(const QStringList& names);
+    static QStringList action_names(int actions);
+
+private:
+    QVector<Trigger> m_triggers;	    //!< all triggers
+    QVector<int> m_literals;		    //!< indices of literal triggers
+    QVector<QPair<int,QRegularExpression>> m_regexes;	//!< regex triggers
+    QString m_error;			    //!< most recent error message
+    bool m_dirty;			    //!< automaton needs to be rebuilt
+    QVector<qint32> m_delta;		    //!< transitions: state * 256 + byte
+    QVector<qint32> m_output;		    //!< trigger index ending in state, or -1
+    QVector<qint32> m_dict;		    //!< next state on the fail chain with output, or -1
+    QByteArray m_fire;			    //!< non-zero if a state has any output
+    qint32 m_state;			    //!< current state of the automaton
+    QByteArray m_line;			    //!< bytes of the current line
+
+    void build();
+    void match_line(int end, QVector<Match>& matches);
+};
@@ -49,28 +49,60 @@ const QString Util::to_asc(const QByteArray& data)
     return result;
 }
 
-const QString Util::dump(const QString& _func, const QByteArray& data, const int bytes_per_line)
+/**
+ * @brief Append one line of a hex dump to a QString
+ * The line is formatted without any temporary strings, so that
+ * dumps of large data and on demand formatting are cheap.
+ * @param line reference to the QString to append to
+ * @param _func optional prefix (function name)
+ * @param data pointer to the bytes for this line
+ * @param len number of bytes (at most bytes_per_line)
+ * @param offs offset of the first byte
+ * @param bytes_per_line number of bytes per line
+ */
+void Util::dump_line(QString& line, const QString& _func, const char* data, int len,
+		     qint64 offs, const int bytes_per_line)
 {
-    QStringList dump;
-    int offs = 0;
-    while (offs < data.length()) {
-	const QString bytes = to_hex(data.mid(offs, bytes_per_line));
-	const QString ascii = to_asc(data.mid(offs, bytes_per_line));
-	if (_func.isEmpty()) {
-	    dump += QString("%1: %2 - %3")
-		    .arg(offs, 4, 16, QChar('0'))
-		    .arg(bytes, -3 * bytes_per_line)
-		    .arg(ascii);
+    static const char hex[] = "0123456789abcdef";
+    if (!_func.isEmpty()) {
+	line += _func;
+	line += QLatin1String(": ");
+    }
+    int digits = 4;
+    while (digits < 16 && 0 != (offs >> (4 * digits)))
+	digits++;
+    while (digits-- > 0)
+	line += QLatin1Char(hex[(offs >> (4 * digits)) & 15]);
+    line += QLatin1String(": ");
+    for (int i = 0; i < bytes_per_line; i++) {
+	if (i < len) {
+	    const uchar b = static_cast<uchar>(data[i]);
+	    line += QLatin1Char(hex[b >> 4]);
+	    line += QLatin1Char(hex[b & 15]);
 	} else {
-	    dump += QString("%1: %2: %3 - %4")
-		    .arg(_func)
-		    .arg(offs, 4, 16, QChar('0'))
-		    .arg(bytes, -3 * bytes_per_line)
-		    .arg(ascii);
+	    line += QLatin1String("  ");
 	}
-	offs += bytes_per_line;
+	line += QChar::Space;
+    }
+    line += QLatin1String(" - ");
+    for (int i = 0; i < len; i++) {
+	const char ch = data[i];
+	line += ch < 32 || ch > 126 ? QChar(L'·') : QChar(QLatin1Char(ch));
+    }
+}
+
+const QString Util::dump(const QString& _func, const QByteArray& data, const int bytes_per_line)
+{
+    QString dump;
+    const int lines = (data.length() + bytes_per_line - 1) / bytes_per_line;
+    dump.reserve(lines * (_func.length() + 2 + 8 + 2 + 4 * bytes_per_line + 4));
+    for (int offs = 0; offs < data.length(); offs += bytes_per_line) {
+	if (offs > 0)
+	    dump += QChar::LineFeed;
+	dump_line(dump, _func, data.constData() + offs,
+		  qMin(bytes_per_line, data.length() - offs), offs, bytes_per_line);
     }
-    return dump.join(QChar::LineFeed);
+    return dump;
 }
 
 const QByteArray Util::fkey_str(const uchar ch1, const QVector<uchar>& ch2, int kmod)
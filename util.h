@@ -37,6 +37,8 @@ public:
     static const QString to_hex(const QByteArray& data);
     static const QString to_asc(const QByteArray& data);
     static const QString dump(const QString& _func, const QByteArray& data, const int bytes_per_line = 16);
+    static void dump_line(QString& line, const QString& _func, const char* data, int len,
+			  qint64 offs, const int bytes_per_line = 16);
 
     static const QByteArray fkey_str(const uchar ch1, const QVector<uchar>& ch2 = QVector<uchar>(), int kmod = 0);
     static const QByteArray fkey_str(const uchar ch1, const char* ch2 = nullptr, int kmod = 0);
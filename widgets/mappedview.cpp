@@ -0,0 +1,366 @@
+/***************************************************************************************
+ *
+ * Qt5 Propeller 2 memory mapped text and hex dump viewer
+ *
+ * Copyright 🄯 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ ***************************************************************************************/
+#include <QElapsedTimer>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <climits>
+#include <cstring>
+#include "mappedview.h"
+#include "util.h"
+
+#define	DEBUG_MAPPEDVIEW	0
+
+#if defined(DEBUG_MAPPEDVIEW) && (DEBUG_MAPPEDVIEW != 0)
+#define	DBG_MAPPEDVIEW(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_MAPPEDVIEW(X,...) /* X */
+#endif
+
+MappedView::MappedView(QWidget* parent)
+    : QAbstractScrollArea(parent)
+    , m_file()
+    , m_data()
+    , m_base(nullptr)
+    , m_size(0)
+    , m_mode(TEXT)
+    , m_lines()
+    , m_columns(0)
+    , m_current(-1)
+    , m_tabsize(8)
+{
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    viewport()->setBackgroundRole(QPalette::Base);
+    viewport()->setAutoFillBackground(true);
+}
+
+MappedView::~MappedView()
+{
+    clear();
+}
+
+/**
+ * @brief Return the current display mode
+ * @return Mode enumeration value
+ */
+MappedView::Mode MappedView::mode() const
+{
+    return m_mode;
+}
+
+/**
+ * @brief Return the number of bytes being displayed
+ * @return size in bytes
+ */
+qint64 MappedView::size() const
+{
+    return m_size;
+}
+
+/**
+ * @brief Return the number of rows
+ * @return number of text lines, or number of hex dump rows
+ */
+int MappedView::rows() const
+{
+    if (HEXDUMP == m_mode)
+	return static_cast<int>(qMin<qint64>((m_size + bytes_per_row - 1) / bytes_per_row, INT_MAX));
+    return qMax(0, m_lines.count() - 1);
+}
+
+/**
+ * @brief Return the text of a row
+ * Text lines are decoded from UTF-8 and have their tabs expanded,
+ * hex dump rows are formatted on the fly.
+ * @param index row number
+ * @return QString with the row's text
+ */
+QString MappedView::row(int index) const
+{
+    if (index < 0 || index >= rows())
+	return QString();
+
+    if (HEXDUMP == m_mode) {
+	const qint64 offs = static_cast<qint64>(index) * bytes_per_row;
+	const int len = static_cast<int>(qMin<qint64>(bytes_per_row, m_size - offs));
+	QString line;
+	Util::dump_line(line, QString(), m_base + offs, len, offs, bytes_per_row);
+	return line;
+    }
+
+    const qint64 start = m_lines[index];
+    qint64 end = m_lines[index + 1] - 1;	// the newline, or m_size
+    if (end > start && '\r' == m_base[end - 1])
+	end--;
+    const QString line = QString::fromUtf8(m_base + start,
+					   static_cast<int>(qMin<qint64>(end - start, INT_MAX)));
+    if (!line.contains(QChar::Tabulation))
+	return line;
+
+    QString expanded;
+    expanded.reserve(line.length() + m_tabsize * 4);
+    foreach(const QChar ch, line) {
+	if (QChar::Tabulation == ch) {
+	    expanded += QString(m_tabsize - expanded.length() % m_tabsize, QChar::Space);
+	} else {
+	    expanded += ch;
+	}
+    }
+    return expanded;
+}
+
+/**
+ * @brief Return the highlighted row
+ * @return row number, or -1 if none is highlighted
+ */
+int MappedView::current_row() const
+{
+    return m_current;
+}
+
+/**
+ * @brief Unmap the file or release the data and clear the view
+ */
+void MappedView::clear()
+{
+    if (m_file.isOpen()) {
+	if (m_base && m_data.isNull())
+	    m_file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(m_base)));
+	m_file.close();
+    }
+    m_data.clear();
+    m_base = nullptr;
+    m_size = 0;
+    m_lines.clear();
+    m_columns = 0;
+    m_current = -1;
+    update_scrollbars();
+    viewport()->update();
+}
+
+/**
+ * @brief Display the contents of a file
+ * The file is memory mapped; if that fails it is read into memory.
+ * @param filename name of the file to display
+ * @param mode display mode
+ * @return true on success, or false if the file can't be opened
+ */
+bool MappedView::set_file(const QString& filename, Mode mode)
+{
+    clear();
+    m_file.setFileName(filename);
+    if (!m_file.open(QIODevice::ReadOnly))
+	return false;
+
+    m_size = m_file.size();
+    if (m_size > 0) {
+	const uchar* data = m_file.map(0, m_size);
+	if (data) {
+	    m_base = reinterpret_cast<const char*>(data);
+	} else {
+	    m_data = m_file.readAll();
+	    m_base = m_data.constData();
+	    m_size = m_data.size();
+	}
+    }
+    setup(mode);
+    return true;
+}
+
+/**
+ * @brief Display the contents of a QByteArray
+ * The data is implicitly shared, i.e. not copied.
+ * @param data const reference to the QByteArray
+ * @param mode display mode
+ */
+void MappedView::set_data(const QByteArray& data, Mode mode)
+{
+    clear();
+    m_data = data;
+    m_base = m_data.constData();
+    m_size = m_data.size();
+    setup(mode);
+}
+
+/**
+ * @brief Display a text
+ * @param text const reference to the QString
+ */
+void MappedView::set_text(const QString& text)
+{
+    set_data(text.toUtf8(), TEXT);
+}
+
+/**
+ * @brief Set the tab stop distance used to expand text lines
+ * @param tabsize number of characters
+ */
+void MappedView::set_tabsize(int tabsize)
+{
+    m_tabsize = qMax(1, tabsize);
+    viewport()->update();
+}
+
+/**
+ * @brief Highlight a row and scroll it into the middle of the viewport
+ * @param index row number, or -1 to remove the highlight
+ */
+void MappedView::set_current_row(int index)
+{
+    m_current = index < rows() ? index : -1;
+    if (m_current >= 0) {
+	update_scrollbars();
+	verticalScrollBar()->setValue(m_current - verticalScrollBar()->pageStep() / 2);
+    }
+    viewport()->update();
+}
+
+void MappedView::changeEvent(QEvent* event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if (QEvent::FontChange == event->type())
+	update_scrollbars();
+}
+
+/**
+ * @brief Paint only the rows intersecting the event's rectangle
+ * @param event pointer to the QPaintEvent
+ */
+void MappedView::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(viewport());
+    painter.setFont(font());
+    painter.setPen(palette().color(QPalette::Text));
+
+    const QFontMetrics fm = fontMetrics();
+    const int height = fm.lineSpacing();
+    const int x = -horizontalScrollBar()->value();
+    const int first = verticalScrollBar()->value();
+    const int top = event->rect().top() / height;
+    const int bottom = event->rect().bottom() / height;
+    const int count = rows();
+
+    int widest = m_columns;
+    for (int r = top; r <= bottom && first + r < count; r++) {
+	const QString text = row(first + r);
+	widest = qMax(widest, text.length());
+	if (first + r == m_current) {
+	    painter.fillRect(0, r * height, viewport()->width(), height,
+			     palette().color(QPalette::Highlight));
+	    painter.setPen(palette().color(QPalette::HighlightedText));
+	    painter.drawText(x, r * height + fm.ascent(), text);
+	    painter.setPen(palette().color(QPalette::Text));
+	} else {
+	    painter.drawText(x, r * height + fm.ascent(), text);
+	}
+    }
+
+    if (widest > m_columns) {
+	// expanded tabs or multi-byte sequences changed the estimate
+	m_columns = widest;
+	update_scrollbars();
+    }
+}
+
+void MappedView::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    update_scrollbars();
+}
+
+/**
+ * @brief Scroll the current row into the middle of the viewport
+ * A row set before the view was shown was scrolled to with the page
+ * step of a viewport which had no size yet.
+ * @param event pointer to the QShowEvent
+ */
+void MappedView::showEvent(QShowEvent* event)
+{
+    QAbstractScrollArea::showEvent(event);
+    if (m_current >= 0)
+	set_current_row(m_current);
+}
+
+/**
+ * @brief Set the display mode and build the line index for text
+ * @param mode display mode
+ */
+void MappedView::setup(Mode mode)
+{
+    m_mode = mode;
+    if (HEXDUMP == m_mode) {
+	QString line;
+	Util::dump_line(line, QString(), m_base, 0,
+			qMax<qint64>(0, m_size - 1), bytes_per_row);
+	m_columns = line.length() + bytes_per_row;
+    } else {
+	index_lines();
+    }
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    update_scrollbars();
+    viewport()->update();
+}
+
+/**
+ * @brief Build the index of line start offsets
+ * The scan uses memchr(3), which the C library implements with vector
+ * instructions, so this takes a few milliseconds even for huge files.
+ * The widest line in bytes is remembered as an estimate for the width.
+ */
+void MappedView::index_lines()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_lines.clear();
+    m_columns = 0;
+    // guess about 32 bytes per line to avoid most reallocations
+    m_lines.reserve(static_cast<int>(qMin<qint64>(m_size / 32 + 2, INT_MAX / 16)));
+
+    const char* p = m_base;
+    const char* const end = m_base + m_size;
+    while (p < end) {
+	m_lines += p - m_base;
+	const char* eol = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+	if (!eol)
+	    eol = end;
+	m_columns = qMax(m_columns, static_cast<int>(qMin<qint64>(eol - p, INT_MAX)));
+	p = eol + 1;
+    }
+    // sentinel: one past the newline of the last line, which is virtual
+    // if the file does not end with one
+    const bool terminated = m_size > 0 && '\n' == m_base[m_size - 1];
+    m_lines += terminated ? m_size : m_size + 1;
+
+    DBG_MAPPEDVIEW("%s: %lld bytes, %d lines in %lldms", __func__,
+		   m_size, rows(), timer.elapsed());
+}
+
+/**
+ * @brief Update the ranges and steps of the scroll bars
+ */
+void MappedView::update_scrollbars()
+{
+    const QFontMetrics fm = fontMetrics();
+    const int height = qMax(1, fm.lineSpacing());
+    const int width = qMax(1, fm.horizontalAdvance(QLatin1Char('0')));
+    const int page = qMax(1, viewport()->height() / height);
+
+    verticalScrollBar()->setSingleStep(1);
+    verticalScrollBar()->setPageStep(page);
+    verticalScrollBar()->setRange(0, qMax(0, rows() - page));
+
+    const qint64 pixels = static_cast<qint64>(m_columns) * width;
+    horizontalScrollBar()->setSingleStep(width);
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setRange(0, static_cast<int>(qBound<qint64>(0, pixels - viewport()->width(), INT_MAX)));
+}
@@ -0,0 +1,73 @@
+/***************************************************************************************
+ *
+ * Qt5 Propeller 2 memory mapped text and hex dump viewer
+ *
+ * Copyright 🄯 2021 Jürgen Buchmüller <pullmoll@t-online.de>
+ *
+ * See the file LICENSE for the details of the BSD-3-Clause terms.
+ *
+ ***************************************************************************************/
+#pragma once
+#include <QAbstractScrollArea>
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+/**
+ * @brief The MappedView class displays a possibly huge file read-only.
+ *
+ * The file is memory mapped (or a QByteArray is shared) and only the
+ * rows visible in the viewport are decoded and painted. In text mode
+ * an index of line start offsets is built once by scanning for newlines
+ * with memchr(3). In hex dump mode no index is needed at all, because
+ * each row covers a fixed number of bytes and is formatted on demand.
+ */
+class MappedView : public QAbstractScrollArea
+{
+    Q_OBJECT
+public:
+    enum Mode {
+	TEXT,			//!< display lines of UTF-8 text
+	HEXDUMP			//!< display a hex dump
+    };
+
+    static constexpr int bytes_per_row = 16;	//!< bytes per hex dump row
+
+    explicit MappedView(QWidget* parent = nullptr);
+    ~MappedView();
+
+    Mode mode() const;
+    qint64 size() const;
+    int rows() const;
+    QString row(int index) const;
+    int current_row() const;
+
+public slots:
+    void clear();
+    bool set_file(const QString& filename, Mode mode = TEXT);
+    void set_data(const QByteArray& data, Mode mode = TEXT);
+    void set_text(const QString& text);
+    void set_tabsize(int tabsize);
+    void set_current_row(int index);
+
+protected:
+    void changeEvent(QEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+
+private:
+    QFile m_file;			//!< mapped file (if any)
+    QByteArray m_data;			//!< shared data (if not mapped)
+    const char* m_base;			//!< pointer to the first byte
+    qint64 m_size;			//!< number of bytes at m_base
+    Mode m_mode;			//!< display mode
+    QVector<qint64> m_lines;		//!< text mode line start offsets plus end sentinel
+    mutable int m_columns;		//!< widest row in characters
+    int m_current;			//!< highlighted row (or -1)
+    int m_tabsize;			//!< tab stop distance in characters
+
+    void setup(Mode mode);
+    void index_lines();
+    void update_scrollbars();
+};
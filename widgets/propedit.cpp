@@ -9,27 +9,50 @@
  ***************************************************************************************/
 #include <QCryptographicHash>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QTextStream>
+#include <algorithm>
+#include <cstring>
 #include "idstrings.h"
 #include "propedit.h"
 #include "propconst.h"
 #include "util.h"
 
+#define	DEBUG_HIGHLIGHT	0
+#define	DEBUG_KEY_LATENCY	0
+
+#if defined(DEBUG_HIGHLIGHT) && (DEBUG_HIGHLIGHT != 0)
+#define	DBG_HIGHLIGHT(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_HIGHLIGHT(X,...) /* X */
+#endif
+
+#if defined(DEBUG_KEY_LATENCY) && (DEBUG_KEY_LATENCY != 0)
+#define	DBG_KEY_LATENCY(X,...)	qDebug(X, __VA_ARGS__)
+#else
+#define	DBG_KEY_LATENCY(X,...) /* X */
+#endif
+
 PropEdit::PropEdit(QWidget *parent,
 		   const int tabsize,
 		   const QString& css_linearea,
 		   Options options)
     : QPlainTextEdit(parent)
     , m_lineno_area(nullptr)
+    , m_overview(nullptr)
     , m_highlighter(nullptr)
     , m_tabsize(tabsize)
     , m_options(options)
-    , m_error_lines()
+    , m_markers()
+    , m_line_height(fontMetrics().height())
+    , m_listing_index()
+    , m_current_line(-1)
+    , m_key_timer()
 {
     setWordWrapMode(QTextOption::NoWrap);
     if (m_options.testFlag(PropEdit::PE_USE_LINENUMBERS)) {
 	m_lineno_area = new LineNumberArea(this, css_linearea);
+	m_overview = new OverviewRuler(this);
 
 	connect(this, &PropEdit::blockCountChanged,
 		this, &PropEdit::update_line_number_area_width);
@@ -43,55 +66,204 @@ PropEdit::PropEdit(QWidget *parent,
 
     if (m_options.testFlag(PE_DO_HIGHLIGHT)) {
 	m_highlighter = new PropHighlighter(document(), m_options);
+	// set the background once instead of through a style sheet
+	QPalette pal = palette();
+	pal.setColor(QPalette::Base, m_highlighter->background().color());
+	setPalette(pal);
 	highlight_current_line();
     }
     setFont(font());
 }
 
+static bool marker_less(const PropEdit::Marker& a, const PropEdit::Marker& b)
+{
+    return a.line < b.line;
+}
+
+static bool marker_less_than(const PropEdit::Marker& m, int line)
+{
+    return m.line < line;
+}
+
 /**
- * @brief Append a rule to the highlighter of this PLD editor
- * @param rule highlighter rule to append
+ * @brief Set a list of line numbers to indicate as lines containing errors
+ * @param list of line numbers
  */
-void PropEdit::append_rule(HighlightingRule rule)
+void PropEdit::set_error_line_list(const QList<int>& list)
 {
-    if (!m_highlighter)
-	return;
-    m_highlighter->appendRule(rule);
+    QVector<Marker> markers;
+    markers.reserve(list.count());
+    foreach(int line, list) {
+	Marker m;
+	m.line = line;
+	m.severity = SEV_ERROR;
+	markers += m;
+    }
+    set_markers(markers);
 }
 
 /**
- * @brief Prepend a rule to the highlighter of this PLD editor
- * @param rule highlighter rule to prepend
+ * @brief Set the error and warning markers
+ * The markers are sorted by line, and multiple markers for one line
+ * are merged into one with the highest severity.
+ * @param markers const reference to a QVector of markers in any order
  */
-void PropEdit::prepend_rule(HighlightingRule rule)
+void PropEdit::set_markers(const QVector<Marker>& markers)
 {
-    if (!m_highlighter)
-	return;
-    m_highlighter->prependRule(rule);
+    m_markers = markers;
+    std::stable_sort(m_markers.begin(), m_markers.end(), marker_less);
+    int n = 0;
+    for (int i = 0; i < m_markers.count(); i++) {
+	if (n > 0 && m_markers[n - 1].line == m_markers[i].line) {
+	    m_markers[n - 1].severity = qMax(m_markers[n - 1].severity, m_markers[i].severity);
+	} else {
+	    m_markers[n++] = m_markers[i];
+	}
+    }
+    m_markers.resize(n);
+    if (m_lineno_area)
+	m_lineno_area->update();
+    if (m_overview)
+	m_overview->update();
 }
 
 /**
- * @brief Set a list of line numbers to indicate as lines containing errors
- * @param list of line numbers
+ * @brief Return the markers sorted by line
+ * @return const reference to the QVector of markers
  */
-void PropEdit::set_error_line_list(const QList<int>& list)
+const QVector<PropEdit::Marker>& PropEdit::markers() const
+{
+    return m_markers;
+}
+
+/**
+ * @brief Return the severity of the marker for a line
+ * @param line line number (1 based)
+ * @return Severity of the marker, or SEV_NONE
+ */
+PropEdit::Severity PropEdit::marker(int line) const
 {
-    m_error_lines = list;
-    update();
+    QVector<Marker>::const_iterator it = std::lower_bound(m_markers.constBegin(), m_markers.constEnd(),
+							   line, marker_less_than);
+    if (it == m_markers.constEnd() || it->line != line)
+	return SEV_NONE;
+    return it->severity;
+}
+
+/**
+ * @brief Return the listing index of the last build
+ * @return const reference to the ListingIndex
+ */
+const ListingIndex& PropEdit::listing_index() const
+{
+    return m_listing_index;
+}
+
+/**
+ * @brief Set the listing index after a build
+ * @param index const reference to the ListingIndex
+ */
+void PropEdit::set_listing_index(const ListingIndex& index)
+{
+    m_listing_index = index;
+}
+
+/**
+ * @brief Return the line number of the text cursor
+ * @return line number (1 based)
+ */
+int PropEdit::current_line() const
+{
+    return textCursor().blockNumber() + 1;
 }
 
 /**
  * @brief Check if the QPlainTextEditor's text was modified
+ * The document's modified flag follows the undo stack's clean index,
+ * so undoing all edits makes the text unmodified again.
  * @param true if text was changed
  */
 bool PropEdit::changed() const
 {
-    QString text = QPlainTextEdit::toPlainText();
+    return document()->isModified();
+}
+
+/**
+ * @brief Read a file through a memory mapping and hash its contents
+ * @param file reference to the opened QFile
+ * @param p_text optional pointer to a QString receiving the UTF-8 decoded text
+ * @return SHA-256 hash of the file contents
+ */
+static QByteArray map_and_hash(QFile& file, QString* p_text = nullptr)
+{
     QCryptographicHash sha256(QCryptographicHash::Sha256);
-    sha256.addData(text.toUtf8());
-    const QByteArray new_hash = sha256.result();
-    const QByteArray old_hash = property(prop_sha256).toByteArray();
-    return old_hash != new_hash;
+    const qint64 size = file.size();
+    uchar* data = size > 0 ? file.map(0, size) : nullptr;
+    QByteArray bytes;
+    const char* ptr = reinterpret_cast<const char*>(data);
+    int len = static_cast<int>(size);
+    if (!data) {
+	// mapping failed (or empty file): fall back to reading
+	bytes = file.readAll();
+	ptr = bytes.constData();
+	len = bytes.size();
+    }
+    sha256.addData(ptr, len);
+    if (p_text) {
+	// skip a UTF-8 byte order mark
+	if (len >= 3 && 0 == memcmp(ptr, "\xef\xbb\xbf", 3)) {
+	    ptr += 3;
+	    len -= 3;
+	}
+	*p_text = QString::fromUtf8(ptr, len);
+    }
+    if (data)
+	file.unmap(data);
+    return sha256.result();
+}
+
+/**
+ * @brief Remember the hash, time and size of the file on disk
+ * @param hash SHA-256 hash of the contents
+ * @param info QFileInfo of the file
+ */
+void PropEdit::set_disk_state(const QByteArray& hash, const QFileInfo& info)
+{
+    setProperty(prop_sha256, hash);
+    setProperty(prop_mtime, info.lastModified().toMSecsSinceEpoch());
+    setProperty(prop_size, info.size());
+}
+
+/**
+ * @brief Check if the file was modified on disk since it was loaded or saved
+ * The file is hashed only if its time stamp or size changed.
+ * @param acknowledge if true, remember the current state on disk
+ * @return true if the file on disk differs from what was loaded or saved
+ */
+bool PropEdit::changed_on_disk(bool acknowledge)
+{
+    if (property(prop_sha256).isNull())
+	return false;
+    QFileInfo info(filename());
+    if (!info.exists())
+	return false;
+    if (info.lastModified().toMSecsSinceEpoch() == property(prop_mtime).toLongLong() &&
+	info.size() == property(prop_size).toLongLong())
+	return false;
+
+    QFile file(info.absoluteFilePath());
+    if (!file.open(QIODevice::ReadOnly))
+	return false;
+    const QByteArray hash = map_and_hash(file);
+    file.close();
+    if (hash == property(prop_sha256).toByteArray()) {
+	// only touched
+	set_disk_state(hash, info);
+	return false;
+    }
+    if (acknowledge)
+	set_disk_state(hash, info);
+    return true;
 }
 
 /**
@@ -130,24 +302,34 @@ void PropEdit::setFont(const QFont& font)
 {
     QPlainTextEdit::setFont(font);
     setTabStopDistance(fontMetrics().averageCharWidth() * m_tabsize);
+    m_line_height = fontMetrics().height();
 }
 
 void PropEdit::setText(const QString& text)
 {
-    QCryptographicHash sha256(QCryptographicHash::Sha256);
-    sha256.addData(text.toUtf8());
-    QByteArray old_hash = property(prop_sha256).toByteArray();
-    QByteArray new_hash = sha256.result();
-    if (old_hash == new_hash)
-	return;
-    setProperty(prop_sha256, new_hash);
-    delete m_highlighter;
-    m_highlighter = nullptr;
+    // keep the highlighter, but only track block states while the text is replaced
+    if (m_highlighter)
+	m_highlighter->set_deferred(true);
+    m_current_line = -1;
     setPlainText(text);
-    if (m_options.testFlag(PE_DO_HIGHLIGHT)) {
-	m_highlighter = new PropHighlighter(document(), m_options);
+    if (m_highlighter) {
+	m_highlighter->set_deferred(false);
+#if defined(DEBUG_HIGHLIGHT) && (DEBUG_HIGHLIGHT != 0)
+	// Measure the highlighting throughput for the whole document
+	QElapsedTimer timer;
+	timer.start();
+	m_highlighter->rehighlight();
+	const qint64 ns = qMax(Q_INT64_C(1), timer.nsecsElapsed());
+	DBG_HIGHLIGHT("%s: %s: %d lines in %.3f ms (%.0f lines/s)", __func__,
+		      qPrintable(filename()), blockCount(), ns / 1e6,
+		      blockCount() * 1e9 / ns);
+#endif
+	// visible blocks now, the rest when idle
+	const int rows = viewport()->height() / qMax(1, fontMetrics().height()) + 1;
+	m_highlighter->rehighlight_lazy(firstVisibleBlock(), rows);
 	highlight_current_line();
     }
+    document()->setModified(false);
 }
 
 void PropEdit::setFilename(const QString& filename)
@@ -174,14 +356,19 @@ bool PropEdit::load(const QString& filename)
     QFileInfo info(load_filename);
     QFile file(info.absoluteFilePath());
     if (file.open(QIODevice::ReadOnly)) {
-	QTextStream str(&file);
-	str.setCodec("UTF-8");
-	QString text = str.readAll();
+	QString text;
+	const QByteArray hash = map_and_hash(file, &text);
 	file.close();
+	// nothing to do if the same, unmodified file is reloaded
+	const bool same = !changed() &&
+			  hash == property(prop_sha256).toByteArray() &&
+			  info.absoluteFilePath() == property(prop_filename).toString();
 	setProperty(prop_filename, info.absoluteFilePath());
-	FileType filetype = util.filetype(filename);
+	FileType filetype = util.filetype(info.absoluteFilePath());
 	setProperty(prop_filetype, filetype);
-	setText(text);
+	set_disk_state(hash, info);
+	if (!same)
+	    setText(text);
 	return true;
     }
     return false;
@@ -198,18 +385,17 @@ bool PropEdit::save(const QString& filename)
     QFileInfo info(save_filename);
     QFile file(info.absoluteFilePath());
     if (file.open(QIODevice::WriteOnly)) {
-	QString text = toPlainText();
-	QCryptographicHash sha256(QCryptographicHash::Sha256);
-	sha256.addData(text.toUtf8());
-	QByteArray new_hash = sha256.result();
-	QTextStream str(&file);
-	str.setCodec("UTF-8");
-	str << text;
+	const QByteArray bytes = toPlainText().toUtf8();
+	const bool ok = file.write(bytes) == bytes.size();
 	file.close();
-	setProperty(prop_sha256, new_hash);
+	if (!ok)
+	    return false;
+	info.refresh();
+	set_disk_state(QCryptographicHash::hash(bytes, QCryptographicHash::Sha256), info);
 	setProperty(prop_filename, info.absoluteFilePath());
 	FileType filetype = util.filetype(info.fileName());
 	setProperty(prop_filetype, filetype);
+	document()->setModified(false);
 	return true;
     }
     return false;
@@ -239,7 +425,9 @@ int PropEdit::line_number_area_width()
  */
 void PropEdit::update_line_number_area_width(int /* newBlockCount */)
 {
-    setViewportMargins(line_number_area_width(), 0, 0, 0);
+    setViewportMargins(line_number_area_width(), 0, m_overview ? overview_width : 0, 0);
+    if (m_overview)
+	m_overview->update();
 }
 
 /**
@@ -251,6 +439,8 @@ void PropEdit::update_line_number_area(const QRect &rect, int dy)
 {
     if (dy) {
 	m_lineno_area->scroll(0, dy);
+	if (m_overview)
+	    m_overview->update();
     } else {
 	m_lineno_area->update(0, rect.y(), m_lineno_area->width(), rect.height());
     }
@@ -272,10 +462,17 @@ void PropEdit::resizeEvent(QResizeEvent *e)
 
     QRect cr = contentsRect();
     m_lineno_area->setGeometry(QRect(cr.left(), cr.top(), line_number_area_width(), cr.height()));
+    if (m_overview) {
+	const QRect vr = viewport()->geometry();
+	m_overview->setGeometry(QRect(vr.right() + 1, vr.top(), overview_width, vr.height()));
+    }
 }
 
 void PropEdit::keyPressEvent(QKeyEvent* event)
 {
+#if defined(DEBUG_KEY_LATENCY) && (DEBUG_KEY_LATENCY != 0)
+    m_key_timer.start();
+#endif
     Qt::KeyboardModifiers mod = event->modifiers();
     const bool ctrl = mod.testFlag(Qt::ControlModifier);
     switch (event->key()) {
@@ -297,6 +494,27 @@ void PropEdit::keyPressEvent(QKeyEvent* event)
     QPlainTextEdit::keyPressEvent(event);
 }
 
+/**
+ * @brief Paint the viewport; with DEBUG_KEY_LATENCY report the time from key press to paint
+ * @param event pointer to the QPaintEvent
+ */
+void PropEdit::paintEvent(QPaintEvent* event)
+{
+    QPlainTextEdit::paintEvent(event);
+#if defined(DEBUG_KEY_LATENCY) && (DEBUG_KEY_LATENCY != 0)
+    if (m_key_timer.isValid()) {
+	static qint64 total_ns = 0;
+	static qint64 count = 0;
+	const qint64 ns = m_key_timer.nsecsElapsed();
+	total_ns += ns;
+	count++;
+	DBG_KEY_LATENCY("%s: key to paint %.3f ms (average %.3f ms over %lld keys)", __func__,
+			ns / 1e6, total_ns / 1e6 / count, count);
+	m_key_timer.invalidate();
+    }
+#endif
+}
+
 void PropEdit::zoom_in()
 {
     int size = font().pointSize();
@@ -325,9 +543,12 @@ void PropEdit::highlight_current_line()
     if (!m_lineno_area)
 	return;
 
-    const QRgb rgb = m_highlighter->background().color().rgb();
-    const QString style = QString("background: #%1;").arg(rgb, 8, 16, QChar('0'));
-    setStyleSheet(style);
+    // The selection's cursor follows edits, so it only needs
+    // to be replaced when the cursor moves to another line
+    const int line = textCursor().blockNumber();
+    if (line == m_current_line)
+	return;
+    m_current_line = line;
 
     QList<QTextEdit::ExtraSelection> extraSelections;
 
@@ -369,19 +590,27 @@ void PropEdit::line_number_area_paint_event(QPaintEvent *event)
     int top = qRound(blockBoundingGeometry(block).translated(contentOffset()).top());
     int bottom = top + qRound(blockBoundingRect(block).height());
 
+    // find the first marker at or after the first visible line once,
+    // then advance it along with the blocks
+    QVector<Marker>::const_iterator mk = std::lower_bound(m_markers.constBegin(), m_markers.constEnd(),
+							   blockNumber + 1, marker_less_than);
+
     while (block.isValid() && top <= event->rect().bottom()) {
 
 	if (block.isVisible() && bottom >= event->rect().top()) {
 
 	    QString number = QString::number(blockNumber + 1);
 
-	    if (m_error_lines.contains(blockNumber + 1)) {
-		painter.fillRect(0, top, m_lineno_area->width(), fontMetrics().height(), Qt::red);
+	    while (mk != m_markers.constEnd() && mk->line < blockNumber + 1)
+		++mk;
+	    if (mk != m_markers.constEnd() && mk->line == blockNumber + 1) {
+		const QRgb color = SEV_ERROR == mk->severity ? color_marker_error : color_marker_warning;
+		painter.fillRect(0, top, m_lineno_area->width(), m_line_height, QColor(color));
 	    }
 
 	    painter.drawText(0, top,
 			     m_lineno_area->width() - 4,
-			     fontMetrics().height(),
+			     m_line_height,
 			     Qt::AlignRight, number);
 	}
 
@@ -393,6 +622,128 @@ void PropEdit::line_number_area_paint_event(QPaintEvent *event)
 
 }
 
+/**
+ * @brief Paint the overview ruler
+ * The visible part of the document is shaded, and each marker is drawn
+ * as a bar at its relative position. Markers falling onto the same pixel
+ * row are drawn only once, with the highest severity winning.
+ * @param event pointer to the QPaintEvent
+ */
+void PropEdit::overview_paint_event(QPaintEvent* event)
+{
+    if (!m_overview)
+	return;
+
+    QPainter painter(m_overview);
+    painter.fillRect(event->rect(), color_line_number_area);
+
+    const int width = m_overview->width();
+    const int height = m_overview->height();
+    const qint64 lines = qMax(1, blockCount());
+
+    const qint64 first = firstVisibleBlock().blockNumber();
+    const qint64 rows = viewport()->height() / qMax(1, m_line_height);
+    painter.fillRect(0, static_cast<int>(first * height / lines),
+		     width, qMax(2, static_cast<int>(rows * height / lines)),
+		     QColor(color_overview_visible));
+
+    int last_y = -1;
+    Severity last = SEV_NONE;
+    foreach(const Marker& m, m_markers) {
+	const int y = static_cast<int>((m.line - 1) * height / lines);
+	if (y == last_y && m.severity <= last)
+	    continue;
+	const QRgb color = SEV_ERROR == m.severity ? color_marker_error : color_marker_warning;
+	painter.fillRect(1, y, width - 2, 3, QColor(color));
+	last_y = y;
+	last = m.severity;
+    }
+}
+
+/**
+ * @brief Move the cursor to the line at the mouse position in the overview ruler
+ * @param event pointer to the QMouseEvent
+ */
+void PropEdit::overview_mouse_event(QMouseEvent* event)
+{
+    if (!m_overview || !event->buttons().testFlag(Qt::LeftButton))
+	return;
+    const qint64 lines = qMax(1, blockCount());
+    const int y = qBound(0, event->pos().y(), m_overview->height() - 1);
+    gotoLineNumber(static_cast<int>(y * lines / qMax(1, m_overview->height())) + 1);
+}
+
+/**
+ * @brief Construct the text formats shared by all highlighters
+ */
+PropHighlighter::Formats::Formats()
+{
+    // Multi-Line Comments starting with "{" or multiple "{{", ending with "}" or multiple "}}"
+    multiLineCommentFormat.setBackground(QColor(color_background));
+    multiLineCommentFormat.setForeground(QColor(color_comment));
+
+    // In-Line Comments enclosed in "{" and "}"
+    inLineCommentFormat.setBackground(QColor(color_background));
+    inLineCommentFormat.setForeground(QColor(color_comment));
+
+    // Section names, i.e. CON, VAR, DAT, ...
+    sectionsFormat.setFontUnderline(true);
+    sectionsFormat.setBackground(QColor(color_background));
+    sectionsFormat.setForeground(QColor(color_section));
+
+    // Operators
+    operatorFormat.setBackground(QColor(color_background));
+    operatorFormat.setForeground(QColor(color_operator));
+    operatorFormat.setFontWeight(QFont::Bold);
+
+    // Decimal constants
+    decFormat.setBackground(QColor(color_background));
+    decFormat.setForeground(QColor(color_dec));
+
+    // Binary constants
+    binFormat.setBackground(QColor(color_background));
+    binFormat.setForeground(QColor(color_bin));
+
+    // Hexadecimal constants
+    hexFormat.setBackground(QColor(color_background));
+    hexFormat.setForeground(QColor(color_hex));
+
+    // Float constants
+    fltFormat.setBackground(QColor(color_background));
+    fltFormat.setForeground(QColor(color_flt));
+
+    // String constants in double quotes
+    strFormat.setBackground(QColor(color_background));
+    strFormat.setForeground(QColor(color_str));
+
+    // Keywords (reserved names), i.e. BYTE, WORD, LONG, ORG, ORG, ORGF, RES, FIT, ...
+    keywordFormat.setFontWeight(QFont::ExtraBold);
+    keywordFormat.setBackground(QColor(color_background));
+    keywordFormat.setForeground(QColor(color_keyword));
+
+    // Conditionals, i.e. IF_NZ, IF_C, ...
+    conditionalFormat.setBackground(QColor(color_background));
+    conditionalFormat.setForeground(QColor(color_conditional));
+
+    // Preprocessor statements, i.e. #define, #undef, #if, #ifdef, #else, ...
+    preprocFormat.setBackground(QColor(color_background));
+    preprocFormat.setForeground(QColor(color_preproc));
+
+    // Until-end-of-line Comments starting with '
+    singleLineCommentFormat.setBackground(QColor(color_background));
+    singleLineCommentFormat.setForeground(QColor(color_comment));
+}
+
+/**
+ * @brief Return the process wide text formats, built on first use
+ * @return const reference to the Formats
+ */
+const PropHighlighter::Formats& PropHighlighter::formats()
+{
+    static const Formats f;
+    return f;
+}
+
 /**
  * @brief prop_highlighter constructor
  * @param doc pointer to the QTextDocument to highlight
@@ -401,223 +752,263 @@ void PropEdit::line_number_area_paint_event(QPaintEvent *event)
 PropHighlighter::PropHighlighter(QTextDocument *doc, PropEdit::Options options)
     : QSyntaxHighlighter(doc)
     , m_options(options)
+    , m_formats(formats())
+    , m_deferred(false)
+    , m_idle_timer()
+    , m_idle_block(0)
 {
-    // Enable Multi-Line Comments ?
-    // Starting with "{" or multiple "{{", ending with "}" or multiple "}}"
-    if (options.testFlag(PropEdit::PE_USE_MULTI_LINE_COMMENTS)) {
-	HighlightingRule rule;
-	multiLineCommentFormat.setBackground(QColor(color_background));
-	multiLineCommentFormat.setForeground(QColor(color_comment));
-	commentStartExpression = QRegExp(QString("%1+").arg(QRegExp::escape("{")));
-	rule.pattern = commentStartExpression;
-	rule.format = multiLineCommentFormat;
-	highlightingRules.append(rule);
-	commentEndExpression = QRegExp(QString("%1+").arg(QRegExp::escape("}")));
-    }
-
-    // Enable In-Line Comments ? enclosed in "{" and "}"
-    if (m_options.testFlag(PropEdit::PE_USE_IN_LINE_COMMENTS)) {
-	HighlightingRule rule;
-	inLineCommentFormat.setBackground(QColor(color_background));
-	inLineCommentFormat.setForeground(QColor(color_comment));
-	rule.pattern = QRegExp(QString("%1[^}]*%2")
-			       .arg(QRegExp::escape("{"))
-			       .arg(QRegExp::escape("}")));
-	rule.format = inLineCommentFormat;
-	highlightingRules.append(rule);
-    }
-
-    // Highlight section names ?
-    if (m_options.testFlag(PropEdit::PE_USE_SECTIONS)) {
-	HighlightingRule rule;
-	QStringList sections = g_tokens.list(g_sections);
-	sectionsFormat.setFontUnderline(true);
-	sectionsFormat.setBackground(QColor(color_background));
-	sectionsFormat.setForeground(QColor(color_section));
-	rule.pattern = QRegExp(QString("^(%1)")
-			       .arg(sections.join(QChar('|'))));
-	rule.format = sectionsFormat;
-	highlightingRules.append(rule);
-    }
+    m_idle_timer.setInterval(0);
+    connect(&m_idle_timer, &QTimer::timeout,
+	    this, &PropHighlighter::idle_slice);
+}
 
-    // Highlight operators?
-    if (m_options.testFlag(PropEdit::PE_USE_OPERATORS)) {
-	HighlightingRule rule;
-	operatorFormat.setBackground(QColor(color_background));
-	operatorFormat.setForeground(QColor(color_operator));
-	operatorFormat.setFontWeight(QFont::Bold);
-	QStringList patterns = g_tokens.list_esc(g_operator);
-	rule.pattern = QRegExp(QString("(%1)")
-			       .arg(patterns.join(QChar('|'))),
-			       Qt::CaseInsensitive);
-	rule.format = operatorFormat;
-	highlightingRules.append(rule);
-    }
+/**
+ * @brief Enable or disable deferred highlighting
+ * While deferred, highlightBlock() only keeps track of the block states
+ * (multi-line comment depth), which is much cheaper than formatting.
+ * Use this around QPlainTextEdit::setPlainText() and call rehighlight_lazy() after it.
+ * @param deferred true to defer formatting
+ */
+void PropHighlighter::set_deferred(bool deferred)
+{
+    m_deferred = deferred;
+    if (deferred)
+	m_idle_timer.stop();
+}
 
-    // Highlight decimal constants?
-    if (m_options.testFlag(PropEdit::PE_USE_DEC)) {
-	HighlightingRule rule;
-	decFormat.setBackground(QColor(color_background));
-	decFormat.setForeground(QColor(color_dec));
-	rule.pattern = QRegExp(QString("\\W[0-9_]+\\b"));
-	rule.format = decFormat;
-	highlightingRules.append(rule);
+/**
+ * @brief Highlight @p count blocks starting at @p first now, and all blocks in idle time
+ * @param first first (visible) block to highlight immediately
+ * @param count number of blocks to highlight immediately
+ */
+void PropHighlighter::rehighlight_lazy(const QTextBlock& first, int count)
+{
+    QTextBlock block = first;
+    for (int i = 0; i < count && block.isValid(); i++) {
+	rehighlightBlock(block);
+	block = block.next();
     }
+    m_idle_block = 0;
+    m_idle_timer.start();
+}
 
-    // Highlight binary constants?
-    if (m_options.testFlag(PropEdit::PE_USE_BIN)) {
-	HighlightingRule rule;
-	binFormat.setBackground(QColor(color_background));
-	binFormat.setForeground(QColor(color_bin));
-	rule.pattern = QRegExp(QString("\\W\\%[0-1_]+\\b"));
-	rule.format = binFormat;
-	highlightingRules.append(rule);
+/**
+ * @brief Highlight blocks in order until the time budget of a slice is used up
+ */
+void PropHighlighter::idle_slice()
+{
+    QTextDocument* doc = document();
+    QTextBlock block = doc ? doc->findBlockByNumber(m_idle_block) : QTextBlock();
+    QElapsedTimer timer;
+    timer.start();
+    while (block.isValid() && timer.elapsed() < idle_slice_ms) {
+	rehighlightBlock(block);
+	block = block.next();
+	m_idle_block++;
     }
+    if (!block.isValid())
+	m_idle_timer.stop();
+}
 
-    // Highlight hexadecimal constants?
-    if (m_options.testFlag(PropEdit::PE_USE_HEX)) {
-	HighlightingRule rule;
-	hexFormat.setBackground(QColor(color_background));
-	hexFormat.setForeground(QColor(color_hex));
-	rule.pattern = QRegExp(QString("\\W\\$[0-9A-Fa-f_]+"));
-	rule.format = hexFormat;
-	highlightingRules.append(rule);
-    }
+QBrush PropHighlighter::background()
+{
+    return QBrush(color_background);
+}
 
-    // Highlight float constants?
-    if (m_options.testFlag(PropEdit::PE_USE_FLOAT)) {
-	HighlightingRule rule;
-	fltFormat.setBackground(QColor(color_background));
-	fltFormat.setForeground(QColor(color_flt));
-	rule.pattern = QRegExp(QString("\\W[0-9]+\\.[0-9]*"));
-	rule.format = fltFormat;
-	highlightingRules.append(rule);
-    }
+// ------------------------------------------------------------------------------
+// ------------------------------------------------------------------------------
 
-    // Highlight string constants in double quotes?
-    if (m_options.testFlag(PropEdit::PE_USE_STRING)) {
-	HighlightingRule rule;
-	strFormat.setBackground(QColor(color_background));
-	strFormat.setForeground(QColor(color_str));
-	rule.pattern = QRegExp(QLatin1String("\"([^\\\"]|\\\\.)*\""));
-	rule.format = strFormat;
-	highlightingRules.append(rule);
-    }
+static inline bool is_digit(ushort ch)
+{
+    return ch >= '0' && ch <= '9';
+}
 
-    // Highlight keywords (reserved names)?
-    // i.e. BYTE, WORD, LONG, ORG, ORG, ORGF, RES, FIT, ...
-    if (m_options.testFlag(PropEdit::PE_USE_KEYWORDS)) {
-	HighlightingRule rule;
-	keywordFormat.setFontWeight(QFont::ExtraBold);
-	keywordFormat.setBackground(QColor(color_background));
-	keywordFormat.setForeground(QColor(color_keyword));
-	QStringList patterns = g_tokens.list_esc(g_keywords);
-	rule.pattern = QRegExp(QString("\\b(%1)\\b")
-			       .arg(patterns.join(QChar('|'))),
-			       Qt::CaseInsensitive);
-	rule.format = keywordFormat;
-	highlightingRules.append(rule);
-    }
+static inline bool is_hex_digit(ushort ch)
+{
+    return is_digit(ch) || (ch >= 'A' && ch <= 'F') || (ch >= 'a' && ch <= 'f');
+}
 
-    // Highlight conditionals ?
-    // i.e. IF_NZ, IF_C, ...
-    if (m_options.testFlag(PropEdit::PE_USE_CONDITIONALS)) {
-	HighlightingRule rule;
-	conditionalFormat.setBackground(QColor(color_background));
-	conditionalFormat.setForeground(QColor(color_conditional));
-	QStringList patterns = g_tokens.list_esc(g_conditionals);
-	rule.pattern = QRegExp(QString("\\b(%1)\\b")
-			       .arg(patterns.join(QChar('|'))),
-			       Qt::CaseInsensitive);
-	rule.format = conditionalFormat;
-	highlightingRules.append(rule);
-    }
+static inline bool is_ident_start(ushort ch)
+{
+    return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch == '_';
+}
 
-    // Highlight preprocessor statements
-    // i.e. #define, #undef, #if, #ifdef, #else, ...
-    if (m_options.testFlag(PropEdit::PE_USE_PREPROC)) {
-	HighlightingRule rule;
-	preprocFormat.setBackground(QColor(color_background));
-	preprocFormat.setForeground(QColor(color_preproc));
-	QStringList patterns = g_tokens.list_esc(g_preproc);
-	rule.pattern = QRegExp(QString("(^|\\b)(%1)\\b")
-			       .arg(patterns.join(QChar('|'))));
-	rule.format = preprocFormat;
-	highlightingRules.append(rule);
-    }
+static inline bool is_ident(ushort ch)
+{
+    return is_ident_start(ch) || is_digit(ch);
+}
 
-    // Enable until-end-of-line Comments ? (starting with ')
-    if (m_options.testFlag(PropEdit::PE_USE_SINGLE_LINE_COMMENTS)) {
-	HighlightingRule rule;
-	singleLineCommentFormat.setBackground(QColor(color_background));
-	singleLineCommentFormat.setForeground(QColor(color_comment));
-	rule.pattern = QRegExp("'[^\n]*");
-	rule.format = singleLineCommentFormat;
-	highlightingRules.append(rule);
+/**
+ * @brief Skip over the text of a (possibly nested) { } comment
+ * @param s pointer to the characters of the line
+ * @param len number of characters
+ * @param i index where to start
+ * @param depth reference to the current nesting depth; 0 when the comment ended
+ * @return index after the comment, or @p len if it continues on the next line
+ */
+static inline int skip_comment(const QChar* s, int len, int i, int& depth)
+{
+    while (i < len && depth > 0) {
+	const ushort ch = s[i++].unicode();
+	if (ch == '{')
+	    depth++;
+	else if (ch == '}')
+	    depth--;
     }
+    return i;
 }
 
-QBrush PropHighlighter::background()
+/**
+ * @brief Set a format if the corresponding option is enabled
+ * @param start first character
+ * @param count number of characters
+ * @param option option which needs to be enabled
+ * @param format format to apply
+ */
+void PropHighlighter::format_option(int start, int count, PropEdit::Option option, const QTextCharFormat& format)
 {
-    return QBrush(color_background);
+    if (!m_deferred && m_options.testFlag(option))
+	setFormat(start, count, format);
 }
 
-// ------------------------------------------------------------------------------
-// ------------------------------------------------------------------------------
-
 /**
  * @brief Highlight a block of text
+ *
+ * The line is classified in a single left to right pass. Names are looked up
+ * in the g_token_hash table, so no regular expressions are involved and no
+ * memory is allocated. The block state holds the nesting depth of a { } comment
+ * which continues on the next line. While deferred only the state is computed.
+ *
  * @param text const reference to the QString with the text to highlight
  */
 void PropHighlighter::highlightBlock(const QString &text)
 {
-    foreach (const HighlightingRule &rule, highlightingRules) {
+    const QChar* s = text.constData();
+    const int len = text.length();
+    int depth = qMax(0, previousBlockState());
+    int i = 0;
+
+    if (depth > 0) {
+	// continued multi-line comment
+	i = skip_comment(s, len, 0, depth);
+	format_option(0, i, PropEdit::PE_USE_MULTI_LINE_COMMENTS, m_formats.multiLineCommentFormat);
+    }
 
-	QRegExp expression(rule.pattern);
-	int index = expression.indexIn(text);
+    while (i < len) {
+	const int start = i;
+	const ushort ch = s[i].unicode();
 
-	while (index >= 0) {
-	    const int length = expression.matchedLength();
-	    setFormat(index, length, rule.format);
-	    index = expression.indexIn(text, index + length);
+	if (ch == '\'') {
+	    // comment until end of line
+	    format_option(i, len - i, PropEdit::PE_USE_SINGLE_LINE_COMMENTS, m_formats.singleLineCommentFormat);
+	    break;
 	}
 
-    }
+	if (ch == '{') {
+	    depth = 1;
+	    i = skip_comment(s, len, i + 1, depth);
+	    if (depth > 0) {
+		format_option(start, i - start, PropEdit::PE_USE_MULTI_LINE_COMMENTS, m_formats.multiLineCommentFormat);
+	    } else {
+		format_option(start, i - start, PropEdit::PE_USE_IN_LINE_COMMENTS, m_formats.inLineCommentFormat);
+	    }
+	    continue;
+	}
 
-    setCurrentBlockState(0);
+	if (ch == '"') {
+	    i++;
+	    while (i < len && s[i].unicode() != '"') {
+		if (s[i].unicode() == '\\' && i + 1 < len)
+		    i++;
+		i++;
+	    }
+	    if (i < len)
+		i++;
+	    format_option(start, i - start, PropEdit::PE_USE_STRING, m_formats.strFormat);
+	    continue;
+	}
 
-    // Multi-Line Comments supported ?
-    if (m_options.testFlag(PropEdit::PE_USE_MULTI_LINE_COMMENTS)) {
+	if (ch == '$' && i + 1 < len && is_hex_digit(s[i+1].unicode())) {
+	    i++;
+	    while (i < len && (is_hex_digit(s[i].unicode()) || s[i].unicode() == '_'))
+		i++;
+	    format_option(start, i - start, PropEdit::PE_USE_HEX, m_formats.hexFormat);
+	    continue;
+	}
 
-	int startIndex = 0;
-	if (previousBlockState() != 1)
-	    startIndex = commentStartExpression.indexIn(text);
+	if (ch == '%' && i + 1 < len && (s[i+1].unicode() == '0' || s[i+1].unicode() == '1')) {
+	    i++;
+	    while (i < len && (s[i].unicode() == '0' || s[i].unicode() == '1' || s[i].unicode() == '_'))
+		i++;
+	    format_option(start, i - start, PropEdit::PE_USE_BIN, m_formats.binFormat);
+	    continue;
+	}
 
-	while (startIndex >= 0) {
-	    const int endIndex = commentEndExpression.indexIn(text, startIndex);
-	    int commentLength;
-	    if (endIndex == -1) {
-		setCurrentBlockState(1);
-		commentLength = text.length() - startIndex;
+	if (is_digit(ch)) {
+	    while (i < len && (is_digit(s[i].unicode()) || s[i].unicode() == '_'))
+		i++;
+	    // a dot followed by another dot is a range, e.g. 0..7
+	    if (i < len && s[i].unicode() == '.' && !(i + 1 < len && s[i+1].unicode() == '.')) {
+		i++;
+		while (i < len && is_digit(s[i].unicode()))
+		    i++;
+		format_option(start, i - start, PropEdit::PE_USE_FLOAT, m_formats.fltFormat);
 	    } else {
-		commentLength = endIndex - startIndex
-			+ commentEndExpression.matchedLength();
+		format_option(start, i - start, PropEdit::PE_USE_DEC, m_formats.decFormat);
 	    }
+	    continue;
+	}
 
-	    setFormat(startIndex, commentLength, multiLineCommentFormat);
-	    startIndex = commentStartExpression.indexIn(text, startIndex + commentLength);
+	if (ch == '#' && i + 1 < len && is_ident_start(s[i+1].unicode())) {
+	    i++;
+	    while (i < len && is_ident(s[i].unicode()))
+		i++;
+	    if (g_token_hash.classes(s + start, i - start) & CPropTokenHash::CLASS_PREPROC) {
+		format_option(start, i - start, PropEdit::PE_USE_PREPROC, m_formats.preprocFormat);
+		continue;
+	    }
+	    // not a preprocessor directive: handle '#' as symbol
+	    i = start;
 	}
-    }
-}
 
-void PropHighlighter::appendRule(HighlightingRule rule)
-{
-    highlightingRules.append(rule);
-}
+	if (is_ident_start(ch)) {
+	    while (i < len && is_ident(s[i].unicode()))
+		i++;
+	    const int cls = g_token_hash.classes(s + start, i - start);
+	    if (start == 0 && (cls & CPropTokenHash::CLASS_SECTION)) {
+		format_option(start, i - start, PropEdit::PE_USE_SECTIONS, m_formats.sectionsFormat);
+	    } else if (cls & CPropTokenHash::CLASS_CONDITIONAL) {
+		format_option(start, i - start, PropEdit::PE_USE_CONDITIONALS, m_formats.conditionalFormat);
+	    } else if (cls & CPropTokenHash::CLASS_KEYWORD) {
+		format_option(start, i - start, PropEdit::PE_USE_KEYWORDS, m_formats.keywordFormat);
+	    } else if (cls & CPropTokenHash::CLASS_OPERATOR) {
+		format_option(start, i - start, PropEdit::PE_USE_OPERATORS, m_formats.operatorFormat);
+	    }
+	    continue;
+	}
 
-void PropHighlighter::prependRule(HighlightingRule rule)
-{
-    highlightingRules.prepend(rule);
+	// longest operator or symbolic keyword at this position
+	int n = qMin(g_token_hash.max_symbol_length(), len - i);
+	int cls = CPropTokenHash::CLASS_NONE;
+	while (n > 0) {
+	    cls = g_token_hash.classes(s + i, n);
+	    if (cls & (CPropTokenHash::CLASS_OPERATOR | CPropTokenHash::CLASS_KEYWORD))
+		break;
+	    n--;
+	}
+	if (n > 0) {
+	    if (cls & CPropTokenHash::CLASS_OPERATOR) {
+		format_option(i, n, PropEdit::PE_USE_OPERATORS, m_formats.operatorFormat);
+	    } else {
+		format_option(i, n, PropEdit::PE_USE_KEYWORDS, m_formats.keywordFormat);
+	    }
+	    i += n;
+	    continue;
+	}
+	i++;
+    }
+
+    setCurrentBlockState(depth);
 }
 
 LineNumberArea::LineNumberArea(PropEdit* editor, QString css)
@@ -636,3 +1027,25 @@ void LineNumberArea::paintEvent(QPaintEvent* event)
 {
     codeEditor->line_number_area_paint_event(event);
 }
+
+OverviewRuler::OverviewRuler(PropEdit* editor)
+    : QWidget(editor)
+{
+    codeEditor = editor;
+    setCursor(Qt::PointingHandCursor);
+}
+
+void OverviewRuler::paintEvent(QPaintEvent* event)
+{
+    codeEditor->overview_paint_event(event);
+}
+
+void OverviewRuler::mousePressEvent(QMouseEvent* event)
+{
+    codeEditor->overview_mouse_event(event);
+}
+
+void OverviewRuler::mouseMoveEvent(QMouseEvent* event)
+{
+    codeEditor->overview_mouse_event(event);
+}
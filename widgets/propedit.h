@@ -18,17 +18,17 @@
 #include <QTextDocument>
 #include <QPaintEvent>
 #include <QResizeEvent>
+#include <QMouseEvent>
 #include <QPainter>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "util.h"
+#include "listingindex.h"
 
 class LineNumberArea;
+class OverviewRuler;
 class PropHighlighter;
 
-typedef struct {
-    QRegExp pattern;
-    QTextCharFormat format;
-}   HighlightingRule;
-
 /**
  * @brief PropEdit class
  * The PropEdit class is derived from the QPlainTextEdit
@@ -77,6 +77,18 @@ public:
 
     Q_DECLARE_FLAGS(Options, Option)
 
+    enum Severity {
+	SEV_NONE,
+	SEV_WARNING,
+	SEV_ERROR
+    };
+
+    /** @brief a diagnostic marker for a source line */
+    struct Marker {
+	int line;		    //!< line number (1 based)
+	Severity severity;	    //!< severity level
+    };
+
     PropEdit(QWidget *parent = nullptr,
 	     const int tabsize = 8,
 	     const QString& css_linearea = QString(),
@@ -84,11 +96,18 @@ public:
 
     void line_number_area_paint_event(QPaintEvent *event);
     int  line_number_area_width();
-    void append_rule(HighlightingRule rule);
-    void prepend_rule(HighlightingRule rule);
+    void overview_paint_event(QPaintEvent* event);
+    void overview_mouse_event(QMouseEvent* event);
     void set_error_line_list(const QList<int>& list = QList<int>());
+    void set_markers(const QVector<Marker>& markers = QVector<Marker>());
+    const QVector<Marker>& markers() const;
+    Severity marker(int line) const;
+    const ListingIndex& listing_index() const;
+    void set_listing_index(const ListingIndex& index = ListingIndex());
+    int current_line() const;
 
     bool changed() const;
+    bool changed_on_disk(bool acknowledge = false);
     QString text() const;
     QString filename() const;
     FileType filetype() const;
@@ -105,6 +124,7 @@ public slots:
 protected:
     void resizeEvent(QResizeEvent *event);
     void keyPressEvent(QKeyEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
 
 private slots:
     void zoom_in();
@@ -115,12 +135,23 @@ private slots:
 
 private:
     static constexpr QRgb color_line_number_area = qRgb(0xf0,0xf0,0xf0);
+    static constexpr QRgb color_overview_visible = qRgb(0xd8,0xd8,0xd8);
+    static constexpr QRgb color_marker_error = qRgb(0xff,0x00,0x00);
+    static constexpr QRgb color_marker_warning = qRgb(0xff,0xc0,0x00);
+    static constexpr int overview_width = 10;
 
     QWidget* m_lineno_area;
+    QWidget* m_overview;		    //!< overview ruler right of the text
     PropHighlighter* m_highlighter;
     int m_tabsize;
     PropEdit::Options m_options;
-    QList<int> m_error_lines;
+    QVector<Marker> m_markers;		    //!< markers sorted by line, at most one per line
+    int m_line_height;			    //!< cached fontMetrics().height()
+    ListingIndex m_listing_index;	    //!< source lines to hub addresses of the last build
+    int m_current_line;			    //!< block number of the highlighted current line
+    QElapsedTimer m_key_timer;		    //!< time since the last key press (DEBUG_KEY_LATENCY)
+
+    void set_disk_state(const QByteArray& hash, const QFileInfo& info);
 };
 
 /**
@@ -134,12 +165,15 @@ public:
     PropHighlighter(QTextDocument *doc = nullptr, PropEdit::Options options = PropEdit::PE_DEFAULT);
 
     QBrush background();
-    void appendRule(HighlightingRule rule);
-    void prependRule(HighlightingRule rule);
+    void set_deferred(bool deferred);
+    void rehighlight_lazy(const QTextBlock& first, int count);
 
 protected:
     void highlightBlock(const QString &text) Q_DECL_OVERRIDE;
 
+private slots:
+    void idle_slice();
+
 private:
     static constexpr QRgb color_background  = qRgb(0xf8, 0xfc, 0xf8);
     static constexpr QRgb color_preproc	    = qRgb(0x20, 0x20, 0x7f);
@@ -154,25 +188,34 @@ private:
     static constexpr QRgb color_flt	    = qRgb(0xa0, 0x20, 0x60);
     static constexpr QRgb color_str	    = qRgb(0x30, 0x30, 0xff);
 
+    static constexpr int idle_slice_ms = 8;	    //!< time budget for one idle highlighting slice
+
+    /** @brief text formats shared by all highlighters */
+    struct Formats {
+	Formats();
+	QTextCharFormat singleLineCommentFormat;
+	QTextCharFormat inLineCommentFormat;
+	QTextCharFormat multiLineCommentFormat;
+	QTextCharFormat sectionsFormat;
+	QTextCharFormat operatorFormat;
+	QTextCharFormat keywordFormat;
+	QTextCharFormat conditionalFormat;
+	QTextCharFormat preprocFormat;
+	QTextCharFormat binFormat;
+	QTextCharFormat decFormat;
+	QTextCharFormat hexFormat;
+	QTextCharFormat fltFormat;
+	QTextCharFormat strFormat;
+    };
+
     PropEdit::Options m_options;
-    QVector<HighlightingRule> highlightingRules;
-
-    QRegExp commentStartExpression;
-    QRegExp commentEndExpression;
-
-    QTextCharFormat singleLineCommentFormat;
-    QTextCharFormat inLineCommentFormat;
-    QTextCharFormat multiLineCommentFormat;
-    QTextCharFormat sectionsFormat;
-    QTextCharFormat operatorFormat;
-    QTextCharFormat keywordFormat;
-    QTextCharFormat conditionalFormat;
-    QTextCharFormat preprocFormat;
-    QTextCharFormat binFormat;
-    QTextCharFormat decFormat;
-    QTextCharFormat hexFormat;
-    QTextCharFormat fltFormat;
-    QTextCharFormat strFormat;
+    const Formats& m_formats;		    //!< reference to the shared formats
+    bool m_deferred;			    //!< if true, only track block states, do not format
+    QTimer m_idle_timer;		    //!< timer for highlighting slices
+    int m_idle_block;			    //!< number of the next block to highlight when idle
+
+    static const Formats& formats();
+    void format_option(int start, int count, PropEdit::Option option, const QTextCharFormat& format);
 };
 
 class LineNumberArea : public QWidget
@@ -188,3 +231,22 @@ protected:
 private:
     PropEdit *codeEditor;
 };
+
+/**
+ * @brief The OverviewRuler class shows the markers of the whole
+ * document and the visible part scaled to the height of the editor.
+ * Clicking into the ruler moves the cursor to the corresponding line.
+ */
+class OverviewRuler : public QWidget
+{
+public:
+    OverviewRuler(PropEdit *editor);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+
+private:
+    PropEdit *codeEditor;
+};